@@ -0,0 +1,286 @@
+#ifndef IPS_ASYNC_HPP
+#define IPS_ASYNC_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "image.hpp"
+#include "node.hpp"
+#include "task.hpp"
+#include "thread_pool.hpp"
+
+namespace ips
+{
+// Node whose Run is a coroutine. While it waits on I/O (a file read, a
+// socket, a remote fetch) it is suspended and holds no thread, so
+// thousands of them can be in flight on a handful of threads.
+class AsyncNode
+{
+   public:
+    std::function<EXECError(Image&)> Init;
+    std::function<Task<EXECError>(Image&)> Run;
+    std::string Name;
+
+    AsyncNode() = default;
+
+    AsyncNode(std::function<EXECError(Image&)> init,
+              std::function<Task<EXECError>(Image&)> run,
+              std::string name = {});
+
+    EXECError executeInit(Image&);
+
+    Task<EXECError> executeRun(Image&);
+};
+
+// Event loop for AsyncNodes. One thread waits in epoll for fd readiness and
+// posted resumptions; a few I/O threads run blocking calls (regular files
+// cannot be polled) and hand the waiting coroutine back to the loop.
+// Compute-heavy code should hop to the compute pool with compute() so the
+// loop stays responsive.
+class AsyncExecutor
+{
+   public:
+    explicit AsyncExecutor(size_t ioThreads = 2, ThreadPool* compute = nullptr);
+
+    AsyncExecutor(const AsyncExecutor&) = delete;
+    AsyncExecutor& operator=(const AsyncExecutor&) = delete;
+
+    // All coroutines started on the executor must have finished.
+    ~AsyncExecutor();
+
+    ThreadPool& pool() noexcept { return *Compute; }
+
+    // Resumes the awaiting coroutine on the event loop thread.
+    auto schedule() noexcept { return PostAwaiter{this}; }
+
+    // Resumes the awaiting coroutine on the compute pool.
+    auto compute() noexcept { return ComputeAwaiter{Compute}; }
+
+    // Waits until fd is readable / writable. Resolves to false if the fd
+    // could not be watched or reported an error or hang-up.
+    auto readable(int fd) noexcept { return FdAwaiter(this, fd, true); }
+    auto writable(int fd) noexcept { return FdAwaiter(this, fd, false); }
+
+    // Runs fn() on an I/O thread and resumes on the event loop with its
+    // result. Exceptions thrown by fn are rethrown in the coroutine.
+    template <typename F>
+    auto blocking(F fn)
+    {
+        return BlockingAwaiter<F>(this, std::move(fn));
+    }
+
+    Task<std::optional<std::vector<uint8_t>>> readFile(std::string path);
+    Task<bool> writeFile(std::string path, std::vector<uint8_t> data);
+
+    // Decodes on an I/O thread, like Image::createFromFile.
+    Task<std::optional<Image>> loadImage(std::string path);
+
+    // Starts the task on the event loop and blocks until it finishes.
+    // Must not be called from the loop or an I/O thread.
+    template <typename T>
+    T run(Task<T> task);
+
+    // Runs node on every image concurrently and waits for all of them.
+    // Returns EXEC_FAIL if any run failed or threw.
+    EXECError run(AsyncNode& node, std::span<Image> images);
+
+    // Number of coroutines currently suspended on an fd or a blocking call;
+    // the latter count from submission until the call has returned.
+    size_t inFlight() const noexcept
+    {
+        return Waiting.load(std::memory_order_relaxed);
+    }
+
+   private:
+    struct PostAwaiter
+    {
+        AsyncExecutor* Executor;
+
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> handle)
+        {
+            Executor->post(handle);
+        }
+        void await_resume() const noexcept {}
+    };
+
+    struct ComputeAwaiter
+    {
+        ThreadPool* Pool;
+
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> handle)
+        {
+            Pool->submit([handle] { handle.resume(); });
+        }
+        void await_resume() const noexcept {}
+    };
+
+    struct FdAwaiter
+    {
+        AsyncExecutor* Executor;
+        int Fd;
+        bool Read;
+        std::coroutine_handle<> Handle;
+        uint32_t Events = 0;
+        bool Ok = false;
+
+        FdAwaiter(AsyncExecutor* executor, int fd, bool read) noexcept
+            : Executor(executor), Fd(fd), Read(read)
+        {
+        }
+
+        bool await_ready() const noexcept { return false; }
+        bool await_suspend(std::coroutine_handle<> handle)
+        {
+            Handle = handle;
+            return Executor->watch(*this);
+        }
+        bool await_resume() const noexcept { return Ok; }
+    };
+
+    template <typename F>
+    struct BlockingAwaiter
+    {
+        using Result = std::invoke_result_t<F&>;
+        using Stored =
+            std::conditional_t<std::is_void_v<Result>, bool, Result>;
+
+        AsyncExecutor* Executor;
+        F Fn;
+        std::optional<Stored> Value;
+        std::exception_ptr Error;
+
+        BlockingAwaiter(AsyncExecutor* executor, F fn)
+            : Executor(executor), Fn(std::move(fn))
+        {
+        }
+
+        bool await_ready() const noexcept { return false; }
+
+        void await_suspend(std::coroutine_handle<> handle)
+        {
+            Executor->submitIo(
+                [this, handle]
+                {
+                    try
+                    {
+                        if constexpr (std::is_void_v<Result>)
+                        {
+                            Fn();
+                            Value.emplace(true);
+                        }
+                        else
+                        {
+                            Value.emplace(Fn());
+                        }
+                    }
+                    catch (...)
+                    {
+                        Error = std::current_exception();
+                    }
+                    Executor->post(handle);
+                });
+        }
+
+        Result await_resume()
+        {
+            if (Error) std::rethrow_exception(Error);
+            if constexpr (!std::is_void_v<Result>) return std::move(*Value);
+        }
+    };
+
+    // Started eagerly and destroys itself when done.
+    struct Detached
+    {
+        struct promise_type
+        {
+            Detached get_return_object() noexcept { return {}; }
+            std::suspend_never initial_suspend() noexcept { return {}; }
+            std::suspend_never final_suspend() noexcept { return {}; }
+            void return_void() noexcept {}
+            void unhandled_exception() noexcept { std::terminate(); }
+        };
+    };
+
+    ThreadPool* Compute;
+    int EpollFd = -1;
+    int WakeFd = -1;
+    std::thread Loop;
+
+    std::mutex PostMutex;
+    std::vector<std::coroutine_handle<>> Posted;
+
+    std::vector<std::thread> IoThreads;
+    std::mutex IoMutex;
+    std::condition_variable IoReady;
+    std::deque<std::function<void()>> IoTasks;
+
+    std::atomic<bool> Stopping{false};
+    std::atomic<size_t> Waiting{0};
+
+    void post(std::coroutine_handle<> handle);
+    void submitIo(std::function<void()> task);
+    bool watch(FdAwaiter& awaiter);
+
+    void loop();
+    void ioLoop();
+
+    struct BatchState;
+
+    template <typename T>
+    Detached start(Task<T> task, std::promise<T> result);
+    Detached runOne(AsyncNode& node, Image& image,
+                    std::shared_ptr<BatchState> state);
+};
+
+template <typename T>
+AsyncExecutor::Detached AsyncExecutor::start(Task<T> task,
+                                             std::promise<T> result)
+{
+    co_await schedule();
+    try
+    {
+        if constexpr (std::is_void_v<T>)
+        {
+            co_await std::move(task);
+            result.set_value();
+        }
+        else
+        {
+            result.set_value(co_await std::move(task));
+        }
+    }
+    catch (...)
+    {
+        result.set_exception(std::current_exception());
+    }
+}
+
+template <typename T>
+T AsyncExecutor::run(Task<T> task)
+{
+    std::promise<T> result;
+    auto future = result.get_future();
+    start(std::move(task), std::move(result));
+    return future.get();
+}
+}  // namespace ips
+
+#endif  // IPS_ASYNC_HPP
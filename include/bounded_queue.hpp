@@ -0,0 +1,125 @@
+#ifndef IPS_BOUNDED_QUEUE_HPP
+#define IPS_BOUNDED_QUEUE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+namespace ips
+{
+namespace detail
+{
+// Lock-free bounded multi-producer multi-consumer queue (Vyukov). The
+// capacity is rounded up to a power of two. tryPush/tryPop never block;
+// callers decide how to wait.
+template <typename T>
+class BoundedQueue
+{
+   public:
+    explicit BoundedQueue(size_t capacity)
+        : Mask(std::bit_ceil(std::max<size_t>(capacity, 2)) - 1),
+          Cells(std::make_unique<Cell[]>(Mask + 1))
+    {
+        for (size_t i = 0; i <= Mask; ++i)
+        {
+            Cells[i].Sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    bool tryPush(T& value)
+    {
+        Cell* cell;
+        size_t pos = EnqueuePos.load(std::memory_order_relaxed);
+        while (true)
+        {
+            cell = &Cells[pos & Mask];
+            const size_t seq = cell->Sequence.load(std::memory_order_acquire);
+            const auto diff = static_cast<std::ptrdiff_t>(seq) -
+                              static_cast<std::ptrdiff_t>(pos);
+            if (diff == 0)
+            {
+                if (EnqueuePos.compare_exchange_weak(
+                        pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+            {
+                return false;  // full
+            }
+            else
+            {
+                pos = EnqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+
+        cell->Value = std::move(value);
+        cell->Sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool tryPop(T& value)
+    {
+        Cell* cell;
+        size_t pos = DequeuePos.load(std::memory_order_relaxed);
+        while (true)
+        {
+            cell = &Cells[pos & Mask];
+            const size_t seq = cell->Sequence.load(std::memory_order_acquire);
+            const auto diff = static_cast<std::ptrdiff_t>(seq) -
+                              static_cast<std::ptrdiff_t>(pos + 1);
+            if (diff == 0)
+            {
+                if (DequeuePos.compare_exchange_weak(
+                        pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+            {
+                return false;  // empty
+            }
+            else
+            {
+                pos = DequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+
+        value = std::move(cell->Value);
+        cell->Sequence.store(pos + Mask + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t capacity() const noexcept { return Mask + 1; }
+
+    // Approximate while other threads push or pop.
+    size_t size() const noexcept
+    {
+        const size_t tail = EnqueuePos.load(std::memory_order_relaxed);
+        const size_t head = DequeuePos.load(std::memory_order_relaxed);
+        return tail > head ? tail - head : 0;
+    }
+
+   private:
+    struct Cell
+    {
+        std::atomic<size_t> Sequence;
+        T Value;
+    };
+
+    static constexpr size_t CacheLine = 64;
+
+    const size_t Mask;
+    std::unique_ptr<Cell[]> Cells;
+
+    alignas(CacheLine) std::atomic<size_t> EnqueuePos{0};
+    alignas(CacheLine) std::atomic<size_t> DequeuePos{0};
+};
+}  // namespace detail
+}  // namespace ips
+
+#endif  // IPS_BOUNDED_QUEUE_HPP
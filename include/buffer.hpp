@@ -85,6 +85,10 @@ class Buffer
             {
                 clear();
             }
+            else if (other.size_ == size_ && data_)
+            {
+                copyData(other.data_.get(), size_);
+            }
             else
             {
                 auto new_data = std::make_unique<T[]>(other.size_);
@@ -0,0 +1,95 @@
+#ifndef IPS_COLOR_COMPOSITE_HPP
+#define IPS_COLOR_COMPOSITE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "image.hpp"
+#include "node.hpp"
+#include "parallel.hpp"
+#include "typed_image.hpp"
+
+namespace ips::color
+{
+// Separable blend modes of the W3C compositing spec, each composited
+// "source over" the destination. Add is Porter-Duff plus: colour and
+// alpha sums, saturated.
+enum class BlendMode
+{
+    Normal,
+    Multiply,
+    Screen,
+    Overlay,
+    Darken,
+    Lighten,
+    Difference,
+    Add
+};
+
+struct CompositeOptions
+{
+    BlendMode Mode = BlendMode::Normal;
+
+    // Scales the source alpha, 0..1.
+    float Opacity = 1.0f;
+
+    // Source and destination colours are already multiplied by their
+    // alpha, and the result is left that way. Otherwise colours are
+    // straight, as PNG stores them.
+    bool Premultiplied = false;
+
+    ParallelOptions Parallel = {};
+};
+
+// U8 results are rounded exactly: every product of two 0..255 values is
+// divided by 255 with correct rounding, in 16-bit lanes without a divide.
+// F32 colours and alpha are in [0, 1]. There is no four-channel F32 image,
+// so F32 layers are an F32C3 colour image with a separate F32C1 alpha
+// plane of the same size.
+
+// Colour times alpha for U8C4 images. dst may be src.
+void premultiply(const Image& src, Image& dst,
+                 const ParallelOptions& options = {});
+
+// Colour divided by alpha, rounded, for U8C4 images; fully transparent
+// pixels become 0. dst may be src.
+void unpremultiply(const Image& src, Image& dst,
+                   const ParallelOptions& options = {});
+
+void premultiply(const Image& color, const Image& alpha, Image& dst,
+                 const ParallelOptions& options = {});
+
+void unpremultiply(const Image& color, const Image& alpha, Image& dst,
+                   const ParallelOptions& options = {});
+
+// Composites src onto dst, pixel for pixel. The views must have the same
+// size; dst is usually a region() of a larger canvas, so its rows may be
+// any stride apart.
+void composite(TypedImage<const uint8_t, 4> src, TypedImage<uint8_t, 4> dst,
+               const CompositeOptions& options = {});
+
+// F32 layers. An empty dstAlpha makes the destination opaque.
+void composite(TypedImage<const float, 3> srcColor,
+               TypedImage<const float, 1> srcAlpha,
+               TypedImage<float, 3> dstColor, TypedImage<float, 1> dstAlpha,
+               const CompositeOptions& options = {});
+
+// Composites a U8C4 src onto the U8C4 dst with its top-left corner at
+// (x, y), which may lie outside dst; only the overlap is touched.
+void composite(const Image& src, Image& dst, std::ptrdiff_t x,
+               std::ptrdiff_t y, const CompositeOptions& options = {});
+
+// The same for an F32C3 + F32C1 layer onto an F32C3 canvas, with its
+// F32C1 alpha plane if dstAlpha is not null.
+void composite(const Image& srcColor, const Image& srcAlpha, Image& dstColor,
+               Image* dstAlpha, std::ptrdiff_t x, std::ptrdiff_t y,
+               const CompositeOptions& options = {});
+
+// Composites a U8C4 overlay onto U8C4 images at (x, y).
+Node compositeNode(Image overlay, std::ptrdiff_t x, std::ptrdiff_t y,
+                   CompositeOptions options = {},
+                   std::string name = "composite");
+}  // namespace ips::color
+
+#endif  // IPS_COLOR_COMPOSITE_HPP
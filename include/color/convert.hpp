@@ -0,0 +1,98 @@
+#ifndef IPS_COLOR_CONVERT_HPP
+#define IPS_COLOR_CONVERT_HPP
+
+#include <string>
+
+#include "image.hpp"
+#include "node.hpp"
+#include "parallel.hpp"
+
+namespace ips::color
+{
+enum class ColorMatrix
+{
+    BT601,
+    BT709
+};
+
+// Full range spans 0..255 for Y and chroma (JPEG); limited range puts Y
+// in 16..235 and chroma in 16..240 (broadcast video).
+enum class ColorRange
+{
+    Full,
+    Limited
+};
+
+enum class ChromaSubsampling
+{
+    // 4:4:4, chroma at full resolution.
+    None,
+    // 4:2:0, one chroma sample per 2x2 block, averaged on the way down.
+    Half
+};
+
+struct ColorOptions
+{
+    ColorMatrix Matrix = ColorMatrix::BT601;
+    ColorRange Range = ColorRange::Full;
+    ParallelOptions Parallel = {};
+};
+
+// Separate single-channel planes. With ChromaSubsampling::Half, Cb and Cr
+// are ceil(width / 2) x ceil(height / 2).
+struct PlanarYCbCr
+{
+    Image Y, Cb, Cr;
+    ChromaSubsampling Subsampling = ChromaSubsampling::None;
+};
+
+// All conversions take U8 or F32 images and produce the same depth. F32
+// samples are in [0, 1]; F32 chroma is centred on 0.5. RGB inputs may be
+// four channel, the fourth channel is ignored. dst may be src.
+
+// Luma with the weights of options.Matrix; the range is always full.
+void rgbToGray(const Image& src, Image& dst, const ColorOptions& options = {});
+
+void grayToRgb(const Image& src, Image& dst,
+               const ParallelOptions& options = {});
+
+// Interleaved three-channel Y, Cb, Cr.
+void rgbToYCbCr(const Image& src, Image& dst,
+                const ColorOptions& options = {});
+
+void yCbCrToRgb(const Image& src, Image& dst,
+                const ColorOptions& options = {});
+
+// Planar output, subsampled to 4:2:0 in the same pass if asked.
+void rgbToYCbCr(const Image& src, PlanarYCbCr& dst,
+                ChromaSubsampling subsampling = ChromaSubsampling::None,
+                const ColorOptions& options = {});
+
+// 4:2:0 chroma is upsampled by replication.
+void yCbCrToRgb(const PlanarYCbCr& src, Image& dst,
+                const ColorOptions& options = {});
+
+// H, S, V. U8 hue is degrees / 2 in [0, 180) so it fits a byte, S and V
+// are 0..255; F32 hue is degrees in [0, 360), S and V in [0, 1].
+void rgbToHsv(const Image& src, Image& dst,
+              const ParallelOptions& options = {});
+
+void hsvToRgb(const Image& src, Image& dst,
+              const ParallelOptions& options = {});
+
+enum class Conversion
+{
+    RgbToGray,
+    GrayToRgb,
+    RgbToYCbCr,
+    YCbCrToRgb,
+    RgbToHsv,
+    HsvToRgb
+};
+
+// Converts the image in place, changing its channel count as needed.
+Node colorNode(Conversion conversion, ColorOptions options = {},
+               std::string name = "color");
+}  // namespace ips::color
+
+#endif  // IPS_COLOR_CONVERT_HPP
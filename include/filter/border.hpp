@@ -0,0 +1,142 @@
+#ifndef IPS_FILTER_BORDER_HPP
+#define IPS_FILTER_BORDER_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace ips::filter
+{
+// How pixels outside the image are read, for a row "abcdefgh":
+//   Constant    iii|abcdefgh|iii  (a fixed value)
+//   Replicate   aaa|abcdefgh|hhh
+//   Reflect     cba|abcdefgh|hgf
+//   Reflect101  dcb|abcdefgh|gfe
+//   Wrap        fgh|abcdefgh|abc
+enum class BorderMode
+{
+    Constant,
+    Replicate,
+    Reflect,
+    Reflect101,
+    Wrap
+};
+
+// Maps coordinate i to [0, n), or returns -1 for Constant borders.
+inline std::ptrdiff_t borderIndex(std::ptrdiff_t i, size_t size,
+                                  BorderMode mode) noexcept
+{
+    const auto n = static_cast<std::ptrdiff_t>(size);
+    if (i >= 0 && i < n) return i;
+    if (n == 1) return mode == BorderMode::Constant ? -1 : 0;
+
+    switch (mode)
+    {
+        case BorderMode::Constant:
+            return -1;
+        case BorderMode::Replicate:
+            return i < 0 ? 0 : n - 1;
+        case BorderMode::Reflect:
+        {
+            const std::ptrdiff_t period = 2 * n;
+            i %= period;
+            if (i < 0) i += period;
+            return i < n ? i : period - 1 - i;
+        }
+        case BorderMode::Reflect101:
+        {
+            const std::ptrdiff_t period = 2 * n - 2;
+            i %= period;
+            if (i < 0) i += period;
+            return i < n ? i : period - i;
+        }
+        case BorderMode::Wrap:
+            i %= n;
+            return i < 0 ? i + n : i;
+    }
+    return -1;
+}
+
+namespace detail
+{
+// The value read outside the image for Constant borders, in the pixel type:
+// U8 rounds and clamps, since a wider working type would otherwise carry
+// values no pixel can hold. Options is any options struct with Border and
+// BorderValue.
+template <typename T, typename Options>
+T borderConstant(const Options& options)
+{
+    if (options.Border != BorderMode::Constant) return T{};
+    if constexpr (std::is_same_v<T, uint8_t>)
+        return static_cast<uint8_t>(
+            std::clamp(std::lround(options.BorderValue), 0L, 255L));
+    else
+        return static_cast<T>(options.BorderValue);
+}
+
+struct Layout
+{
+    size_t Width, Height, Channels;
+};
+
+// Loads `count` pixels of source row sy starting at column x0 (which may
+// lie outside the image) into pad, applying the horizontal border. sy is
+// an already mapped row index, or -1 for a constant border row.
+template <typename S, typename T>
+void loadRow(const S* src, std::ptrdiff_t sy, const Layout& layout,
+             std::ptrdiff_t x0, size_t count, BorderMode mode, T constant,
+             T* pad)
+{
+    const size_t C = layout.Channels;
+    if (sy < 0)
+    {
+        std::fill(pad, pad + count * C, constant);
+        return;
+    }
+
+    const S* row = src + static_cast<size_t>(sy) * layout.Width * C;
+    const auto width = static_cast<std::ptrdiff_t>(layout.Width);
+    const std::ptrdiff_t x1 = x0 + static_cast<std::ptrdiff_t>(count);
+
+    const std::ptrdiff_t inner0 = std::clamp<std::ptrdiff_t>(x0, 0, width);
+    const std::ptrdiff_t inner1 = std::clamp<std::ptrdiff_t>(x1, inner0, width);
+
+    auto mapped = [&](std::ptrdiff_t x, T* out)
+    {
+        const std::ptrdiff_t sx = borderIndex(x, layout.Width, mode);
+        for (size_t c = 0; c < C; ++c)
+        {
+            out[c] = sx < 0 ? constant
+                            : static_cast<T>(row[static_cast<size_t>(sx) * C + c]);
+        }
+    };
+
+    for (std::ptrdiff_t x = x0; x < std::min(inner0, x1); ++x)
+    {
+        mapped(x, pad + static_cast<size_t>(x - x0) * C);
+    }
+
+    const S* from = row + static_cast<size_t>(inner0) * C;
+    T* to = pad + static_cast<size_t>(inner0 - x0) * C;
+    const size_t n = static_cast<size_t>(inner1 - inner0) * C;
+    if constexpr (std::is_same_v<S, T>)
+    {
+        std::memcpy(to, from, n * sizeof(T));
+    }
+    else
+    {
+        for (size_t i = 0; i < n; ++i) to[i] = static_cast<T>(from[i]);
+    }
+
+    for (std::ptrdiff_t x = std::max(inner1, x0); x < x1; ++x)
+    {
+        mapped(x, pad + static_cast<size_t>(x - x0) * C);
+    }
+}
+}  // namespace detail
+}  // namespace ips::filter
+
+#endif  // IPS_FILTER_BORDER_HPP
@@ -0,0 +1,69 @@
+#ifndef IPS_FILTER_CONVOLUTION_HPP
+#define IPS_FILTER_CONVOLUTION_HPP
+
+#include <cstddef>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "filter/border.hpp"
+#include "image.hpp"
+#include "node.hpp"
+#include "parallel.hpp"
+
+namespace ips::filter
+{
+// Dense 2D kernel, row-major, anchored at its centre. Both sizes are odd.
+struct Kernel
+{
+    size_t Width = 0;
+    size_t Height = 0;
+    std::vector<float> Weights;
+
+    Kernel() = default;
+    Kernel(size_t w, size_t h, std::vector<float> weights);
+
+    float operator()(size_t x, size_t y) const { return Weights[y * Width + x]; }
+};
+
+struct FilterOptions
+{
+    BorderMode Border = BorderMode::Reflect101;
+    // Pixel value used by BorderMode::Constant.
+    float BorderValue = 0.0f;
+    ParallelOptions Parallel = {};
+};
+
+// Normalized 1D Gaussian of 2 * radius + 1 taps; radius 0 picks
+// ceil(3 * sigma).
+std::vector<float> gaussianKernel(float sigma, size_t radius = 0);
+
+// Splits a rank-1 kernel into column and row factors, so that
+// kernel(x, y) == column[y] * row[x] within `tolerance` of the largest
+// weight. Returns false if the kernel is not separable.
+bool separateKernel(const Kernel& kernel, std::vector<float>& row,
+                    std::vector<float>& column, float tolerance = 1e-5f);
+
+// Horizontal pass with `row`, then vertical with `column`. dst may be src;
+// it is reallocated to src's shape and type if needed. U8 images with
+// non-negative kernels run in fixed point, everything else in float.
+void sepFilter2D(const Image& src, Image& dst, std::span<const float> row,
+                 std::span<const float> column,
+                 const FilterOptions& options = {});
+
+// Runs separable kernels as two passes and anything else directly.
+void filter2D(const Image& src, Image& dst, const Kernel& kernel,
+              const FilterOptions& options = {});
+
+// sigmaY == 0 uses sigmaX.
+void gaussianBlur(const Image& src, Image& dst, float sigmaX,
+                  float sigmaY = 0.0f, const FilterOptions& options = {});
+
+Node filterNode(Kernel kernel, FilterOptions options = {},
+                std::string name = "filter2D");
+
+Node gaussianNode(float sigma, FilterOptions options = {},
+                  std::string name = "gaussianBlur");
+}  // namespace ips::filter
+
+#endif  // IPS_FILTER_CONVOLUTION_HPP
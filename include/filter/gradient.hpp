@@ -0,0 +1,61 @@
+#ifndef IPS_FILTER_GRADIENT_HPP
+#define IPS_FILTER_GRADIENT_HPP
+
+#include <cstdint>
+#include <string>
+
+#include "filter/convolution.hpp"
+#include "image.hpp"
+#include "node.hpp"
+
+namespace ips::filter
+{
+enum class GradientOperator
+{
+    // [1 2 1] smoothing across the derivative.
+    Sobel,
+    // [3 10 3] smoothing: closer to rotation invariant.
+    Scharr
+};
+
+// Direction values: the gradient angle rounded to the nearest multiple of
+// 45 degrees, counted from +x towards +y (downwards), folded to [0, 180).
+enum GradientDirection : uint8_t
+{
+    Direction0 = 0,
+    Direction45 = 1,
+    Direction90 = 2,
+    Direction135 = 3
+};
+
+struct Gradients
+{
+    // F32C1 derivatives, unnormalized: Sobel of a unit step is 4.
+    Image Dx, Dy;
+    // F32C1 L2 norm of (Dx, Dy).
+    Image Magnitude;
+    // U8C1 GradientDirection values.
+    Image Direction;
+};
+
+// Derivatives, magnitude and direction of a U8C1 or F32C1 image in a
+// single pass over row bands spread over threads.
+void gradients(const Image& src, Gradients& out,
+               GradientOperator op = GradientOperator::Sobel,
+               const FilterOptions& options = {});
+
+// U8C1 edge mask (0 or 255) of a U8C1 or F32C1 image. Pixels whose
+// gradient magnitude is a local maximum across the edge are kept if it
+// exceeds `high`, or exceeds `low` and connects to such a pixel through
+// 8-neighbours. Gradients and suppression are fused per row band;
+// hysteresis follows edges with an explicit stack. edges may be src.
+void canny(const Image& src, Image& edges, float low, float high,
+           GradientOperator op = GradientOperator::Sobel,
+           const FilterOptions& options = {});
+
+Node cannyNode(float low, float high,
+               GradientOperator op = GradientOperator::Sobel,
+               FilterOptions options = {}, std::string name = "canny");
+}  // namespace ips::filter
+
+#endif  // IPS_FILTER_GRADIENT_HPP
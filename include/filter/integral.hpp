@@ -0,0 +1,64 @@
+#ifndef IPS_FILTER_INTEGRAL_HPP
+#define IPS_FILTER_INTEGRAL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "filter/convolution.hpp"
+#include "image.hpp"
+#include "node.hpp"
+#include "parallel.hpp"
+
+namespace ips::filter
+{
+// Summed-area table: entry (x, y) holds the per-channel sum of all pixels
+// in [0, x) x [0, y), so the first row and column are zero.
+template <typename Acc>
+struct IntegralImage
+{
+    size_t Width = 0, Height = 0, Channels = 0;
+    // (Height + 1) rows of (Width + 1) * Channels entries.
+    std::vector<Acc> Table;
+
+    size_t stride() const { return (Width + 1) * Channels; }
+
+    Acc at(size_t x, size_t y, size_t c = 0) const
+    {
+        return Table[y * stride() + x * Channels + c];
+    }
+
+    // Sum over [x0, x1) x [y0, y1) in four lookups.
+    Acc sum(size_t x0, size_t y0, size_t x1, size_t y1, size_t c = 0) const
+    {
+        return at(x1, y1, c) - at(x0, y1, c) - at(x1, y0, c) + at(x0, y0, c);
+    }
+};
+
+// Sums, and squared sums if `squares` is given. U8 images may use
+// uint64_t, which no image size overflows even for squares; any image may
+// use double. Rows are prefix-summed in parallel, then columns in
+// parallel blocks.
+template <typename Acc>
+void integral(const Image& src, IntegralImage<Acc>& sums,
+              IntegralImage<Acc>* squares = nullptr,
+              const ParallelOptions& options = {});
+
+// Mean over a width x height window anchored at (width / 2, height / 2),
+// from a summed-area table of the bordered image: four lookups per pixel
+// whatever the window size. dst may be src.
+void boxFilter(const Image& src, Image& dst, size_t width, size_t height,
+               const FilterOptions& options = {});
+
+// Local mean and population variance over the same windows, as F32 images
+// with src's channel count (1 or 3), in the units of src.
+void localMeanVariance(const Image& src, Image& mean, Image& variance,
+                       size_t width, size_t height,
+                       const FilterOptions& options = {});
+
+Node boxFilterNode(size_t width, size_t height, FilterOptions options = {},
+                   std::string name = "boxFilter");
+}  // namespace ips::filter
+
+#endif  // IPS_FILTER_INTEGRAL_HPP
@@ -0,0 +1,29 @@
+#ifndef IPS_FILTER_MEDIAN_HPP
+#define IPS_FILTER_MEDIAN_HPP
+
+#include <cstddef>
+#include <string>
+
+#include "filter/convolution.hpp"
+#include "image.hpp"
+#include "node.hpp"
+
+namespace ips::filter
+{
+// Largest radius median() accepts: window counts must fit 16 bits.
+constexpr size_t MaxMedianRadius = 127;
+
+// Per-channel median over the (2 * radius + 1)^2 square around each pixel
+// of a U8 image. Radius 1 and 2 (3x3, 5x5) run sorting networks on 16
+// pixels at a time; larger radii use the Perreault-Hebert constant-time
+// histogram method, so the cost per pixel stays nearly flat as the radius
+// grows. Work is split into column stripes run in parallel. dst may be
+// src.
+void median(const Image& src, Image& dst, size_t radius,
+            const FilterOptions& options = {});
+
+Node medianNode(size_t radius, FilterOptions options = {},
+                std::string name = "median");
+}  // namespace ips::filter
+
+#endif  // IPS_FILTER_MEDIAN_HPP
@@ -0,0 +1,42 @@
+#ifndef IPS_FILTER_MORPHOLOGY_HPP
+#define IPS_FILTER_MORPHOLOGY_HPP
+
+#include <cstddef>
+#include <string>
+
+#include "filter/convolution.hpp"
+#include "image.hpp"
+#include "node.hpp"
+
+namespace ips::filter
+{
+enum class MorphOp
+{
+    Erode,
+    Dilate,
+    // Erode, then dilate.
+    Open,
+    // Dilate, then erode.
+    Close
+};
+
+// Rectangular width x height structuring element anchored at
+// (width / 2, height / 2). Row and column passes use the van Herk /
+// Gil-Werman running min/max, so the cost per pixel does not depend on
+// the element size. U8C1 masks holding only 0 and 255 run bit-packed.
+// dst may be src; it is reallocated to src's shape and type if needed.
+void morphology(const Image& src, Image& dst, MorphOp op, size_t width,
+                size_t height, const FilterOptions& options = {});
+
+void erode(const Image& src, Image& dst, size_t width, size_t height,
+           const FilterOptions& options = {});
+
+void dilate(const Image& src, Image& dst, size_t width, size_t height,
+            const FilterOptions& options = {});
+
+Node morphologyNode(MorphOp op, size_t width, size_t height,
+                    FilterOptions options = {},
+                    std::string name = "morphology");
+}  // namespace ips::filter
+
+#endif  // IPS_FILTER_MORPHOLOGY_HPP
@@ -0,0 +1,91 @@
+#ifndef IPS_GRAPH_HPP
+#define IPS_GRAPH_HPP
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "image.hpp"
+#include "node.hpp"
+#include "thread_pool.hpp"
+
+namespace ips
+{
+// Dependency graph of Nodes. Every node works on an image that starts as
+// the output of its first input (or a copy of the frame passed to
+// executeRun for nodes without inputs). Further inputs only order execution;
+// their outputs can be read through output() from inside the node, since
+// they are complete by the time it runs. Nodes whose inputs are all done run
+// concurrently on the pool.
+//
+// executeInit plans intermediate storage: a node whose first input has no
+// other pending reader takes over that input's image instead of copying it,
+// and images whose readers have all finished are recycled for later nodes.
+// Only outputs of sinks and of nodes passed to markOutput() are guaranteed
+// to survive until the end of executeRun.
+class Graph
+{
+   public:
+    using NodeId = size_t;
+
+    explicit Graph(ThreadPool* pool = nullptr);
+
+    Graph(const Graph&) = delete;
+    Graph& operator=(const Graph&) = delete;
+
+    NodeId addNode(Node node, const std::vector<NodeId>& inputs = {});
+
+    // Adds an edge so that `to` runs after `from`.
+    void connect(NodeId from, NodeId to);
+
+    // Keeps the output of `id` readable after executeRun.
+    void markOutput(NodeId id);
+
+    // Orders the nodes, rejecting cycles, plans the image buffers and runs
+    // every Init once on the images the frame produces as it flows through
+    // the graph.
+    EXECError executeInit(Image& frame);
+
+    // Runs every node once for the frame.
+    EXECError executeRun(Image& frame);
+
+    const Image& output(NodeId id) const;
+    Image& output(NodeId id);
+
+    size_t size() const noexcept { return Nodes.size(); }
+    const std::vector<NodeId>& order() const noexcept { return Order; }
+
+    // Number of distinct images the plan uses for all node outputs.
+    size_t bufferCount() const noexcept { return Buffers.size(); }
+
+   private:
+    struct Entry
+    {
+        Node Op;
+        std::vector<NodeId> Inputs;
+        std::vector<NodeId> Outputs;
+        bool Keep = false;
+
+        // Filled in by planBuffers().
+        size_t Slot = 0;
+        bool InPlace = false;
+    };
+
+    ThreadPool* Pool;
+    std::vector<Entry> Nodes;
+    std::vector<NodeId> Order;
+    std::vector<Image> Buffers;
+    bool Initialized = false;
+
+    struct RunState;
+
+    void checkId(NodeId id) const;
+    bool sortNodes();
+    void planBuffers();
+    void prepare(NodeId id, const Image& frame);
+    void schedule(const std::shared_ptr<RunState>& state, NodeId id);
+    void runNode(const std::shared_ptr<RunState>& shared, NodeId id);
+};
+}  // namespace ips
+
+#endif  // IPS_GRAPH_HPP
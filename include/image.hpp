@@ -5,6 +5,7 @@
 
 #include <ctype.h>
 #include <memory>
+#include <optional>
 #include <stdexcept>
 #include <string>
 #include <cstring>
@@ -25,6 +26,8 @@ public:
     enum class IMAGE_TYPE
     {
         IMAGE_U8C1,
+        IMAGE_U8C3,
+        IMAGE_U8C4,
         IMAGE_F32C1,
         IMAGE_F32C3
     };
@@ -93,8 +96,14 @@ public:
 
     Image convert(IMAGE_TYPE newType) const;
 
+    // PNG only. Gray+alpha files load as U8C4 with the gray value in all
+    // three colour channels.
     static std::optional<Image> createFromFile(const std::string& filename);
 
+    static size_t channelCount(IMAGE_TYPE type);
+
+    static bool isFloat(IMAGE_TYPE type);
+
 private:
     size_t Width, Height, Channels;
     IMAGE_TYPE m_type;
@@ -0,0 +1,69 @@
+#ifndef IPS_IMAGE_BATCH_HPP
+#define IPS_IMAGE_BATCH_HPP
+
+#include <cstddef>
+#include <span>
+
+#include "image.hpp"
+#include "typed_image.hpp"
+
+namespace ips
+{
+// N images of identical shape and type packed back to back in one
+// allocation (N x H x W x C). The storage is a single Image of width W and
+// height N * H, so kernels that run over a whole image process the entire
+// batch in one call.
+class ImageBatch
+{
+   public:
+    ImageBatch() = default;
+
+    ImageBatch(size_t count, size_t w, size_t h,
+               Image::IMAGE_TYPE type = Image::IMAGE_TYPE::IMAGE_U8C1);
+
+    // All images must have the same width, height and type.
+    static ImageBatch pack(std::span<const Image> images);
+
+    // Copies every batch entry back out; `images` must hold count() images.
+    void unpack(std::span<Image> images) const;
+
+    size_t count() const noexcept { return Count; }
+    size_t width() const noexcept { return Storage.width(); }
+    size_t height() const noexcept { return Count ? Storage.height() / Count : 0; }
+    size_t channels() const noexcept { return Storage.channels(); }
+    Image::IMAGE_TYPE type() const noexcept { return Storage.type(); }
+    bool empty() const noexcept { return Count == 0; }
+
+    Image& storage() noexcept { return Storage; }
+    const Image& storage() const noexcept { return Storage; }
+
+    void copyFrom(size_t index, const Image& image);
+    void copyTo(size_t index, Image& image) const;
+
+    template <typename T, size_t C>
+    TypedImage<T, C> view(size_t index)
+    {
+        checkIndex(index);
+        auto all = TypedImage<T, C>(Storage);
+        return all.region(0, index * height(), width(), height());
+    }
+
+    template <typename T, size_t C>
+    TypedImage<const T, C> view(size_t index) const
+    {
+        checkIndex(index);
+        auto all = TypedImage<const T, C>(Storage);
+        return all.region(0, index * height(), width(), height());
+    }
+
+   private:
+    size_t Count = 0;
+    Image Storage;
+
+    void checkIndex(size_t index) const;
+    void checkShape(const Image& image) const;
+    size_t entryBytes() const;
+};
+}  // namespace ips
+
+#endif  // IPS_IMAGE_BATCH_HPP
@@ -0,0 +1,88 @@
+#ifndef IPS_LUT_HPP
+#define IPS_LUT_HPP
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+
+#include "image.hpp"
+#include "node.hpp"
+#include "parallel.hpp"
+
+namespace ips
+{
+// 256-entry table for an 8-bit point operation. Tables compose: a.then(b)
+// is a single table doing a and then b, so a chain of point operations
+// costs one pass over the image however long it is.
+class LookupTable
+{
+   public:
+    // The identity.
+    LookupTable();
+
+    explicit LookupTable(const std::array<uint8_t, 256>& table);
+
+    // Tabulates fn over 0..255, rounding and saturating its results. Any
+    // uint8_t -> uint8_t StaticPipeline qualifies.
+    template <typename Fn>
+    static LookupTable fromFunction(Fn&& fn)
+    {
+        std::array<uint8_t, 256> table;
+        for (int v = 0; v < 256; ++v)
+        {
+            const auto out = fn(static_cast<uint8_t>(v));
+            if constexpr (std::is_floating_point_v<decltype(out)>)
+                table[v] = static_cast<uint8_t>(std::clamp(
+                    std::lround(static_cast<double>(out)), 0L, 255L));
+            else
+                table[v] = static_cast<uint8_t>(
+                    std::clamp<long long>(static_cast<long long>(out), 0, 255));
+        }
+        return LookupTable(table);
+    }
+
+    // Applying the result equals applying this table, then next.
+    LookupTable then(const LookupTable& next) const;
+
+    uint8_t operator()(uint8_t value) const { return Table[value]; }
+
+    const std::array<uint8_t, 256>& table() const noexcept { return Table; }
+
+    bool isIdentity() const noexcept;
+
+    // Maps every channel of a U8 image. dst may be src; it is reallocated
+    // to src's shape if needed.
+    void apply(const Image& src, Image& dst,
+               const ParallelOptions& options = {}) const;
+
+    Node toNode(std::string name = "lut") const;
+
+   private:
+    std::array<uint8_t, 256> Table;
+};
+
+namespace lut
+{
+// 255 * (v / 255)^(1 / gamma); gamma above 1 brightens midtones.
+LookupTable gamma(float gamma);
+
+// (v - pivot) * gain + pivot.
+LookupTable contrast(float gain, float pivot = 127.5f);
+
+// high above level, low at or below it.
+LookupTable threshold(uint8_t level, uint8_t low = 0, uint8_t high = 255);
+
+LookupTable invert();
+
+// Maps [inLow, inHigh] onto [outLow, outHigh] through a midtone gamma as
+// in gamma(), clipping inputs outside the range.
+LookupTable levels(uint8_t inLow, uint8_t inHigh, uint8_t outLow = 0,
+                   uint8_t outHigh = 255, float gamma = 1.0f);
+}  // namespace lut
+}  // namespace ips
+
+#endif  // IPS_LUT_HPP
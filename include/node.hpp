@@ -1,8 +1,14 @@
 #ifndef IPS_NODE_HPP
 #define IPS_NODE_HPP
 
+#include <cstdint>
 #include <functional>
+#include <memory>
+#include <span>
+#include <string>
 #include "image.hpp"
+#include "image_batch.hpp"
+#include "result_cache.hpp"
 
 namespace ips
 {
@@ -17,16 +23,36 @@ class Node
    public:
     std::function<EXECError(Image&)> Init;
     std::function<EXECError(Image&)> Run;
+    std::string Name;
+
+    // Optional batch entry points. Without them the batch overloads of
+    // executeRun fall back to calling Run once per image.
+    std::function<EXECError(std::span<Image>)> RunBatch;
+    std::function<EXECError(ImageBatch&)> RunPacked;
+
+    // Optional memoization of executeRun(Image&). Results are keyed by the
+    // input contents, Name and ParamHash(), which must change whenever a
+    // parameter that affects the output does. Unchanged inputs then skip Run.
+    std::shared_ptr<ResultCache> Cache;
+    std::function<uint64_t()> ParamHash;
 
     Node() = default;
 
-    Node(std::function<EXECError(Image&)>, std::function<EXECError(Image&)>);
+    Node(std::function<EXECError(Image&)>, std::function<EXECError(Image&)>,
+         std::string name = {});
 
     void setFunctions(std::function<EXECError(Image&)>, std::function<EXECError(Image&)>);
 
+    void setCache(std::shared_ptr<ResultCache> cache,
+                  std::function<uint64_t()> paramHash);
+
     EXECError executeInit(Image&);
     
     EXECError executeRun(Image&);
+
+    EXECError executeRun(std::span<Image>);
+
+    EXECError executeRun(ImageBatch&);
 };
 }  // namespace ips
 
@@ -0,0 +1,159 @@
+#ifndef IPS_PARALLEL_HPP
+#define IPS_PARALLEL_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <stop_token>
+#include <utility>
+#include <vector>
+
+#include "image.hpp"
+#include "thread_pool.hpp"
+
+namespace ips
+{
+struct ParallelOptions
+{
+    // Rows (or tiles) handed to a thread at a time; 0 picks one from the
+    // pool size so that every thread gets a few chunks to balance load.
+    size_t Grain = 0;
+
+    // Work not yet started is skipped once a stop is requested.
+    std::stop_token Stop = {};
+
+    // nullptr uses ThreadPool::global().
+    ThreadPool* Pool = nullptr;
+};
+
+struct Tile
+{
+    size_t X = 0, Y = 0;
+    size_t Width = 0, Height = 0;
+};
+
+namespace detail
+{
+inline ThreadPool& poolOf(const ParallelOptions& options)
+{
+    return options.Pool ? *options.Pool : ThreadPool::global();
+}
+
+inline size_t grainFor(size_t count, size_t grain, const ThreadPool& pool)
+{
+    if (grain > 0) return grain;
+    const size_t chunks = (pool.size() + 1) * 4;
+    return std::max<size_t>(1, (count + chunks - 1) / chunks);
+}
+
+inline uint64_t mortonCode(uint32_t x, uint32_t y)
+{
+    auto spread = [](uint64_t v)
+    {
+        v &= 0xFFFFFFFFull;
+        v = (v | (v << 16)) & 0x0000FFFF0000FFFFull;
+        v = (v | (v << 8)) & 0x00FF00FF00FF00FFull;
+        v = (v | (v << 4)) & 0x0F0F0F0F0F0F0F0Full;
+        v = (v | (v << 2)) & 0x3333333333333333ull;
+        v = (v | (v << 1)) & 0x5555555555555555ull;
+        return v;
+    };
+    return spread(x) | (spread(y) << 1);
+}
+}  // namespace detail
+
+// Calls fn(first, last) over consecutive chunks of [begin, end).
+template <typename Fn>
+bool parallel_for(size_t begin, size_t end, Fn&& fn,
+                  const ParallelOptions& options = {})
+{
+    if (end <= begin) return true;
+
+    ThreadPool& pool = detail::poolOf(options);
+    const size_t count = end - begin;
+    const size_t grain =
+        std::min(count, detail::grainFor(count, options.Grain, pool));
+    const size_t chunks = (count + grain - 1) / grain;
+
+    if (chunks == 1 || pool.size() == 0)
+    {
+        for (size_t first = begin; first < end; first += grain)
+        {
+            if (options.Stop.stop_requested()) return false;
+            fn(first, std::min(end, first + grain));
+        }
+        return true;
+    }
+
+    return pool.parallel(
+        chunks,
+        [&](size_t chunk)
+        {
+            const size_t first = begin + chunk * grain;
+            fn(first, std::min(end, first + grain));
+        },
+        options.Stop);
+}
+
+// Calls fn(firstRow, lastRow) over bands of image rows.
+template <typename Img, typename Fn>
+bool parallel_for_rows(const Img& image, Fn&& fn,
+                       const ParallelOptions& options = {})
+{
+    return parallel_for(0, image.height(), std::forward<Fn>(fn), options);
+}
+
+// Calls fn(tile) for every tileW x tileH tile of the image. Edge tiles are
+// clipped. Tiles are handed out in Z-order so that consecutive tiles, and
+// the tiles threads work on at the same time, stay close in memory.
+template <typename Img, typename Fn>
+bool parallel_for_tiles(const Img& image, size_t tileW, size_t tileH, Fn&& fn,
+                        const ParallelOptions& options = {})
+{
+    if (tileW == 0 || tileH == 0)
+    {
+        throw std::invalid_argument("parallel_for_tiles: tile size is zero");
+    }
+
+    const size_t w = image.width(), h = image.height();
+    if (w == 0 || h == 0) return true;
+
+    const size_t tilesX = (w + tileW - 1) / tileW;
+    const size_t tilesY = (h + tileH - 1) / tileH;
+
+    std::vector<std::pair<uint64_t, uint32_t>> order;
+    order.reserve(tilesX * tilesY);
+    for (size_t ty = 0; ty < tilesY; ++ty)
+    {
+        for (size_t tx = 0; tx < tilesX; ++tx)
+        {
+            order.emplace_back(detail::mortonCode(static_cast<uint32_t>(tx),
+                                                  static_cast<uint32_t>(ty)),
+                               static_cast<uint32_t>(ty * tilesX + tx));
+        }
+    }
+    std::sort(order.begin(), order.end());
+
+    return parallel_for(
+        0, order.size(),
+        [&](size_t first, size_t last)
+        {
+            for (size_t i = first; i < last; ++i)
+            {
+                const size_t tx = order[i].second % tilesX;
+                const size_t ty = order[i].second / tilesX;
+
+                Tile tile;
+                tile.X = tx * tileW;
+                tile.Y = ty * tileH;
+                tile.Width = std::min(tileW, w - tile.X);
+                tile.Height = std::min(tileH, h - tile.Y);
+                fn(tile);
+            }
+        },
+        options);
+}
+}  // namespace ips
+
+#endif  // IPS_PARALLEL_HPP
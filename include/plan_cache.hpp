@@ -0,0 +1,142 @@
+#ifndef IPS_PLAN_CACHE_HPP
+#define IPS_PLAN_CACHE_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "image.hpp"
+#include "node.hpp"
+
+namespace ips
+{
+// The part of an image a plan may depend on.
+struct ShapeKey
+{
+    size_t Width = 0;
+    size_t Height = 0;
+    size_t Channels = 0;
+    Image::IMAGE_TYPE Type = Image::IMAGE_TYPE::IMAGE_U8C1;
+
+    static ShapeKey of(const Image& image)
+    {
+        return {image.width(), image.height(), image.channels(), image.type()};
+    }
+
+    bool operator==(const ShapeKey&) const = default;
+};
+
+// Precomputed per-shape state (coefficient tables, LUTs, tile schedules)
+// built once per input shape and reused for every frame of that shape. A
+// few shapes are kept, least recently used first out. Key is anything
+// equality-comparable that determines the plan. Safe to share between
+// threads; plans are immutable once built.
+template <typename Plan, typename Key = ShapeKey>
+class PlanCache
+{
+   public:
+    using Builder = std::function<Plan(const Key&)>;
+
+    explicit PlanCache(Builder builder, size_t capacity = 4)
+        : Build(std::move(builder)), Capacity(capacity ? capacity : 1)
+    {
+    }
+
+    // Returns the plan for the shape, building it on first use. A stream of
+    // same-shape frames only pays a key comparison.
+    std::shared_ptr<const Plan> get(const Key& key)
+    {
+        {
+            std::lock_guard<std::mutex> lock(Mutex);
+            for (size_t i = 0; i < Plans.size(); ++i)
+            {
+                if (Plans[i].first == key)
+                {
+                    if (i) std::rotate(Plans.begin(), Plans.begin() + i,
+                                       Plans.begin() + i + 1);
+                    return Plans.front().second;
+                }
+            }
+        }
+
+        // Built outside the lock so a slow plan does not stall other shapes.
+        auto plan = std::make_shared<const Plan>(Build(key));
+
+        std::lock_guard<std::mutex> lock(Mutex);
+        ++Builds;
+        for (auto& entry : Plans)
+        {
+            // Another thread built the same shape meanwhile.
+            if (entry.first == key) return entry.second;
+        }
+        if (Plans.size() == Capacity) Plans.pop_back();
+        Plans.insert(Plans.begin(), {key, plan});
+        return plan;
+    }
+
+    std::shared_ptr<const Plan> get(const Image& image)
+        requires std::is_same_v<Key, ShapeKey>
+    {
+        return get(ShapeKey::of(image));
+    }
+
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(Mutex);
+        Plans.clear();
+    }
+
+    size_t size() const
+    {
+        std::lock_guard<std::mutex> lock(Mutex);
+        return Plans.size();
+    }
+
+    // Number of times the builder ran.
+    size_t builds() const
+    {
+        std::lock_guard<std::mutex> lock(Mutex);
+        return Builds;
+    }
+
+   private:
+    Builder Build;
+    size_t Capacity;
+    mutable std::mutex Mutex;
+    std::vector<std::pair<Key, std::shared_ptr<const Plan>>> Plans;
+    size_t Builds = 0;
+};
+
+// Node whose Init builds the plan for the input shape and whose Run reuses
+// it, replanning only when a frame of a new shape arrives.
+template <typename Plan>
+Node make_planned_node(
+    typename PlanCache<Plan>::Builder plan,
+    std::function<EXECError(Image&, const Plan&)> run, std::string name = {},
+    size_t capacity = 4)
+{
+    auto cache = std::make_shared<PlanCache<Plan>>(std::move(plan), capacity);
+
+    auto init = [cache](Image& image)
+    {
+        cache->get(image);
+        return EXECError::EXEC_SUCCESS;
+    };
+
+    auto step = [cache, run = std::move(run)](Image& image)
+    {
+        auto current = cache->get(image);
+        return run(image, *current);
+    };
+
+    return Node(std::move(init), std::move(step), std::move(name));
+}
+}  // namespace ips
+
+#endif  // IPS_PLAN_CACHE_HPP
@@ -0,0 +1,138 @@
+#ifndef IPS_PROFILER_HPP
+#define IPS_PROFILER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "image.hpp"
+
+// Instrumentation is only compiled in when IPS_ENABLE_PROFILING is defined
+// (CMake option IPS_ENABLE_PROFILING). Otherwise IPS_PROFILE_SCOPE expands
+// to nothing and the Profiler only ever reports an empty trace.
+#ifdef IPS_ENABLE_PROFILING
+#define IPS_PROFILE_CONCAT_IMPL(a, b) a##b
+#define IPS_PROFILE_CONCAT(a, b) IPS_PROFILE_CONCAT_IMPL(a, b)
+#define IPS_PROFILE_SCOPE(name, category, image)             \
+    ::ips::ProfileScope IPS_PROFILE_CONCAT(ipsProfileScope_, \
+                                           __LINE__)(name, category, image)
+#else
+#define IPS_PROFILE_SCOPE(name, category, image) \
+    do                                           \
+    {                                            \
+    } while (0)
+#endif
+
+namespace ips
+{
+struct ProfileEvent
+{
+    std::string Name;
+    const char* Category = "";
+
+    // Nanoseconds since the profiler was created.
+    uint64_t Start = 0;
+    uint64_t Wall = 0;
+    uint64_t Cpu = 0;
+    uint32_t Thread = 0;
+
+    size_t InWidth = 0, InHeight = 0, InChannels = 0, InBytes = 0;
+    size_t OutWidth = 0, OutHeight = 0, OutChannels = 0, OutBytes = 0;
+};
+
+struct ProfileSummary
+{
+    std::string Name;
+    std::string Category;
+    size_t Count = 0;
+
+    // Wall times in nanoseconds.
+    uint64_t Total = 0;
+    uint64_t Mean = 0;
+    uint64_t P50 = 0;
+    uint64_t P99 = 0;
+    uint64_t Max = 0;
+
+    uint64_t TotalCpu = 0;
+};
+
+class Profiler
+{
+   public:
+    static Profiler& instance();
+
+    Profiler(const Profiler&) = delete;
+    Profiler& operator=(const Profiler&) = delete;
+
+    // Recording can be paused at run time on top of the compile-time switch.
+    void setEnabled(bool enabled) noexcept
+    {
+        Enabled.store(enabled, std::memory_order_relaxed);
+    }
+    bool enabled() const noexcept
+    {
+        return Enabled.load(std::memory_order_relaxed);
+    }
+
+    void record(ProfileEvent event);
+    void clear();
+
+    std::vector<ProfileEvent> events() const;
+
+    // Chrome Trace Event JSON, loadable in Perfetto or chrome://tracing.
+    void writeChromeTrace(std::ostream& out) const;
+    bool writeChromeTrace(const std::string& path) const;
+
+    // Per (name, category) statistics, sorted by total wall time.
+    std::vector<ProfileSummary> summary() const;
+    std::string summaryTable() const;
+
+    uint64_t now() const noexcept;
+
+    // Small stable id for the calling thread.
+    static uint32_t threadId();
+
+    // CPU time consumed by the calling thread, in nanoseconds.
+    static uint64_t threadCpuTime() noexcept;
+
+   private:
+    Profiler();
+
+    std::chrono::steady_clock::time_point Epoch;
+    mutable std::mutex Mutex;
+    std::vector<ProfileEvent> Events;
+    std::atomic<bool> Enabled{true};
+};
+
+// Records one event covering its lifetime. The image is sampled on entry
+// and on exit so that both input and output shapes are reported.
+class ProfileScope
+{
+   public:
+    ProfileScope(const std::string& name, const char* category,
+                 const Image* image);
+    ProfileScope(const std::string& name, const char* category,
+                 const Image& image)
+        : ProfileScope(name, category, &image)
+    {
+    }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+    ~ProfileScope();
+
+   private:
+    const Image* Target;
+    ProfileEvent Event;
+    uint64_t CpuStart = 0;
+    bool Active;
+};
+}  // namespace ips
+
+#endif  // IPS_PROFILER_HPP
@@ -0,0 +1,155 @@
+#ifndef IPS_REGION_GRAPH_HPP
+#define IPS_REGION_GRAPH_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "image.hpp"
+#include "node.hpp"
+#include "result_cache.hpp"
+#include "thread_pool.hpp"
+
+namespace ips
+{
+// Pixel rectangle. The origin may lie outside an image while regions are
+// being mapped; clip() brings it back into bounds.
+struct Rect
+{
+    std::ptrdiff_t X = 0, Y = 0;
+    size_t Width = 0, Height = 0;
+
+    bool empty() const noexcept { return Width == 0 || Height == 0; }
+
+    std::ptrdiff_t right() const noexcept
+    {
+        return X + static_cast<std::ptrdiff_t>(Width);
+    }
+    std::ptrdiff_t bottom() const noexcept
+    {
+        return Y + static_cast<std::ptrdiff_t>(Height);
+    }
+
+    Rect expand(size_t margin) const noexcept
+    {
+        const auto m = static_cast<std::ptrdiff_t>(margin);
+        return {X - m, Y - m, Width + 2 * margin, Height + 2 * margin};
+    }
+
+    Rect clip(size_t width, size_t height) const noexcept
+    {
+        const std::ptrdiff_t x0 = std::max<std::ptrdiff_t>(X, 0);
+        const std::ptrdiff_t y0 = std::max<std::ptrdiff_t>(Y, 0);
+        const std::ptrdiff_t x1 =
+            std::min(right(), static_cast<std::ptrdiff_t>(width));
+        const std::ptrdiff_t y1 =
+            std::min(bottom(), static_cast<std::ptrdiff_t>(height));
+        if (x1 <= x0 || y1 <= y0) return {x0, y0, 0, 0};
+        return {x0, y0, static_cast<size_t>(x1 - x0),
+                static_cast<size_t>(y1 - y0)};
+    }
+
+    bool operator==(const Rect&) const = default;
+};
+
+// Operation in a LazyGraph. Run computes the pixels of outRect (in output
+// coordinates) from `in`, which holds inRect of the input image: the
+// region InputRegion(outRect) asked for, clipped to the input bounds.
+// LazyGraph computes tiles in parallel, so Run is called concurrently for
+// different tiles and must be safe to call that way.
+class RegionNode
+{
+   public:
+    using RunFn = std::function<EXECError(const Image& in, const Rect& inRect,
+                                          Image& out, const Rect& outRect)>;
+
+    RunFn Run;
+    // Defaults to the identity, which suits point operations.
+    std::function<Rect(const Rect&)> InputRegion;
+    // Output width and height for an input size; defaults to the identity.
+    std::function<std::pair<size_t, size_t>(size_t, size_t)> OutputSize;
+    std::string Name;
+
+    RegionNode() = default;
+
+    explicit RegionNode(RunFn run, std::string name = {});
+
+    // Adapts a size-preserving Node that reads at most `halo` pixels around
+    // each output pixel. It runs on the output region grown by the halo
+    // and the result is cropped back. The Node's Run is therefore called
+    // concurrently too, on different images.
+    static RegionNode fromNode(Node node, size_t halo = 0);
+};
+
+// Demand-driven graph: nothing runs until a region of a node's output is
+// requested. Outputs are computed in fixed-size tiles, each tile asks its
+// input only for the region it depends on, and finished tiles are kept in
+// an LRU cache, so pan and zoom cost scales with the viewport rather than
+// the image.
+class LazyGraph
+{
+   public:
+    // Returns the pixels of the given region of the source image. Called
+    // concurrently for different tiles; a source reading through a shared
+    // file handle or decoder has to lock around it.
+    using Source = std::function<std::optional<Image>(const Rect&)>;
+
+    explicit LazyGraph(size_t tileSize = 256,
+                       size_t cacheBytes = size_t(256) << 20,
+                       ThreadPool* pool = nullptr);
+
+    // The source is always node 0; setting it again replaces it. See Source
+    // for its thread-safety requirement.
+    size_t setSource(size_t width, size_t height, Source source);
+
+    // Returns the id of the new node, which reads the output of `input`.
+    size_t addNode(RegionNode node, size_t input);
+
+    size_t width(size_t id) const;
+    size_t height(size_t id) const;
+
+    // Fills `out` with `region` of node `id`, clipped to its bounds.
+    EXECError request(size_t id, const Rect& region, Image& out);
+
+    // Drops the cached tiles of `id` and of every node downstream of it,
+    // e.g. after changing its parameters. Not safe to call concurrently
+    // with request().
+    void invalidate(size_t id);
+
+    ResultCache& cache() noexcept { return Tiles; }
+
+    size_t tileSize() const noexcept { return TileSize; }
+
+    // Tiles computed (not served from the cache) so far.
+    size_t computedTiles() const noexcept
+    {
+        return Computed.load(std::memory_order_relaxed);
+    }
+
+   private:
+    struct Entry
+    {
+        RegionNode Op;
+        Source Read;
+        size_t Input = static_cast<size_t>(-1);
+        size_t Width = 0, Height = 0;
+        uint64_t Generation = 0;
+    };
+
+    std::vector<Entry> Nodes;
+    size_t TileSize;
+    ResultCache Tiles;
+    ThreadPool* Pool;
+    std::atomic<size_t> Computed{0};
+
+    EXECError tile(size_t id, size_t tx, size_t ty, Image& out);
+};
+}  // namespace ips
+
+#endif  // IPS_REGION_GRAPH_HPP
@@ -0,0 +1,98 @@
+#ifndef IPS_RESULT_CACHE_HPP
+#define IPS_RESULT_CACHE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+
+#include "image.hpp"
+
+namespace ips
+{
+// 64-bit non-cryptographic hash (xxHash64 construction), several GB/s.
+uint64_t hashBytes(const void* data, size_t size, uint64_t seed = 0) noexcept;
+
+// Hashes the shape, type and pixel contents.
+uint64_t hashImage(const Image& image) noexcept;
+
+inline uint64_t hashCombine(uint64_t a, uint64_t b) noexcept
+{
+    // Order dependent; multiply-xorshift keeps both inputs in every bit.
+    a ^= b + 0x9e3779b97f4a7c15ull + (a << 6) + (a >> 2);
+    a *= 0xbf58476d1ce4e5b9ull;
+    return a ^ (a >> 31);
+}
+
+inline uint64_t hashParams() noexcept { return 0; }
+
+// Hash of a list of parameter values, e.g. hashParams(sigma, radius).
+template <typename T, typename... Rest>
+uint64_t hashParams(const T& value, const Rest&... rest) noexcept
+{
+    uint64_t h;
+    if constexpr (std::is_convertible_v<const T&, std::string_view>)
+    {
+        const std::string_view text(value);
+        h = hashBytes(text.data(), text.size());
+    }
+    else
+    {
+        static_assert(std::is_trivially_copyable_v<T>,
+                      "hashParams needs trivially copyable values");
+        h = hashBytes(&value, sizeof(T));
+    }
+    return hashCombine(h, hashParams(rest...));
+}
+
+// Thread-safe LRU map from a 64-bit key to a result image, bounded by the
+// total pixel bytes it holds. Images larger than the budget are not kept.
+class ResultCache
+{
+   public:
+    explicit ResultCache(size_t byteBudget = size_t(256) << 20);
+
+    ResultCache(const ResultCache&) = delete;
+    ResultCache& operator=(const ResultCache&) = delete;
+
+    // Copies the cached image into `out` and marks it most recently used.
+    bool lookup(uint64_t key, Image& out);
+
+    void insert(uint64_t key, const Image& image);
+
+    void erase(uint64_t key);
+    void clear();
+
+    // Shrinking the budget evicts right away.
+    void setBudget(size_t byteBudget);
+
+    size_t budget() const;
+    size_t bytes() const;
+    size_t size() const;
+    size_t hits() const;
+    size_t misses() const;
+
+   private:
+    struct Entry
+    {
+        uint64_t Key;
+        std::shared_ptr<const Image> Result;
+    };
+
+    mutable std::mutex Mutex;
+    std::list<Entry> Entries;  // most recently used first
+    std::unordered_map<uint64_t, std::list<Entry>::iterator> Index;
+    size_t Budget;
+    size_t Bytes = 0;
+    size_t Hits = 0;
+    size_t Misses = 0;
+
+    void evict();
+};
+}  // namespace ips
+
+#endif  // IPS_RESULT_CACHE_HPP
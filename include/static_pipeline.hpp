@@ -0,0 +1,269 @@
+#ifndef IPS_STATIC_PIPELINE_HPP
+#define IPS_STATIC_PIPELINE_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "image.hpp"
+#include "image_batch.hpp"
+#include "node.hpp"
+#include "parallel.hpp"
+#include "typed_image.hpp"
+
+namespace ips
+{
+namespace detail
+{
+template <typename In, typename... Ops>
+struct ChainResult
+{
+    using type = In;
+};
+
+template <typename In, typename Op, typename... Rest>
+struct ChainResult<In, Op, Rest...>
+{
+    static_assert(std::is_invocable_v<const Op&, In>,
+                  "Pipeline stage cannot take the previous stage's output");
+
+    using type = typename ChainResult<std::invoke_result_t<const Op&, In>,
+                                      Rest...>::type;
+};
+}  // namespace detail
+
+// Element-wise point operations composed at compile time. Every element of
+// the image runs through all stages in one loop, so the whole chain is a
+// single pass that the compiler can inline and vectorize. Stages are any
+// callables taking the previous stage's element type; the chain is checked
+// when the pipeline is applied to a concrete input type.
+template <typename... Ops>
+class StaticPipeline
+{
+   public:
+    template <typename In>
+    using output_type = typename detail::ChainResult<In, Ops...>::type;
+
+    explicit StaticPipeline(Ops... ops) : m_ops(std::move(ops)...) {}
+
+    template <typename In>
+    output_type<In> operator()(In value) const
+    {
+        return invoke<0>(m_ops, value);
+    }
+
+    // src and dst may be the same view.
+    template <typename In, typename Out, size_t C>
+    void apply(TypedImage<const In, C> src, TypedImage<Out, C> dst,
+               const ParallelOptions& options = {}) const
+    {
+        static_assert(std::is_same_v<Out, output_type<In>>,
+                      "Destination element type does not match the "
+                      "pipeline output");
+
+        if (src.width() != dst.width() || src.height() != dst.height())
+        {
+            throw std::invalid_argument("StaticPipeline: size mismatch");
+        }
+
+        const size_t n = src.width() * C;
+        parallel_for_rows(
+            src,
+            [&](size_t first, size_t last)
+            {
+                // Byte stores may alias anything reached through a pointer,
+                // including the stage parameters and the captures; local
+                // copies keep them in registers and the loop vectorizable.
+                const std::tuple<Ops...> stages = m_ops;
+                const size_t count = n;
+
+                for (size_t y = first; y < last; ++y)
+                {
+                    const In* s = src.row(y);
+                    Out* d = dst.row(y);
+                    for (size_t i = 0; i < count; ++i)
+                    {
+                        d[i] = invoke<0>(stages, s[i]);
+                    }
+                }
+            },
+            options);
+    }
+
+    template <typename In, size_t C>
+    void apply(TypedImage<In, C> image,
+               const ParallelOptions& options = {}) const
+    {
+        apply<In, In, C>(image, image, options);
+    }
+
+    // Wraps the pipeline as a single Node for In images with C channels.
+    // The image is replaced when the output element type differs.
+    template <typename In, size_t C>
+    Node toNode(std::string name = {}) const
+    {
+        using Out = output_type<In>;
+        // Rejects outputs that no Image type can hold.
+        [[maybe_unused]] constexpr auto outType =
+            detail::imageTypeOf<Out, C>();
+
+        auto run = [pipeline = *this](Image& image)
+        {
+            if (!TypedImage<In, C>::matches(image)) return EXECError::EXEC_FAIL;
+
+            if constexpr (std::is_same_v<Out, In>)
+            {
+                pipeline.apply(TypedImage<In, C>(image));
+            }
+            else
+            {
+                Image out(image.width(), image.height(), C,
+                          detail::imageTypeOf<Out, C>());
+                pipeline.template apply<In, Out, C>(
+                    TypedImage<const In, C>(image), TypedImage<Out, C>(out));
+                image = std::move(out);
+            }
+            return EXECError::EXEC_SUCCESS;
+        };
+
+        // Small images are spread over threads one image each instead of
+        // splitting every image into row bands.
+        auto runBatch = [pipeline = *this](std::span<Image> images)
+        {
+            for (const auto& image : images)
+            {
+                if (!TypedImage<In, C>::matches(image))
+                    return EXECError::EXEC_FAIL;
+            }
+
+            parallel_for(
+                0, images.size(),
+                [&](size_t first, size_t last)
+                {
+                    ParallelOptions serial;
+                    serial.Grain = static_cast<size_t>(-1);
+
+                    for (size_t i = first; i < last; ++i)
+                    {
+                        Image& image = images[i];
+                        if constexpr (std::is_same_v<Out, In>)
+                        {
+                            pipeline.apply(TypedImage<In, C>(image), serial);
+                        }
+                        else
+                        {
+                            Image out(image.width(), image.height(), C,
+                                      detail::imageTypeOf<Out, C>());
+                            pipeline.template apply<In, Out, C>(
+                                TypedImage<const In, C>(image),
+                                TypedImage<Out, C>(out), serial);
+                            image = std::move(out);
+                        }
+                    }
+                });
+            return EXECError::EXEC_SUCCESS;
+        };
+
+        // A packed batch is one tall image, so it runs as a single pass.
+        auto runPacked = [pipeline = *this](ImageBatch& batch)
+        {
+            if (batch.empty()) return EXECError::EXEC_SUCCESS;
+            if (!TypedImage<In, C>::matches(batch.storage()))
+                return EXECError::EXEC_FAIL;
+
+            if constexpr (std::is_same_v<Out, In>)
+            {
+                pipeline.apply(TypedImage<In, C>(batch.storage()));
+            }
+            else
+            {
+                ImageBatch out(batch.count(), batch.width(), batch.height(),
+                               detail::imageTypeOf<Out, C>());
+                pipeline.template apply<In, Out, C>(
+                    TypedImage<const In, C>(batch.storage()),
+                    TypedImage<Out, C>(out.storage()));
+                batch = std::move(out);
+            }
+            return EXECError::EXEC_SUCCESS;
+        };
+
+        Node node(nullptr, std::move(run), std::move(name));
+        node.RunBatch = std::move(runBatch);
+        node.RunPacked = std::move(runPacked);
+        return node;
+    }
+
+   private:
+    std::tuple<Ops...> m_ops;
+
+    template <size_t I, typename V>
+    static auto invoke(const std::tuple<Ops...>& stages, V value)
+    {
+        if constexpr (I == sizeof...(Ops))
+            return value;
+        else
+            return invoke<I + 1>(stages, std::get<I>(stages)(value));
+    }
+};
+
+template <typename... Ops>
+StaticPipeline<std::decay_t<Ops>...> make_pipeline(Ops&&... ops)
+{
+    return StaticPipeline<std::decay_t<Ops>...>(std::forward<Ops>(ops)...);
+}
+
+namespace ops
+{
+struct ToFloat
+{
+    template <typename T>
+    float operator()(T value) const
+    {
+        return static_cast<float>(value);
+    }
+};
+
+// value * Scale + Offset, in float.
+struct Affine
+{
+    float Scale = 1.0f;
+    float Offset = 0.0f;
+
+    template <typename T>
+    float operator()(T value) const
+    {
+        return static_cast<float>(value) * Scale + Offset;
+    }
+};
+
+struct Clamp
+{
+    float Lo = 0.0f;
+    float Hi = 1.0f;
+
+    float operator()(float value) const
+    {
+        return std::min(std::max(value, Lo), Hi);
+    }
+};
+
+// Rounds and saturates to [0, 255].
+struct ToU8
+{
+    uint8_t operator()(float value) const
+    {
+        return static_cast<uint8_t>(
+            std::min(std::max(value + 0.5f, 0.0f), 255.0f));
+    }
+
+    uint8_t operator()(uint8_t value) const { return value; }
+};
+}  // namespace ops
+}  // namespace ips
+
+#endif  // IPS_STATIC_PIPELINE_HPP
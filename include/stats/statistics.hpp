@@ -0,0 +1,68 @@
+#ifndef IPS_STATS_STATISTICS_HPP
+#define IPS_STATS_STATISTICS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <vector>
+
+#include "image.hpp"
+#include "parallel.hpp"
+
+namespace ips::stats
+{
+// Bin counts of one channel. Bin i covers [Low + i * BinWidth,
+// Low + (i + 1) * BinWidth); U8 histograms have 256 bins with Low 0 and
+// BinWidth 1, one per value.
+struct Histogram
+{
+    float Low = 0.0f;
+    float BinWidth = 1.0f;
+    std::vector<uint64_t> Bins;
+    uint64_t Total = 0;
+
+    // Lower edge of the bin holding the nearest-rank p-th percentile,
+    // p in [0, 100]. Exact for U8 histograms.
+    float percentile(double p) const;
+
+    // Several percentiles from one cumulative pass; ps must be ascending.
+    std::vector<float> percentiles(std::span<const double> ps) const;
+};
+
+struct HistogramOptions
+{
+    // Bin count for F32 images; U8 images always get 256 bins.
+    size_t Bins = 256;
+    // Range binned for F32 images. Low == High uses the image's min and
+    // max over all channels; samples outside land in the end bins.
+    float Low = 0.0f, High = 0.0f;
+    ParallelOptions Parallel = {};
+};
+
+struct ChannelStats
+{
+    double Min = std::numeric_limits<double>::infinity();
+    double Max = -std::numeric_limits<double>::infinity();
+    double Sum = 0.0;
+    double SumSq = 0.0;
+    uint64_t Count = 0;
+
+    double mean() const;
+    // Population variance.
+    double variance() const;
+    double stddev() const;
+
+    ChannelStats& merge(const ChannelStats& other);
+};
+
+// One histogram per channel.
+std::vector<Histogram> histogram(const Image& src,
+                                 const HistogramOptions& options = {});
+
+// Min, max, sum and sum of squares per channel in a single pass.
+std::vector<ChannelStats> statistics(const Image& src,
+                                     const ParallelOptions& options = {});
+}  // namespace ips::stats
+
+#endif  // IPS_STATS_STATISTICS_HPP
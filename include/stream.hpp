@@ -0,0 +1,94 @@
+#ifndef IPS_STREAM_HPP
+#define IPS_STREAM_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+#include "image.hpp"
+#include "node.hpp"
+
+namespace ips
+{
+// Pipelined source -> stages -> sink runner for frame streams. The source,
+// every stage thread and the sink run concurrently and hand frames over
+// through bounded lock-free queues, so frame N+1 can be decoded while N is
+// processed and N-1 is written. A full queue blocks its producer
+// (backpressure). Stages with several threads call their Node concurrently
+// for different frames; the sink still receives frames in source order.
+class StreamRunner
+{
+   public:
+    // Returns the next frame, or nullopt at the end of the stream.
+    using Source = std::function<std::optional<Image>()>;
+    using Sink = std::function<EXECError(Image&)>;
+
+    struct StageMetrics
+    {
+        size_t Threads = 0;
+        size_t QueueCapacity = 0;
+        size_t QueueDepth = 0;
+        size_t MaxQueueDepth = 0;
+        double MeanQueueDepth = 0.0;
+        size_t Frames = 0;
+        // Times the upstream producer found this stage's queue full.
+        size_t Stalls = 0;
+    };
+
+    explicit StreamRunner(size_t queueCapacity = 4);
+
+    StreamRunner(const StreamRunner&) = delete;
+    StreamRunner& operator=(const StreamRunner&) = delete;
+
+    ~StreamRunner();
+
+    void setSource(Source source);
+    void addStage(Node node, size_t threads = 1);
+    void setSink(Sink sink);
+
+    // Streams until the source is exhausted, a stage or the sink fails, or
+    // requestStop() is called. Frames already read are still delivered
+    // after a stop request. A stop requested before run() applies to the
+    // next run; the request is cleared when a run returns.
+    EXECError run();
+
+    void requestStop() noexcept;
+
+    // One entry per stage followed by one for the sink. Safe to call while
+    // run() is in progress.
+    std::vector<StageMetrics> metrics() const;
+
+   private:
+    struct Stage
+    {
+        Node Op;
+        size_t Threads;
+    };
+
+    struct Channel;
+
+    Source Input;
+    Sink Output;
+    std::vector<Stage> Stages;
+    size_t Capacity;
+
+    // Replaced at the start of each run; guarded so metrics() can read
+    // them from other threads meanwhile.
+    mutable std::mutex ChannelsMutex;
+    std::vector<std::unique_ptr<Channel>> Channels;
+    std::vector<std::unique_ptr<std::atomic<size_t>>> Processed;
+    std::atomic<bool> Stopping{false};
+    std::atomic<bool> Failed{false};
+
+    void runSource(Channel& out);
+    void runStage(Stage& stage, Channel& in, Channel& out,
+                  std::atomic<size_t>& processed);
+    void runSink(Channel& in, std::atomic<size_t>& processed);
+};
+}  // namespace ips
+
+#endif  // IPS_STREAM_HPP
@@ -0,0 +1,150 @@
+#ifndef IPS_TASK_HPP
+#define IPS_TASK_HPP
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+
+namespace ips
+{
+template <typename T>
+class Task;
+
+namespace detail
+{
+template <typename T>
+struct TaskPromiseBase
+{
+    std::coroutine_handle<> Continuation;
+    std::exception_ptr Error;
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+
+    // Hands control straight to the awaiting coroutine (symmetric transfer)
+    // so that long await chains do not grow the stack.
+    struct FinalAwaiter
+    {
+        bool await_ready() noexcept { return false; }
+
+        template <typename P>
+        std::coroutine_handle<> await_suspend(
+            std::coroutine_handle<P> handle) noexcept
+        {
+            auto next = handle.promise().Continuation;
+            return next ? next : std::noop_coroutine();
+        }
+
+        void await_resume() noexcept {}
+    };
+
+    FinalAwaiter final_suspend() noexcept { return {}; }
+
+    void unhandled_exception() noexcept { Error = std::current_exception(); }
+};
+
+template <typename T>
+struct TaskPromise : TaskPromiseBase<T>
+{
+    std::optional<T> Value;
+
+    Task<T> get_return_object() noexcept;
+
+    void return_value(T value) { Value.emplace(std::move(value)); }
+
+    T result()
+    {
+        if (this->Error) std::rethrow_exception(this->Error);
+        return std::move(*Value);
+    }
+};
+
+template <>
+struct TaskPromise<void> : TaskPromiseBase<void>
+{
+    Task<void> get_return_object() noexcept;
+
+    void return_void() noexcept {}
+
+    void result()
+    {
+        if (this->Error) std::rethrow_exception(this->Error);
+    }
+};
+}  // namespace detail
+
+// Lazily started coroutine producing a T. It starts running when awaited
+// and resumes its awaiter on whichever thread it finishes on.
+template <typename T = void>
+class [[nodiscard]] Task
+{
+   public:
+    using promise_type = detail::TaskPromise<T>;
+    using handle_type = std::coroutine_handle<promise_type>;
+
+    Task() noexcept = default;
+
+    explicit Task(handle_type handle) noexcept : Handle(handle) {}
+
+    Task(Task&& other) noexcept : Handle(std::exchange(other.Handle, {})) {}
+
+    Task& operator=(Task&& other) noexcept
+    {
+        if (this != &other)
+        {
+            if (Handle) Handle.destroy();
+            Handle = std::exchange(other.Handle, {});
+        }
+        return *this;
+    }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    ~Task()
+    {
+        if (Handle) Handle.destroy();
+    }
+
+    bool valid() const noexcept { return static_cast<bool>(Handle); }
+
+    auto operator co_await() && noexcept { return Awaiter{Handle}; }
+    auto operator co_await() & noexcept { return Awaiter{Handle}; }
+
+   private:
+    struct Awaiter
+    {
+        handle_type Handle;
+
+        bool await_ready() const noexcept { return !Handle || Handle.done(); }
+
+        std::coroutine_handle<> await_suspend(
+            std::coroutine_handle<> awaiting) noexcept
+        {
+            Handle.promise().Continuation = awaiting;
+            return Handle;
+        }
+
+        T await_resume() { return Handle.promise().result(); }
+    };
+
+    handle_type Handle;
+};
+
+namespace detail
+{
+template <typename T>
+Task<T> TaskPromise<T>::get_return_object() noexcept
+{
+    return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+}
+
+inline Task<void> TaskPromise<void>::get_return_object() noexcept
+{
+    return Task<void>(
+        std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+}
+}  // namespace detail
+}  // namespace ips
+
+#endif  // IPS_TASK_HPP
@@ -0,0 +1,72 @@
+#ifndef IPS_THREAD_POOL_HPP
+#define IPS_THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+namespace ips
+{
+// Work-stealing pool: every worker owns a deque it pushes to and pops from
+// at the back, idle workers steal from the front of other deques. Tasks
+// submitted from outside the pool go to a shared injection deque.
+class ThreadPool
+{
+   public:
+    // threads == 0 creates one worker per hardware thread.
+    explicit ThreadPool(size_t threads = 0);
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    ~ThreadPool();
+
+    size_t size() const noexcept { return Workers.size(); }
+
+    void submit(std::function<void()> task);
+
+    // Runs one queued task on the calling thread, if there is any. Threads
+    // waiting on pool work call this to help instead of blocking.
+    bool runPendingTask();
+
+    // Calls fn(i) for every i in [0, count) using the workers and the calling
+    // thread, and returns once all calls have finished. Indices not yet
+    // started when `stop` is requested are skipped. The first exception
+    // thrown by fn is rethrown here. Returns false if any index was skipped.
+    bool parallel(size_t count, const std::function<void(size_t)>& fn,
+                  std::stop_token stop = {});
+
+    // Shared library pool. The worker count can be set with the
+    // IPS_NUM_THREADS environment variable.
+    static ThreadPool& global();
+
+   private:
+    struct TaskQueue
+    {
+        std::mutex Mutex;
+        std::deque<std::function<void()>> Tasks;
+    };
+
+    std::vector<std::thread> Workers;
+    // One deque per worker followed by the injection deque.
+    std::vector<std::unique_ptr<TaskQueue>> Queues;
+    std::atomic<size_t> Pending{0};
+
+    std::mutex SleepMutex;
+    std::condition_variable Ready;
+    bool Stopping = false;
+
+    bool popTask(size_t self, std::function<void()>& task);
+    void workerLoop(size_t index);
+};
+}  // namespace ips
+
+#endif  // IPS_THREAD_POOL_HPP
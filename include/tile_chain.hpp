@@ -0,0 +1,67 @@
+#ifndef IPS_TILE_CHAIN_HPP
+#define IPS_TILE_CHAIN_HPP
+
+#include <cstddef>
+#include <vector>
+
+#include "image.hpp"
+#include "node.hpp"
+#include "thread_pool.hpp"
+
+namespace ips
+{
+// Runs a chain of Nodes band by band instead of image by image. Each band of
+// full-width rows is copied into a small scratch image that passes through
+// every stage while it is still in cache; only the final rows are written
+// back. Stages must keep the width, row count and type of the image they
+// get. A stage that reads neighbouring rows declares how many with
+// `haloRows`; bands are then extended by the summed halos of all stages.
+//
+// Bands run in parallel on the pool, so each stage's Run is called
+// concurrently on different band images. Stages must be safe to run that
+// way, without unsynchronized state shared between calls, unless the chain
+// is set to serial.
+class TileChain
+{
+   public:
+    static constexpr size_t DefaultTileBytes = 256 * 1024;
+
+    explicit TileChain(size_t tileBytes = DefaultTileBytes,
+                       ThreadPool* pool = nullptr);
+
+    void addStage(Node node, size_t haloRows = 0);
+
+    // Target size of one scratch band, halo rows excluded.
+    void setTileBytes(size_t tileBytes);
+
+    // Runs the bands one after another on the calling thread, for stages
+    // that are not safe to run concurrently. Off by default.
+    void setSerial(bool serial) noexcept { Serial = serial; }
+
+    // Runs every Init once on a band-sized image of the frame.
+    EXECError executeInit(Image& image);
+
+    EXECError executeRun(Image& image);
+
+    size_t size() const noexcept { return Stages.size(); }
+    size_t haloRows() const noexcept;
+    size_t bandRows(const Image& image) const;
+
+   private:
+    struct Stage
+    {
+        Node Op;
+        size_t Halo;
+    };
+
+    std::vector<Stage> Stages;
+    size_t TileBytes;
+    ThreadPool* Pool;
+    bool Serial = false;
+
+    void loadBand(const Image& image, size_t first, size_t last,
+                  Image& tile) const;
+};
+}  // namespace ips
+
+#endif  // IPS_TILE_CHAIN_HPP
@@ -0,0 +1,50 @@
+#ifndef IPS_TRANSFORM_GEOMETRY_HPP
+#define IPS_TRANSFORM_GEOMETRY_HPP
+
+#include <string>
+
+#include "image.hpp"
+#include "node.hpp"
+#include "parallel.hpp"
+
+namespace ips::transform
+{
+// Clockwise.
+enum class Rotation
+{
+    Rotate90,
+    Rotate180,
+    Rotate270
+};
+
+enum class FlipAxis
+{
+    // Mirror left to right.
+    Horizontal,
+    // Mirror top to bottom.
+    Vertical
+};
+
+// dst(x, y) = src(y, x). Works in cache-sized tiles spread over threads;
+// inside a tile, 1-byte and 4-byte pixels are transposed in registers in
+// 16 x 16 and 4 x 4 blocks. dst may be src; it is reallocated as needed.
+void transpose(const Image& src, Image& dst,
+               const ParallelOptions& options = {});
+
+// 90 and 270 run as a transpose reading or writing rows in reverse order;
+// 180 reverses every row. dst may be src.
+void rotate(const Image& src, Image& dst, Rotation rotation,
+            const ParallelOptions& options = {});
+
+// dst may be src.
+void flip(const Image& src, Image& dst, FlipAxis axis,
+          const ParallelOptions& options = {});
+
+Node transposeNode(std::string name = "transpose");
+
+Node rotateNode(Rotation rotation, std::string name = "rotate");
+
+Node flipNode(FlipAxis axis, std::string name = "flip");
+}  // namespace ips::transform
+
+#endif  // IPS_TRANSFORM_GEOMETRY_HPP
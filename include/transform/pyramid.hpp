@@ -0,0 +1,115 @@
+#ifndef IPS_TRANSFORM_PYRAMID_HPP
+#define IPS_TRANSFORM_PYRAMID_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "filter/border.hpp"
+#include "image.hpp"
+#include "node.hpp"
+#include "parallel.hpp"
+#include "typed_image.hpp"
+
+namespace ips::transform
+{
+enum class PyramidKernel
+{
+    // [1 4 6 4 1] / 16 along both axes before dropping odd rows and columns.
+    Gaussian,
+    // Mean of each 2 x 2 block.
+    Box
+};
+
+struct PyramidOptions
+{
+    PyramidKernel Kernel = PyramidKernel::Gaussian;
+
+    // Levels including the full-size base. 0 keeps halving until both sides
+    // are 1; larger counts are capped there too.
+    size_t Levels = 0;
+
+    // Rows and columns outside a level, for the Gaussian kernel. Wrap would
+    // need the last rows before the first output row and is rejected.
+    filter::BorderMode Border = filter::BorderMode::Reflect101;
+    float BorderValue = 0.0f;
+
+    ParallelOptions Parallel;
+};
+
+// Levels of an image, each (w + 1) / 2 x (h + 1) / 2 of the one before,
+// in one contiguous allocation. Level 0 is a copy of the source. The
+// allocation is kept when a pyramid of the same shape is rebuilt.
+class Pyramid
+{
+   public:
+    size_t levels() const noexcept { return Levels.size(); }
+    bool empty() const noexcept { return Levels.empty(); }
+
+    Image::IMAGE_TYPE type() const noexcept { return Type; }
+    size_t channels() const noexcept { return Channels; }
+
+    size_t width(size_t level) const { return at(level).Width; }
+    size_t height(size_t level) const { return at(level).Height; }
+
+    // View of a level's pixels, valid until the pyramid is rebuilt with a
+    // different shape or destroyed. T and C must match type().
+    template <typename T, size_t C>
+    TypedImage<const T, C> view(size_t level) const
+    {
+        if (detail::imageTypeOf<T, C>() != Type)
+        {
+            throw std::invalid_argument("Pyramid::view: type mismatch");
+        }
+        const LevelInfo& info = at(level);
+        return TypedImage<const T, C>(
+            reinterpret_cast<const T*>(Arena.data() + info.Offset), info.Width,
+            info.Height);
+    }
+
+    // Copy of a level as an image.
+    Image image(size_t level) const;
+
+   private:
+    struct LevelInfo
+    {
+        size_t Width = 0, Height = 0;
+        // Bytes from the start of the arena.
+        size_t Offset = 0;
+    };
+
+    const LevelInfo& at(size_t level) const
+    {
+        if (level >= Levels.size())
+        {
+            throw std::out_of_range("Pyramid: no such level");
+        }
+        return Levels[level];
+    }
+
+    std::vector<LevelInfo> Levels;
+    Image::IMAGE_TYPE Type = Image::IMAGE_TYPE::IMAGE_U8C1;
+    size_t Channels = 0;
+    std::vector<uint8_t> Arena;
+
+    friend void buildPyramid(const Image&, Pyramid&, const PyramidOptions&);
+};
+
+// Builds every level in one pass over the source rows. Each level keeps a
+// few horizontally reduced rows of the level above and writes a row as
+// soon as the rows under its kernel have arrived, then feeds it on to the
+// next level. Threads take row bands; a band also computes the few rows of
+// overlap its deeper levels need, and when that overlap would grow too
+// large the remaining small levels are built in a second pass from the
+// last level of the first.
+void buildPyramid(const Image& src, Pyramid& pyramid,
+                  const PyramidOptions& options = {});
+
+// Replaces the image with pyramid level `level`, a 2^level reduction.
+Node pyramidLevelNode(size_t level, PyramidOptions options = {},
+                      std::string name = "pyramidLevel");
+}  // namespace ips::transform
+
+#endif  // IPS_TRANSFORM_PYRAMID_HPP
@@ -0,0 +1,70 @@
+#ifndef IPS_TRANSFORM_RESIZE_HPP
+#define IPS_TRANSFORM_RESIZE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "image.hpp"
+#include "node.hpp"
+#include "parallel.hpp"
+
+namespace ips::transform
+{
+enum class Interpolation
+{
+    Nearest,
+    Bilinear,
+    Bicubic,
+    Lanczos,
+    // Box filter averaging the source area under each output pixel.
+    Area
+};
+
+// Filter taps along one axis: output i reads Taps source samples starting
+// at Start[i] with weights Weights[i * Taps ...]. Windows are clamped
+// inside the source, with edge weights folded onto the border sample.
+struct AxisPlan
+{
+    size_t Taps = 0;
+    std::vector<int32_t> Start;
+    std::vector<float> Weights;
+    // The same weights in 2.14 fixed point, summing to exactly 1 << 14.
+    std::vector<int16_t> Fixed;
+};
+
+// Everything that depends only on the geometry and filter, computed once
+// and reused for every image of that geometry. When downscaling, kernels
+// are stretched by the scale factor so the result is antialiased.
+struct ResizePlan
+{
+    size_t SrcWidth = 0, SrcHeight = 0;
+    size_t DstWidth = 0, DstHeight = 0;
+    Interpolation Method = Interpolation::Bilinear;
+    AxisPlan X, Y;
+    // Integer shrink factors when Method is Area and both ratios are whole;
+    // those sizes take a direct block-averaging path.
+    size_t BoxX = 0, BoxY = 0;
+
+    static ResizePlan create(size_t srcWidth, size_t srcHeight,
+                             size_t dstWidth, size_t dstHeight,
+                             Interpolation method);
+};
+
+// dst is reallocated to the plan's output size with src's type.
+void resize(const Image& src, Image& dst, const ResizePlan& plan,
+            const ParallelOptions& options = {});
+
+// Reuses the plan of earlier calls with the same geometry and method.
+void resize(const Image& src, Image& dst, size_t width, size_t height,
+            Interpolation method = Interpolation::Bilinear,
+            const ParallelOptions& options = {});
+
+// Plans once per input shape through a PlanCache.
+Node resizeNode(size_t width, size_t height,
+                Interpolation method = Interpolation::Bilinear,
+                std::string name = "resize");
+}  // namespace ips::transform
+
+#endif  // IPS_TRANSFORM_RESIZE_HPP
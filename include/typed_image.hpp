@@ -0,0 +1,218 @@
+#ifndef IPS_TYPED_IMAGE_HPP
+#define IPS_TYPED_IMAGE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+
+#include "image.hpp"
+
+// Define IPS_CHECKED_ACCESS to keep the TypedImage bounds checks in release
+// builds. Without NDEBUG they are always on.
+#if !defined(NDEBUG) && !defined(IPS_CHECKED_ACCESS)
+#define IPS_CHECKED_ACCESS
+#endif
+
+namespace ips
+{
+namespace detail
+{
+template <typename T, size_t C>
+constexpr Image::IMAGE_TYPE imageTypeOf()
+{
+    using U = std::remove_const_t<T>;
+
+    static_assert(std::is_same_v<U, uint8_t> || std::is_same_v<U, float>,
+                  "Unsupported pixel element type");
+
+    if constexpr (std::is_same_v<U, uint8_t>)
+    {
+        static_assert(C == 1 || C == 3 || C == 4,
+                      "U8 images have 1, 3 or 4 channels");
+        if constexpr (C == 1) return Image::IMAGE_TYPE::IMAGE_U8C1;
+        if constexpr (C == 3) return Image::IMAGE_TYPE::IMAGE_U8C3;
+        if constexpr (C == 4) return Image::IMAGE_TYPE::IMAGE_U8C4;
+    }
+    else
+    {
+        static_assert(C == 1 || C == 3, "F32 images have 1 or 3 channels");
+        if constexpr (C == 1) return Image::IMAGE_TYPE::IMAGE_F32C1;
+        if constexpr (C == 3) return Image::IMAGE_TYPE::IMAGE_F32C3;
+    }
+}
+}  // namespace detail
+
+// Statically typed view over pixel data. The element type and channel count
+// are checked once at construction; element access afterwards is unchecked
+// unless IPS_CHECKED_ACCESS is defined. Rows are `stride()` elements apart,
+// which equals width() * C for views created from an Image.
+template <typename T, size_t C>
+class TypedImage
+{
+   public:
+    using value_type = std::remove_const_t<T>;
+    using element_type = T;
+    using size_type = std::size_t;
+    using reference = T&;
+    using pointer = T*;
+    using iterator = T*;
+
+    static constexpr size_type Channels = C;
+
+    TypedImage() noexcept = default;
+
+    TypedImage(T* data, size_type w, size_type h) noexcept
+        : m_data(data), m_width(w), m_height(h), m_stride(w * C)
+    {
+    }
+
+    TypedImage(T* data, size_type w, size_type h, size_type stride) noexcept
+        : m_data(data), m_width(w), m_height(h), m_stride(stride)
+    {
+    }
+
+    template <typename I,
+              typename = std::enable_if_t<std::is_same_v<I, Image> ||
+                                          (std::is_const_v<T> &&
+                                           std::is_same_v<I, const Image>)>>
+    explicit TypedImage(I& image)
+    {
+        if (!matches(image))
+        {
+            throw std::runtime_error("TypedImage: image type mismatch");
+        }
+
+        m_width = image.width();
+        m_height = image.height();
+        m_stride = m_width * C;
+
+        if constexpr (std::is_same_v<value_type, uint8_t>)
+            m_data = image.dataAsUint8();
+        else
+            m_data = image.dataAsFloat();
+    }
+
+    static bool matches(const Image& image) noexcept
+    {
+        return image.type() == detail::imageTypeOf<T, C>() &&
+               (image.channels() == C || image.size() == 0);
+    }
+
+    // Const view over the same pixels.
+    operator TypedImage<const T, C>() const noexcept
+    {
+        return TypedImage<const T, C>(m_data, m_width, m_height, m_stride);
+    }
+
+    size_type width() const noexcept { return m_width; }
+    size_type height() const noexcept { return m_height; }
+    size_type channels() const noexcept { return C; }
+    size_type stride() const noexcept { return m_stride; }
+    size_type size() const noexcept { return m_width * m_height * C; }
+    bool empty() const noexcept { return m_data == nullptr || size() == 0; }
+    bool contiguous() const noexcept { return m_stride == m_width * C; }
+
+    reference operator()(size_type x, size_type y, size_type c = 0) const
+    {
+#ifdef IPS_CHECKED_ACCESS
+        bounds(x, y, c);
+#endif
+        return m_data[y * m_stride + x * C + c];
+    }
+
+    reference at(size_type x, size_type y, size_type c = 0) const
+    {
+        bounds(x, y, c);
+        return m_data[y * m_stride + x * C + c];
+    }
+
+    pointer data() const noexcept { return m_data; }
+
+    pointer row(size_type y) const
+    {
+#ifdef IPS_CHECKED_ACCESS
+        if (y >= m_height)
+        {
+            throw std::out_of_range("Y coordinate out of bounds");
+        }
+#endif
+        return m_data + y * m_stride;
+    }
+
+    pointer pixel(size_type x, size_type y) const { return &(*this)(x, y); }
+
+    // Sub-rectangle sharing this view's storage.
+    TypedImage region(size_type x, size_type y, size_type w, size_type h) const
+    {
+        if (x + w > m_width || y + h > m_height)
+        {
+            throw std::out_of_range("TypedImage::region: out of bounds");
+        }
+        return TypedImage(m_data + y * m_stride + x * C, w, h, m_stride);
+    }
+
+    // Iteration over all elements requires a contiguous view.
+    iterator begin() const
+    {
+#ifdef IPS_CHECKED_ACCESS
+        requireContiguous();
+#endif
+        return m_data;
+    }
+
+    iterator end() const
+    {
+#ifdef IPS_CHECKED_ACCESS
+        requireContiguous();
+#endif
+        return m_data + size();
+    }
+
+   private:
+    T* m_data = nullptr;
+    size_type m_width = 0, m_height = 0, m_stride = 0;
+
+    void bounds(size_type x, size_type y, size_type c) const
+    {
+        if (empty())
+        {
+            throw std::runtime_error("Cannot access empty image");
+        }
+        if (x >= m_width)
+        {
+            throw std::out_of_range("X coordinate out of bounds");
+        }
+        if (y >= m_height)
+        {
+            throw std::out_of_range("Y coordinate out of bounds");
+        }
+        if (c >= C)
+        {
+            throw std::out_of_range("Channel index out of bounds");
+        }
+    }
+
+    void requireContiguous() const
+    {
+        if (!contiguous())
+        {
+            throw std::logic_error("TypedImage: view is not contiguous");
+        }
+    }
+};
+
+template <typename T, size_t C>
+TypedImage<T, C> typed(Image& image)
+{
+    return TypedImage<T, C>(image);
+}
+
+template <typename T, size_t C>
+TypedImage<const T, C> typed(const Image& image)
+{
+    return TypedImage<const T, C>(image);
+}
+}  // namespace ips
+
+#endif  // IPS_TYPED_IMAGE_HPP
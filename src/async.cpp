@@ -0,0 +1,293 @@
+#include "async.hpp"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+#include "profiler.hpp"
+
+namespace ips
+{
+
+AsyncNode::AsyncNode(std::function<EXECError(Image&)> init,
+                     std::function<Task<EXECError>(Image&)> run,
+                     std::string name)
+    : Init(std::move(init)), Run(std::move(run)), Name(std::move(name))
+{
+}
+
+EXECError AsyncNode::executeInit(Image& image)
+{
+    if (!Init) return EXECError::EXEC_SUCCESS;
+
+    IPS_PROFILE_SCOPE(Name, "init", &image);
+    return Init(image);
+}
+
+Task<EXECError> AsyncNode::executeRun(Image& image)
+{
+    if (!Run) co_return EXECError::EXEC_FAIL;
+    co_return co_await Run(image);
+}
+
+struct AsyncExecutor::BatchState
+{
+    std::atomic<size_t> Remaining{0};
+    std::atomic<bool> Failed{false};
+    std::promise<void> Done;
+};
+
+AsyncExecutor::AsyncExecutor(size_t ioThreads, ThreadPool* compute)
+    : Compute(compute ? compute : &ThreadPool::global())
+{
+    EpollFd = epoll_create1(EPOLL_CLOEXEC);
+    WakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (EpollFd < 0 || WakeFd < 0)
+    {
+        if (EpollFd >= 0) close(EpollFd);
+        if (WakeFd >= 0) close(WakeFd);
+        throw std::runtime_error("AsyncExecutor: cannot create event loop");
+    }
+
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.ptr = nullptr;
+    epoll_ctl(EpollFd, EPOLL_CTL_ADD, WakeFd, &event);
+
+    Loop = std::thread([this] { loop(); });
+
+    if (ioThreads == 0) ioThreads = 1;
+    IoThreads.reserve(ioThreads);
+    for (size_t i = 0; i < ioThreads; ++i)
+    {
+        IoThreads.emplace_back([this] { ioLoop(); });
+    }
+}
+
+AsyncExecutor::~AsyncExecutor()
+{
+    {
+        std::lock_guard<std::mutex> lock(IoMutex);
+        Stopping.store(true, std::memory_order_release);
+    }
+    IoReady.notify_all();
+
+    const uint64_t one = 1;
+    [[maybe_unused]] auto written = write(WakeFd, &one, sizeof(one));
+
+    Loop.join();
+    for (auto& thread : IoThreads) thread.join();
+
+    close(WakeFd);
+    close(EpollFd);
+}
+
+void AsyncExecutor::post(std::coroutine_handle<> handle)
+{
+    bool wake;
+    {
+        std::lock_guard<std::mutex> lock(PostMutex);
+        wake = Posted.empty();
+        Posted.push_back(handle);
+    }
+
+    // The loop drains everything posted before it reads the eventfd again,
+    // so only the first post after a drain needs to wake it.
+    if (wake)
+    {
+        const uint64_t one = 1;
+        [[maybe_unused]] auto written = write(WakeFd, &one, sizeof(one));
+    }
+}
+
+void AsyncExecutor::submitIo(std::function<void()> task)
+{
+    Waiting.fetch_add(1, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(IoMutex);
+        IoTasks.push_back(std::move(task));
+    }
+    IoReady.notify_one();
+}
+
+bool AsyncExecutor::watch(FdAwaiter& awaiter)
+{
+    epoll_event event{};
+    event.events = (awaiter.Read ? EPOLLIN : EPOLLOUT) | EPOLLONESHOT;
+    event.data.ptr = &awaiter;
+
+    Waiting.fetch_add(1, std::memory_order_relaxed);
+    if (epoll_ctl(EpollFd, EPOLL_CTL_ADD, awaiter.Fd, &event) != 0)
+    {
+        Waiting.fetch_sub(1, std::memory_order_relaxed);
+        awaiter.Ok = false;
+        // Not suspended; the coroutine continues right away.
+        return false;
+    }
+    return true;
+}
+
+void AsyncExecutor::loop()
+{
+    constexpr int MaxEvents = 64;
+    epoll_event events[MaxEvents];
+    std::vector<std::coroutine_handle<>> ready;
+
+    while (true)
+    {
+        const int count = epoll_wait(EpollFd, events, MaxEvents, -1);
+        if (count < 0)
+        {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        for (int i = 0; i < count; ++i)
+        {
+            if (!events[i].data.ptr)
+            {
+                uint64_t value;
+                [[maybe_unused]] auto got = read(WakeFd, &value, sizeof(value));
+                continue;
+            }
+
+            auto* awaiter = static_cast<FdAwaiter*>(events[i].data.ptr);
+            const uint32_t wanted = awaiter->Read ? EPOLLIN : EPOLLOUT;
+
+            epoll_ctl(EpollFd, EPOLL_CTL_DEL, awaiter->Fd, nullptr);
+            awaiter->Events = events[i].events;
+            awaiter->Ok = (events[i].events & wanted) &&
+                          !(events[i].events & (EPOLLERR | EPOLLHUP));
+            Waiting.fetch_sub(1, std::memory_order_relaxed);
+            ready.push_back(awaiter->Handle);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(PostMutex);
+            ready.insert(ready.end(), Posted.begin(), Posted.end());
+            Posted.clear();
+        }
+
+        for (auto handle : ready) handle.resume();
+        ready.clear();
+
+        if (Stopping.load(std::memory_order_acquire))
+        {
+            std::lock_guard<std::mutex> lock(PostMutex);
+            if (Posted.empty()) break;
+        }
+    }
+}
+
+void AsyncExecutor::ioLoop()
+{
+    while (true)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(IoMutex);
+            IoReady.wait(lock,
+                         [this]
+                         {
+                             return !IoTasks.empty() ||
+                                    Stopping.load(std::memory_order_relaxed);
+                         });
+            if (IoTasks.empty()) return;
+
+            task = std::move(IoTasks.front());
+            IoTasks.pop_front();
+        }
+
+        // A blocking call stays in flight while it runs, not just while it
+        // is queued.
+        task();
+        Waiting.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+Task<std::optional<std::vector<uint8_t>>> AsyncExecutor::readFile(
+    std::string path)
+{
+    co_return co_await blocking(
+        [&path]() -> std::optional<std::vector<uint8_t>>
+        {
+            std::ifstream file(path, std::ios::binary);
+            if (!file.is_open()) return std::nullopt;
+
+            std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)),
+                                      std::istreambuf_iterator<char>());
+            if (file.bad()) return std::nullopt;
+            return data;
+        });
+}
+
+Task<bool> AsyncExecutor::writeFile(std::string path,
+                                    std::vector<uint8_t> data)
+{
+    co_return co_await blocking(
+        [&path, &data]
+        {
+            std::ofstream file(path, std::ios::binary | std::ios::trunc);
+            if (!file.is_open()) return false;
+
+            file.write(reinterpret_cast<const char*>(data.data()),
+                       static_cast<std::streamsize>(data.size()));
+            return static_cast<bool>(file);
+        });
+}
+
+Task<std::optional<Image>> AsyncExecutor::loadImage(std::string path)
+{
+    co_return co_await blocking([&path]
+                                { return Image::createFromFile(path); });
+}
+
+AsyncExecutor::Detached AsyncExecutor::runOne(AsyncNode& node, Image& image,
+                                              std::shared_ptr<BatchState> state)
+{
+    co_await schedule();
+
+    EXECError status = EXECError::EXEC_FAIL;
+    try
+    {
+        status = co_await node.executeRun(image);
+    }
+    catch (...)
+    {
+    }
+
+    if (status != EXECError::EXEC_SUCCESS)
+    {
+        state->Failed.store(true, std::memory_order_relaxed);
+    }
+    if (state->Remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        state->Done.set_value();
+    }
+}
+
+EXECError AsyncExecutor::run(AsyncNode& node, std::span<Image> images)
+{
+    if (images.empty()) return EXECError::EXEC_SUCCESS;
+
+    auto state = std::make_shared<BatchState>();
+    state->Remaining.store(images.size(), std::memory_order_relaxed);
+    auto done = state->Done.get_future();
+
+    for (Image& image : images)
+    {
+        runOne(node, image, state);
+    }
+    done.wait();
+
+    return state->Failed.load(std::memory_order_relaxed)
+               ? EXECError::EXEC_FAIL
+               : EXECError::EXEC_SUCCESS;
+}
+
+}  // namespace ips
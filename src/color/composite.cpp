@@ -0,0 +1,820 @@
+#include "color/composite.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+
+#include "profiler.hpp"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace ips::color
+{
+
+namespace
+{
+// Rows go to threads in chunks of at least this many pixels, so small
+// sprites are composited on the calling thread.
+constexpr size_t MinChunkPixels = size_t(1) << 15;
+
+// The blend formulas are written once over the value types below. mul()
+// is a product on the unit scale: a * b for floats, and a * b / 255
+// correctly rounded for 0..255 integers, as (t + (t >> 8)) >> 8 with
+// t = a * b + 128.
+inline int mul(int a, int b)
+{
+    const int t = a * b + 128;
+    return (t + (t >> 8)) >> 8;
+}
+
+inline float mul(float a, float b) { return a * b; }
+
+template <typename V>
+V twice(V a)
+{
+    return a + a;
+}
+
+template <typename V>
+V vmin(V a, V b)
+{
+    return std::min(a, b);
+}
+
+template <typename V>
+V vmax(V a, V b)
+{
+    return std::max(a, b);
+}
+
+template <typename V>
+bool atMost(V a, V b)
+{
+    return a <= b;
+}
+
+template <typename V>
+V select(bool mask, V a, V b)
+{
+    return mask ? a : b;
+}
+
+#if defined(__SSE2__)
+// Eight 16-bit lanes: two RGBA pixels.
+struct U16x8
+{
+    __m128i V;
+};
+
+inline U16x8 operator+(U16x8 a, U16x8 b) { return {_mm_add_epi16(a.V, b.V)}; }
+inline U16x8 operator-(U16x8 a, U16x8 b) { return {_mm_sub_epi16(a.V, b.V)}; }
+
+// a * b stays below 2^16 for 0..255 inputs, so the low half is exact.
+inline U16x8 mul(U16x8 a, U16x8 b)
+{
+    const __m128i t =
+        _mm_add_epi16(_mm_mullo_epi16(a.V, b.V), _mm_set1_epi16(128));
+    return {_mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8)};
+}
+
+inline U16x8 vmin(U16x8 a, U16x8 b) { return {_mm_min_epi16(a.V, b.V)}; }
+inline U16x8 vmax(U16x8 a, U16x8 b) { return {_mm_max_epi16(a.V, b.V)}; }
+
+struct Mask16
+{
+    __m128i V;
+};
+
+inline Mask16 atMost(U16x8 a, U16x8 b)
+{
+    return {_mm_xor_si128(_mm_cmpgt_epi16(a.V, b.V), _mm_set1_epi16(-1))};
+}
+
+inline U16x8 select(Mask16 mask, U16x8 a, U16x8 b)
+{
+    return {_mm_or_si128(_mm_and_si128(mask.V, a.V),
+                         _mm_andnot_si128(mask.V, b.V))};
+}
+
+struct F32x4
+{
+    __m128 V;
+};
+
+inline F32x4 operator+(F32x4 a, F32x4 b) { return {_mm_add_ps(a.V, b.V)}; }
+inline F32x4 operator-(F32x4 a, F32x4 b) { return {_mm_sub_ps(a.V, b.V)}; }
+inline F32x4 mul(F32x4 a, F32x4 b) { return {_mm_mul_ps(a.V, b.V)}; }
+inline F32x4 vmin(F32x4 a, F32x4 b) { return {_mm_min_ps(a.V, b.V)}; }
+inline F32x4 vmax(F32x4 a, F32x4 b) { return {_mm_max_ps(a.V, b.V)}; }
+
+struct MaskF
+{
+    __m128 V;
+};
+
+inline MaskF atMost(F32x4 a, F32x4 b) { return {_mm_cmple_ps(a.V, b.V)}; }
+
+inline F32x4 select(MaskF mask, F32x4 a, F32x4 b)
+{
+    return {_mm_or_ps(_mm_and_ps(mask.V, a.V), _mm_andnot_ps(mask.V, b.V))};
+}
+#endif
+
+// Premultiplied result colour of source s over destination d, with
+// alphas sa and da: s (1 - da) + d (1 - sa) + sa da B(d / da, s / sa),
+// rearranged so that no mode divides.
+template <BlendMode M, typename V>
+V blend(V s, V d, V sa, V da, V one)
+{
+    if constexpr (M == BlendMode::Normal)
+        return s + d - mul(d, sa);
+    else if constexpr (M == BlendMode::Multiply)
+        return s + d - mul(s, da) - mul(d, sa) + mul(s, d);
+    else if constexpr (M == BlendMode::Screen)
+        return s + d - mul(s, d);
+    else if constexpr (M == BlendMode::Overlay)
+    {
+        // Hard light with the layers swapped: multiply where the
+        // destination is dark, screen where it is light.
+        const V light =
+            mul(sa, da) - twice(mul(da - d, sa - s));
+        const V hard =
+            select(atMost(twice(d), da), twice(mul(s, d)), light);
+        return s + d - mul(s, da) - mul(d, sa) + hard;
+    }
+    else if constexpr (M == BlendMode::Darken)
+        return s + d - vmax(mul(s, da), mul(d, sa));
+    else if constexpr (M == BlendMode::Lighten)
+        return s + d - vmin(mul(s, da), mul(d, sa));
+    else if constexpr (M == BlendMode::Difference)
+        return s + d - twice(vmin(mul(s, da), mul(d, sa)));
+    else
+        return vmin(s + d, one);
+}
+
+template <BlendMode M, typename V>
+V blendAlpha(V sa, V da, V one)
+{
+    if constexpr (M == BlendMode::Add)
+        return vmin(sa + da, one);
+    else
+        return sa + da - mul(sa, da);
+}
+
+// Calls fn with the mode as a compile-time constant.
+template <typename Fn>
+void withMode(BlendMode mode, Fn&& fn)
+{
+    using M = BlendMode;
+    switch (mode)
+    {
+        case M::Normal:
+            return fn(std::integral_constant<M, M::Normal>{});
+        case M::Multiply:
+            return fn(std::integral_constant<M, M::Multiply>{});
+        case M::Screen:
+            return fn(std::integral_constant<M, M::Screen>{});
+        case M::Overlay:
+            return fn(std::integral_constant<M, M::Overlay>{});
+        case M::Darken:
+            return fn(std::integral_constant<M, M::Darken>{});
+        case M::Lighten:
+            return fn(std::integral_constant<M, M::Lighten>{});
+        case M::Difference:
+            return fn(std::integral_constant<M, M::Difference>{});
+        case M::Add:
+            return fn(std::integral_constant<M, M::Add>{});
+    }
+}
+
+inline int unpremultiplyValue(int c, int a)
+{
+    return a == 0 ? 0 : std::min(255, (c * 255 + a / 2) / a);
+}
+
+// U8 RGBA pixels, scalar. The SSE2 paths below give identical results.
+inline void premultiplyPixel(const uint8_t* in, uint8_t* out)
+{
+    const int a = in[3];
+    for (int c = 0; c < 3; ++c) out[c] = static_cast<uint8_t>(mul(in[c], a));
+    out[3] = static_cast<uint8_t>(a);
+}
+
+inline void unpremultiplyPixel(const uint8_t* in, uint8_t* out)
+{
+    const int a = in[3];
+    for (int c = 0; c < 3; ++c)
+    {
+        out[c] = static_cast<uint8_t>(unpremultiplyValue(in[c], a));
+    }
+    out[3] = static_cast<uint8_t>(a);
+}
+
+template <BlendMode M, bool Straight>
+void compositePixel(const uint8_t* src, uint8_t* dst, int opacity)
+{
+    int s[4], d[4];
+    for (int c = 0; c < 4; ++c)
+    {
+        s[c] = src[c];
+        d[c] = dst[c];
+    }
+    if constexpr (Straight)
+    {
+        for (int c = 0; c < 3; ++c)
+        {
+            s[c] = mul(s[c], s[3]);
+            d[c] = mul(d[c], d[3]);
+        }
+    }
+    if (opacity < 255)
+    {
+        for (int c = 0; c < 4; ++c) s[c] = mul(s[c], opacity);
+    }
+
+    const int a = blendAlpha<M>(s[3], d[3], 255);
+    for (int c = 0; c < 3; ++c)
+    {
+        int v = std::clamp(blend<M>(s[c], d[c], s[3], d[3], 255), 0, 255);
+        if constexpr (Straight) v = unpremultiplyValue(v, a);
+        dst[c] = static_cast<uint8_t>(v);
+    }
+    dst[3] = static_cast<uint8_t>(a);
+}
+
+#if defined(__SSE2__)
+// All ones in the alpha lane of each pixel.
+inline __m128i alphaLanes() { return _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0); }
+
+inline U16x8 broadcastAlpha(U16x8 v)
+{
+    return {_mm_shufflehi_epi16(_mm_shufflelo_epi16(v.V, 0xFF), 0xFF)};
+}
+
+// Colour lanes times alpha; alpha times 255, i.e. unchanged.
+inline U16x8 premultiplyLanes(U16x8 v)
+{
+    const __m128i alphaScale = _mm_and_si128(alphaLanes(), _mm_set1_epi16(255));
+    return mul(v, {_mm_or_si128(broadcastAlpha(v).V, alphaScale)});
+}
+
+// (c * 255 + a / 2) / a per colour lane of four pixels, with one
+// reciprocal per pixel. The numerator is exact in float and the quotient
+// within 1e-4 of the true one, whose fraction is a multiple of 1 / a;
+// adding 1 / 512 before truncating gives the integer division's result.
+inline void unpremultiplyLanes(U16x8& lo, U16x8& hi)
+{
+    const __m128i zero = _mm_setzero_si128(), max = _mm_set1_epi16(255);
+    const __m128i alphaLo = broadcastAlpha(lo).V;
+    const __m128i alphaHi = broadcastAlpha(hi).V;
+    if (_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi16(alphaLo, max),
+                                        _mm_cmpeq_epi16(alphaHi, max))) ==
+        0xFFFF)
+    {
+        return;
+    }
+
+    // The four alphas in 32-bit lanes.
+    const __m128i alphas = _mm_packs_epi32(_mm_srli_epi64(lo.V, 48),
+                                           _mm_srli_epi64(hi.V, 48));
+    const __m128 r = _mm_div_ps(
+        _mm_set1_ps(1.0f),
+        _mm_max_ps(_mm_cvtepi32_ps(alphas), _mm_set1_ps(1.0f)));
+    const __m128 bias = _mm_set1_ps(1.0f / 512.0f);
+
+    auto divide = [&](U16x8& v, __m128i a, __m128 first, __m128 second)
+    {
+        const __m128i n = _mm_add_epi16(
+            _mm_mullo_epi16(v.V, _mm_set1_epi16(255)), _mm_srli_epi16(a, 1));
+        const __m128i q0 = _mm_cvttps_epi32(_mm_add_ps(
+            _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(n, zero)), first),
+            bias));
+        const __m128i q1 = _mm_cvttps_epi32(_mm_add_ps(
+            _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(n, zero)), second),
+            bias));
+        __m128i q = _mm_min_epi16(_mm_packs_epi32(q0, q1), max);
+        q = _mm_andnot_si128(_mm_cmpeq_epi16(a, zero), q);
+        v = select(Mask16{alphaLanes()}, U16x8{a}, U16x8{q});
+    };
+    divide(lo, alphaLo, _mm_shuffle_ps(r, r, 0x00), _mm_shuffle_ps(r, r, 0x55));
+    divide(hi, alphaHi, _mm_shuffle_ps(r, r, 0xAA), _mm_shuffle_ps(r, r, 0xFF));
+}
+
+// Runs fn over the 16-bit lanes of four pixels at a time, as two halves.
+// The last one to three pixels go through a padded block.
+template <typename Fn>
+void forBlocks(const uint8_t* in, uint8_t* out, size_t n, Fn&& fn)
+{
+    const __m128i zero = _mm_setzero_si128();
+    auto block = [&](const uint8_t* p, uint8_t* q)
+    {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        U16x8 lo{_mm_unpacklo_epi8(v, zero)}, hi{_mm_unpackhi_epi8(v, zero)};
+        fn(lo, hi);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(q),
+                         _mm_packus_epi16(lo.V, hi.V));
+    };
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) block(in + 4 * i, out + 4 * i);
+    if (i < n)
+    {
+        uint8_t pad[16] = {};
+        std::memcpy(pad, in + 4 * i, (n - i) * 4);
+        block(pad, pad);
+        std::memcpy(out + 4 * i, pad, (n - i) * 4);
+    }
+}
+
+template <BlendMode M, bool Straight>
+inline U16x8 compositeLanes(U16x8 s, U16x8 d, U16x8 opacity, bool scaled)
+{
+    const U16x8 zero{_mm_setzero_si128()}, one{_mm_set1_epi16(255)};
+    if constexpr (Straight)
+    {
+        s = premultiplyLanes(s);
+        d = premultiplyLanes(d);
+    }
+    if (scaled) s = mul(s, opacity);
+
+    const U16x8 sa = broadcastAlpha(s), da = broadcastAlpha(d);
+    U16x8 c = vmax(vmin(blend<M>(s, d, sa, da, one), one), zero);
+    return select(Mask16{alphaLanes()}, blendAlpha<M>(sa, da, one), c);
+}
+#endif
+
+void premultiplyRow(const uint8_t* in, uint8_t* out, size_t n)
+{
+#if defined(__SSE2__)
+    forBlocks(in, out, n,
+              [](U16x8& lo, U16x8& hi)
+              {
+                  lo = premultiplyLanes(lo);
+                  hi = premultiplyLanes(hi);
+              });
+#else
+    for (size_t i = 0; i < n; ++i) premultiplyPixel(in + 4 * i, out + 4 * i);
+#endif
+}
+
+void unpremultiplyRow(const uint8_t* in, uint8_t* out, size_t n)
+{
+#if defined(__SSE2__)
+    forBlocks(in, out, n, [](U16x8& lo, U16x8& hi)
+              { unpremultiplyLanes(lo, hi); });
+#else
+    for (size_t i = 0; i < n; ++i) unpremultiplyPixel(in + 4 * i, out + 4 * i);
+#endif
+}
+
+template <BlendMode M, bool Straight>
+void compositeRow(const uint8_t* src, uint8_t* dst, size_t n, int opacity)
+{
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const U16x8 scale{_mm_set1_epi16(static_cast<int16_t>(opacity))};
+    const bool scaled = opacity < 255;
+    auto block = [&](const uint8_t* p, uint8_t* q)
+    {
+        const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(q));
+        U16x8 lo = compositeLanes<M, Straight>(
+            {_mm_unpacklo_epi8(s, zero)}, {_mm_unpacklo_epi8(d, zero)}, scale,
+            scaled);
+        U16x8 hi = compositeLanes<M, Straight>(
+            {_mm_unpackhi_epi8(s, zero)}, {_mm_unpackhi_epi8(d, zero)}, scale,
+            scaled);
+        if constexpr (Straight) unpremultiplyLanes(lo, hi);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(q),
+                         _mm_packus_epi16(lo.V, hi.V));
+    };
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) block(src + 4 * i, dst + 4 * i);
+    if (i < n)
+    {
+        uint8_t s[16] = {}, d[16] = {};
+        std::memcpy(s, src + 4 * i, (n - i) * 4);
+        std::memcpy(d, dst + 4 * i, (n - i) * 4);
+        block(s, d);
+        std::memcpy(dst + 4 * i, d, (n - i) * 4);
+    }
+#else
+    for (size_t i = 0; i < n; ++i)
+    {
+        compositePixel<M, Straight>(src + 4 * i, dst + 4 * i, opacity);
+    }
+#endif
+}
+
+// F32 layers: three colour floats per pixel and an alpha plane.
+template <BlendMode M, bool Straight>
+void compositePixel(const float* sc, float sa, float* dc, float* da,
+                    float opacity)
+{
+    sa *= opacity;
+    const float dAlpha = da ? *da : 1.0f;
+    const float a = blendAlpha<M>(sa, dAlpha, 1.0f);
+    for (int c = 0; c < 3; ++c)
+    {
+        const float s = Straight ? sc[c] * sa : sc[c] * opacity;
+        const float d = Straight ? dc[c] * dAlpha : dc[c];
+        const float v = blend<M>(s, d, sa, dAlpha, 1.0f);
+        dc[c] = Straight ? (a > 0.0f ? v / a : 0.0f) : v;
+    }
+    if (da) *da = a;
+}
+
+#if defined(__SSE2__)
+// Alphas of four pixels lined up with their twelve colour floats.
+inline void spreadAlpha(__m128 a, F32x4* out)
+{
+    out[0] = {_mm_shuffle_ps(a, a, _MM_SHUFFLE(1, 0, 0, 0))};
+    out[1] = {_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 2, 1, 1))};
+    out[2] = {_mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 3, 3, 2))};
+}
+
+// a > 0 ? v / a : 0.
+inline F32x4 divideByAlpha(F32x4 v, F32x4 a)
+{
+    const __m128 positive = _mm_cmpgt_ps(a.V, _mm_setzero_ps());
+    const __m128 q =
+        _mm_div_ps(v.V, _mm_max_ps(a.V, _mm_set1_ps(1e-30f)));
+    return {_mm_and_ps(positive, q)};
+}
+#endif
+
+template <BlendMode M, bool Straight>
+void compositeRow(const float* sc, const float* sa, float* dc, float* da,
+                  size_t n, float opacity)
+{
+    size_t i = 0;
+#if defined(__SSE2__)
+    const F32x4 one{_mm_set1_ps(1.0f)}, scale{_mm_set1_ps(opacity)};
+    for (; i + 4 <= n; i += 4)
+    {
+        const F32x4 srcAlpha = mul(F32x4{_mm_loadu_ps(sa + i)}, scale);
+        const F32x4 dstAlpha = da ? F32x4{_mm_loadu_ps(da + i)} : one;
+        const F32x4 outAlpha = blendAlpha<M>(srcAlpha, dstAlpha, one);
+        F32x4 spreadS[3], spreadD[3], spreadOut[3];
+        spreadAlpha(srcAlpha.V, spreadS);
+        spreadAlpha(dstAlpha.V, spreadD);
+        spreadAlpha(outAlpha.V, spreadOut);
+        for (size_t k = 0; k < 3; ++k)
+        {
+            F32x4 s{_mm_loadu_ps(sc + 3 * i + 4 * k)};
+            F32x4 d{_mm_loadu_ps(dc + 3 * i + 4 * k)};
+            s = mul(s, Straight ? spreadS[k] : scale);
+            if constexpr (Straight) d = mul(d, spreadD[k]);
+            F32x4 v = blend<M>(s, d, spreadS[k], spreadD[k], one);
+            if constexpr (Straight) v = divideByAlpha(v, spreadOut[k]);
+            _mm_storeu_ps(dc + 3 * i + 4 * k, v.V);
+        }
+        if (da) _mm_storeu_ps(da + i, outAlpha.V);
+    }
+#endif
+    for (; i < n; ++i)
+    {
+        compositePixel<M, Straight>(sc + 3 * i, sa[i], dc + 3 * i,
+                                    da ? da + i : nullptr, opacity);
+    }
+}
+
+void scaleRow(const float* color, const float* alpha, float* out, size_t n,
+              bool divide)
+{
+    size_t i = 0;
+#if defined(__SSE2__)
+    for (; i + 4 <= n; i += 4)
+    {
+        F32x4 a[3];
+        spreadAlpha(_mm_loadu_ps(alpha + i), a);
+        for (size_t k = 0; k < 3; ++k)
+        {
+            const F32x4 c{_mm_loadu_ps(color + 3 * i + 4 * k)};
+            const F32x4 v = divide ? divideByAlpha(c, a[k]) : mul(c, a[k]);
+            _mm_storeu_ps(out + 3 * i + 4 * k, v.V);
+        }
+    }
+#endif
+    for (; i < n; ++i)
+    {
+        const float a = alpha[i];
+        for (size_t c = 0; c < 3; ++c)
+        {
+            const float v = color[3 * i + c];
+            out[3 * i + c] = divide ? (a > 0.0f ? v / a : 0.0f) : v * a;
+        }
+    }
+}
+
+// Rows of a w-pixel wide region, in chunks big enough to be worth a
+// thread.
+template <typename Fn>
+void forRegionRows(size_t w, size_t h, const ParallelOptions& options,
+                   Fn&& fn)
+{
+    ParallelOptions rows = options;
+    if (rows.Grain == 0)
+    {
+        rows.Grain = std::max(
+            ips::detail::grainFor(h, 0, ips::detail::poolOf(options)),
+            (MinChunkPixels + w - 1) / w);
+    }
+    parallel_for(0, h, std::forward<Fn>(fn), rows);
+}
+
+void checkRgba(const Image& image, const char* what)
+{
+    if (image.empty() || image.type() != Image::IMAGE_TYPE::IMAGE_U8C4)
+    {
+        throw std::invalid_argument(std::string(what) +
+                                    ": expected a U8C4 image");
+    }
+}
+
+void checkLayer(const Image& color, const Image& alpha, const char* what)
+{
+    if (color.empty() || color.type() != Image::IMAGE_TYPE::IMAGE_F32C3 ||
+        alpha.type() != Image::IMAGE_TYPE::IMAGE_F32C1 ||
+        alpha.width() != color.width() || alpha.height() != color.height())
+    {
+        throw std::invalid_argument(
+            std::string(what) +
+            ": expected F32C3 colour and a same-size F32C1 alpha");
+    }
+}
+
+void reshapeLike(const Image& src, Image& dst)
+{
+    if (&src != &dst &&
+        (dst.width() != src.width() || dst.height() != src.height() ||
+         dst.type() != src.type() || dst.channels() != src.channels()))
+    {
+        dst = Image(src.width(), src.height(), src.channels(), src.type());
+    }
+}
+
+// The part of a w x h source placed at (x, y) that lies on a W x H
+// destination, as a source offset, destination offset and size.
+struct Overlap
+{
+    size_t SrcX = 0, SrcY = 0, DstX = 0, DstY = 0, Width = 0, Height = 0;
+};
+
+Overlap overlap(size_t w, size_t h, size_t W, size_t H, std::ptrdiff_t x,
+                std::ptrdiff_t y)
+{
+    auto axis = [](size_t n, size_t N, std::ptrdiff_t at, size_t& from,
+                   size_t& to, size_t& count)
+    {
+        const std::ptrdiff_t first = std::max<std::ptrdiff_t>(at, 0);
+        const std::ptrdiff_t last = std::min<std::ptrdiff_t>(
+            at + std::ptrdiff_t(n), std::ptrdiff_t(N));
+        if (last <= first) return;
+        from = size_t(first - at);
+        to = size_t(first);
+        count = size_t(last - first);
+    };
+    Overlap o;
+    axis(w, W, x, o.SrcX, o.DstX, o.Width);
+    axis(h, H, y, o.SrcY, o.DstY, o.Height);
+    if (o.Width == 0 || o.Height == 0) return {};
+    return o;
+}
+
+int opacityU8(float opacity)
+{
+    return static_cast<int>(
+        std::lround(std::clamp(opacity, 0.0f, 1.0f) * 255.0f));
+}
+}  // namespace
+
+void premultiply(const Image& src, Image& dst, const ParallelOptions& options)
+{
+    checkRgba(src, "premultiply");
+    IPS_PROFILE_SCOPE("premultiply", "color", src);
+
+    reshapeLike(src, dst);
+    const uint8_t* in = src.dataAsUint8();
+    uint8_t* out = dst.dataAsUint8();
+    const size_t w = src.width();
+    parallel_for_rows(
+        src,
+        [&](size_t first, size_t last)
+        {
+            premultiplyRow(in + first * w * 4, out + first * w * 4,
+                           (last - first) * w);
+        },
+        options);
+}
+
+void unpremultiply(const Image& src, Image& dst, const ParallelOptions& options)
+{
+    checkRgba(src, "unpremultiply");
+    IPS_PROFILE_SCOPE("unpremultiply", "color", src);
+
+    reshapeLike(src, dst);
+    const uint8_t* in = src.dataAsUint8();
+    uint8_t* out = dst.dataAsUint8();
+    const size_t w = src.width();
+    parallel_for_rows(
+        src,
+        [&](size_t first, size_t last)
+        {
+            unpremultiplyRow(in + first * w * 4, out + first * w * 4,
+                             (last - first) * w);
+        },
+        options);
+}
+
+void premultiply(const Image& color, const Image& alpha, Image& dst,
+                 const ParallelOptions& options)
+{
+    checkLayer(color, alpha, "premultiply");
+    IPS_PROFILE_SCOPE("premultiply", "color", color);
+
+    reshapeLike(color, dst);
+    const float* c = color.dataAsFloat();
+    const float* a = alpha.dataAsFloat();
+    float* out = dst.dataAsFloat();
+    const size_t w = color.width();
+    parallel_for_rows(
+        color,
+        [&](size_t first, size_t last)
+        {
+            scaleRow(c + first * w * 3, a + first * w, out + first * w * 3,
+                     (last - first) * w, false);
+        },
+        options);
+}
+
+void unpremultiply(const Image& color, const Image& alpha, Image& dst,
+                   const ParallelOptions& options)
+{
+    checkLayer(color, alpha, "unpremultiply");
+    IPS_PROFILE_SCOPE("unpremultiply", "color", color);
+
+    reshapeLike(color, dst);
+    const float* c = color.dataAsFloat();
+    const float* a = alpha.dataAsFloat();
+    float* out = dst.dataAsFloat();
+    const size_t w = color.width();
+    parallel_for_rows(
+        color,
+        [&](size_t first, size_t last)
+        {
+            scaleRow(c + first * w * 3, a + first * w, out + first * w * 3,
+                     (last - first) * w, true);
+        },
+        options);
+}
+
+void composite(TypedImage<const uint8_t, 4> src, TypedImage<uint8_t, 4> dst,
+               const CompositeOptions& options)
+{
+    if (src.width() != dst.width() || src.height() != dst.height())
+    {
+        throw std::invalid_argument("composite: size mismatch");
+    }
+    if (src.empty()) return;
+    IPS_PROFILE_SCOPE("composite", "color", nullptr);
+
+    const int opacity = opacityU8(options.Opacity);
+    withMode(
+        options.Mode,
+        [&](auto mode)
+        {
+            constexpr BlendMode M = decltype(mode)::value;
+            auto run = [&](auto straight)
+            {
+                constexpr bool Straight = decltype(straight)::value;
+                forRegionRows(
+                    src.width(), src.height(), options.Parallel,
+                    [&](size_t first, size_t last)
+                    {
+                        for (size_t y = first; y < last; ++y)
+                        {
+                            compositeRow<M, Straight>(
+                                src.row(y), dst.row(y), src.width(), opacity);
+                        }
+                    });
+            };
+            if (options.Premultiplied)
+                run(std::false_type{});
+            else
+                run(std::true_type{});
+        });
+}
+
+void composite(TypedImage<const float, 3> srcColor,
+               TypedImage<const float, 1> srcAlpha,
+               TypedImage<float, 3> dstColor, TypedImage<float, 1> dstAlpha,
+               const CompositeOptions& options)
+{
+    const size_t w = srcColor.width(), h = srcColor.height();
+    if (srcAlpha.width() != w || srcAlpha.height() != h ||
+        dstColor.width() != w || dstColor.height() != h ||
+        (!dstAlpha.empty() &&
+         (dstAlpha.width() != w || dstAlpha.height() != h)))
+    {
+        throw std::invalid_argument("composite: size mismatch");
+    }
+    if (srcColor.empty()) return;
+    IPS_PROFILE_SCOPE("composite", "color", nullptr);
+
+    const float opacity = std::clamp(options.Opacity, 0.0f, 1.0f);
+    const bool hasAlpha = !dstAlpha.empty();
+    withMode(
+        options.Mode,
+        [&](auto mode)
+        {
+            constexpr BlendMode M = decltype(mode)::value;
+            auto run = [&](auto straight)
+            {
+                constexpr bool Straight = decltype(straight)::value;
+                forRegionRows(
+                    w, h, options.Parallel,
+                    [&](size_t first, size_t last)
+                    {
+                        for (size_t y = first; y < last; ++y)
+                        {
+                            compositeRow<M, Straight>(
+                                srcColor.row(y), srcAlpha.row(y),
+                                dstColor.row(y),
+                                hasAlpha ? dstAlpha.row(y) : nullptr, w,
+                                opacity);
+                        }
+                    });
+            };
+            if (options.Premultiplied)
+                run(std::false_type{});
+            else
+                run(std::true_type{});
+        });
+}
+
+void composite(const Image& src, Image& dst, std::ptrdiff_t x,
+               std::ptrdiff_t y, const CompositeOptions& options)
+{
+    checkRgba(src, "composite");
+    checkRgba(dst, "composite");
+
+    const Overlap o =
+        overlap(src.width(), src.height(), dst.width(), dst.height(), x, y);
+    if (o.Width == 0) return;
+    composite(TypedImage<const uint8_t, 4>(src).region(o.SrcX, o.SrcY,
+                                                       o.Width, o.Height),
+              TypedImage<uint8_t, 4>(dst).region(o.DstX, o.DstY, o.Width,
+                                                 o.Height),
+              options);
+}
+
+void composite(const Image& srcColor, const Image& srcAlpha, Image& dstColor,
+               Image* dstAlpha, std::ptrdiff_t x, std::ptrdiff_t y,
+               const CompositeOptions& options)
+{
+    checkLayer(srcColor, srcAlpha, "composite");
+    if (dstColor.empty() ||
+        dstColor.type() != Image::IMAGE_TYPE::IMAGE_F32C3)
+    {
+        throw std::invalid_argument("composite: expected an F32C3 canvas");
+    }
+    if (dstAlpha) checkLayer(dstColor, *dstAlpha, "composite");
+
+    const Overlap o = overlap(srcColor.width(), srcColor.height(),
+                              dstColor.width(), dstColor.height(), x, y);
+    if (o.Width == 0) return;
+    TypedImage<float, 1> alphaRegion;
+    if (dstAlpha)
+    {
+        alphaRegion = TypedImage<float, 1>(*dstAlpha).region(
+            o.DstX, o.DstY, o.Width, o.Height);
+    }
+    composite(TypedImage<const float, 3>(srcColor).region(o.SrcX, o.SrcY,
+                                                          o.Width, o.Height),
+              TypedImage<const float, 1>(srcAlpha).region(o.SrcX, o.SrcY,
+                                                          o.Width, o.Height),
+              TypedImage<float, 3>(dstColor).region(o.DstX, o.DstY, o.Width,
+                                                    o.Height),
+              alphaRegion, options);
+}
+
+Node compositeNode(Image overlay, std::ptrdiff_t x, std::ptrdiff_t y,
+                   CompositeOptions options, std::string name)
+{
+    checkRgba(overlay, "compositeNode");
+    auto run = [overlay = std::move(overlay), x, y, options](Image& image)
+    {
+        if (image.empty() || image.type() != Image::IMAGE_TYPE::IMAGE_U8C4)
+        {
+            return EXECError::EXEC_FAIL;
+        }
+        composite(overlay, image, x, y, options);
+        return EXECError::EXEC_SUCCESS;
+    };
+    return Node(nullptr, std::move(run), std::move(name));
+}
+}  // namespace ips::color
@@ -0,0 +1,1061 @@
+#include "color/convert.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "profiler.hpp"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace ips::color
+{
+
+namespace
+{
+constexpr int ForwardBits = 14;
+// Inverse weights reach ~2 for limited range and need a bit of headroom.
+constexpr int InverseBits = 13;
+
+Image::IMAGE_TYPE typeFor(bool floating, size_t channels)
+{
+    if (floating)
+        return channels == 1 ? Image::IMAGE_TYPE::IMAGE_F32C1
+                             : Image::IMAGE_TYPE::IMAGE_F32C3;
+    return channels == 1 ? Image::IMAGE_TYPE::IMAGE_U8C1
+                         : Image::IMAGE_TYPE::IMAGE_U8C3;
+}
+
+void checkChannels(const Image& src, bool allowAlpha, const char* what)
+{
+    if (src.empty())
+    {
+        throw std::invalid_argument(std::string(what) + ": empty image");
+    }
+    const size_t C = src.channels();
+    if (C != 3 && !(allowAlpha && C == 4))
+    {
+        throw std::invalid_argument(std::string(what) +
+                                    ": expected a three-channel image");
+    }
+}
+
+// Output for src -> dst with the given channel count; a fresh image when
+// they are the same, since the shapes usually differ.
+Image& target(const Image& src, Image& dst, Image& scratch, size_t channels)
+{
+    Image& out = (&src == &dst) ? scratch : dst;
+    const auto type = typeFor(Image::isFloat(src.type()), channels);
+    if (out.width() != src.width() || out.height() != src.height() ||
+        out.type() != type || out.channels() != channels)
+    {
+        out = Image(src.width(), src.height(), channels, type);
+    }
+    return out;
+}
+
+void finish(Image& dst, Image& out, Image& scratch)
+{
+    if (&out == &scratch) dst = std::move(scratch);
+}
+
+// Conversion matrix in full-scale units (1.0 == 255).
+struct Matrix
+{
+    // Rows Y, Cb, Cr; columns R, G, B.
+    double Forward[3][3];
+    // Y offset of limited range, in U8 units.
+    int YOffset;
+    // R = YScale * Y' + CrR * Cr', G = YScale * Y' + CbG * Cb' + CrG * Cr',
+    // B = YScale * Y' + CbB * Cb' with Y' and C' the offset-free values.
+    double YScale, CrR, CbG, CrG, CbB;
+};
+
+Matrix matrixFor(ColorMatrix matrix, ColorRange range)
+{
+    const double kr = matrix == ColorMatrix::BT709 ? 0.2126 : 0.299;
+    const double kb = matrix == ColorMatrix::BT709 ? 0.0722 : 0.114;
+    const double kg = 1.0 - kr - kb;
+
+    const bool limited = range == ColorRange::Limited;
+    const double ys = limited ? 219.0 / 255.0 : 1.0;
+    const double cs = limited ? 224.0 / 255.0 : 1.0;
+
+    Matrix m;
+    m.Forward[0][0] = kr * ys;
+    m.Forward[0][1] = kg * ys;
+    m.Forward[0][2] = kb * ys;
+    m.Forward[1][0] = -kr / (2.0 * (1.0 - kb)) * cs;
+    m.Forward[1][1] = -kg / (2.0 * (1.0 - kb)) * cs;
+    m.Forward[1][2] = 0.5 * cs;
+    m.Forward[2][0] = 0.5 * cs;
+    m.Forward[2][1] = -kg / (2.0 * (1.0 - kr)) * cs;
+    m.Forward[2][2] = -kb / (2.0 * (1.0 - kr)) * cs;
+    m.YOffset = limited ? 16 : 0;
+
+    m.YScale = 1.0 / ys;
+    m.CrR = 2.0 * (1.0 - kr) / cs;
+    m.CbB = 2.0 * (1.0 - kb) / cs;
+    m.CbG = -2.0 * kb * (1.0 - kb) / kg / cs;
+    m.CrG = -2.0 * kr * (1.0 - kr) / kg / cs;
+    return m;
+}
+
+struct ForwardFixed
+{
+    int16_t W[3][3];
+    // Offset << ForwardBits plus rounding.
+    int32_t Bias[3];
+};
+
+ForwardFixed forwardFixed(const Matrix& m)
+{
+    ForwardFixed f;
+    for (size_t k = 0; k < 3; ++k)
+    {
+        int sum = 0;
+        for (size_t c = 0; c < 3; ++c)
+        {
+            f.W[k][c] = static_cast<int16_t>(
+                std::lround(m.Forward[k][c] * (1 << ForwardBits)));
+            sum += f.W[k][c];
+        }
+        // Grey stays grey: luma gains exactly, chroma rows sum to zero.
+        const double gain = m.Forward[k][0] + m.Forward[k][1] + m.Forward[k][2];
+        const auto want = static_cast<int>(std::lround(gain * (1 << ForwardBits)));
+        f.W[k][1] = static_cast<int16_t>(f.W[k][1] + want - sum);
+
+        const int offset = k == 0 ? m.YOffset : 128;
+        f.Bias[k] = (offset << ForwardBits) + (1 << (ForwardBits - 1));
+    }
+    return f;
+}
+
+struct InverseFixed
+{
+    int16_t Y, CrR, CbG, CrG, CbB;
+    int16_t YOffset;
+};
+
+InverseFixed inverseFixed(const Matrix& m)
+{
+    auto q = [](double v)
+    { return static_cast<int16_t>(std::lround(v * (1 << InverseBits))); };
+    return {q(m.YScale), q(m.CrR), q(m.CbG), q(m.CrG), q(m.CbB),
+            static_cast<int16_t>(m.YOffset)};
+}
+
+inline uint8_t clampU8(int32_t v)
+{
+    return static_cast<uint8_t>(std::clamp(v, 0, 255));
+}
+
+#if defined(__SSE2__)
+// 32 pixels of C interleaved channels in 2 * C vectors to C planes of two
+// vectors each, and back. For C = 3 and C = 4, five rounds of interleaving
+// vector j with vector j + C carry one layout into the other, and packing
+// even and odd bytes undoes a round, so SSE2 needs no byte shuffle.
+template <size_t C>
+inline void deinterleave(__m128i* v)
+{
+    for (int round = 0; round < 5; ++round)
+    {
+        __m128i t[2 * C];
+        for (size_t j = 0; j < C; ++j)
+        {
+            t[2 * j] = _mm_unpacklo_epi8(v[j], v[j + C]);
+            t[2 * j + 1] = _mm_unpackhi_epi8(v[j], v[j + C]);
+        }
+        std::copy(t, t + 2 * C, v);
+    }
+}
+
+template <size_t C>
+inline void interleave(__m128i* v)
+{
+    const __m128i low = _mm_set1_epi16(0x00FF);
+    for (int round = 0; round < 5; ++round)
+    {
+        __m128i t[2 * C];
+        for (size_t j = 0; j < C; ++j)
+        {
+            t[j] = _mm_packus_epi16(_mm_and_si128(v[2 * j], low),
+                                    _mm_and_si128(v[2 * j + 1], low));
+            t[j + C] = _mm_packus_epi16(_mm_srli_epi16(v[2 * j], 8),
+                                        _mm_srli_epi16(v[2 * j + 1], 8));
+        }
+        std::copy(t, t + 2 * C, v);
+    }
+}
+
+template <size_t C>
+inline void loadPixels(const uint8_t* p, __m128i* v)
+{
+    for (size_t i = 0; i < 2 * C; ++i)
+    {
+        v[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16 * i));
+    }
+    deinterleave<C>(v);
+}
+
+inline void storePixels3(uint8_t* p, __m128i* v)
+{
+    interleave<3>(v);
+    for (size_t i = 0; i < 6; ++i)
+    {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(p + 16 * i), v[i]);
+    }
+}
+
+inline void store32(uint8_t* p, __m128i a, __m128i b)
+{
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(p), a);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(p + 16), b);
+}
+
+// Pairs of 16-bit weights (a, b) for _mm_madd_epi16.
+inline __m128i weightPair(int16_t a, int16_t b)
+{
+    return _mm_set1_epi32(static_cast<int>(
+        (uint32_t(uint16_t(b)) << 16) | uint16_t(a)));
+}
+
+// (x * wx + y * wy + bias) >> shift for eight 16-bit lanes.
+template <int Shift>
+inline __m128i dot2(__m128i x, __m128i y, __m128i w, __m128i bias)
+{
+    const __m128i lo = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(x, y), w), bias);
+    const __m128i hi = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(x, y), w), bias);
+    return _mm_packs_epi32(_mm_srai_epi32(lo, Shift), _mm_srai_epi32(hi, Shift));
+}
+
+// (x * wx + y * wy + z * wz + bias) >> shift for eight 16-bit lanes.
+template <int Shift>
+inline __m128i dot3(__m128i x, __m128i y, __m128i z, __m128i wxy, __m128i wz,
+                    __m128i bias)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi16(x, y), wxy);
+    __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi16(x, y), wxy);
+    lo = _mm_add_epi32(lo, _mm_madd_epi16(_mm_unpacklo_epi16(z, zero), wz));
+    hi = _mm_add_epi32(hi, _mm_madd_epi16(_mm_unpackhi_epi16(z, zero), wz));
+    lo = _mm_add_epi32(lo, bias);
+    hi = _mm_add_epi32(hi, bias);
+    return _mm_packs_epi32(_mm_srai_epi32(lo, Shift), _mm_srai_epi32(hi, Shift));
+}
+#endif
+
+enum class Layout
+{
+    // Y only.
+    Luma,
+    // Y, Cb, Cr interleaved at `y`.
+    Interleaved,
+    // Separate Y, Cb and Cr rows.
+    Planar
+};
+
+// RGB (C = 3) or RGBA (C = 4) pixels to Y or Y, Cb, Cr.
+template <size_t C, Layout Out>
+void forwardU8(const uint8_t* src, size_t n, const ForwardFixed& f,
+               uint8_t* y, uint8_t* cb, uint8_t* cr)
+{
+    constexpr size_t K = Out == Layout::Luma ? 1 : 3;
+    size_t x = 0;
+
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    __m128i wrg[K], wb[K], bias[K];
+    for (size_t k = 0; k < K; ++k)
+    {
+        wrg[k] = weightPair(f.W[k][0], f.W[k][1]);
+        wb[k] = weightPair(f.W[k][2], 0);
+        bias[k] = _mm_set1_epi32(f.Bias[k]);
+    }
+
+    for (; x + 32 <= n; x += 32)
+    {
+        __m128i v[2 * C];
+        loadPixels<C>(src + x * C, v);
+
+        __m128i out[6];
+        for (size_t h = 0; h < 2; ++h)
+        {
+            const __m128i r[2] = {_mm_unpacklo_epi8(v[h], zero),
+                                  _mm_unpackhi_epi8(v[h], zero)};
+            const __m128i g[2] = {_mm_unpacklo_epi8(v[2 + h], zero),
+                                  _mm_unpackhi_epi8(v[2 + h], zero)};
+            const __m128i b[2] = {_mm_unpacklo_epi8(v[4 + h], zero),
+                                  _mm_unpackhi_epi8(v[4 + h], zero)};
+            for (size_t k = 0; k < K; ++k)
+            {
+                out[2 * k + h] = _mm_packus_epi16(
+                    dot3<ForwardBits>(r[0], g[0], b[0], wrg[k], wb[k], bias[k]),
+                    dot3<ForwardBits>(r[1], g[1], b[1], wrg[k], wb[k], bias[k]));
+            }
+        }
+
+        if constexpr (Out == Layout::Interleaved)
+        {
+            storePixels3(y + 3 * x, out);
+        }
+        else
+        {
+            store32(y + x, out[0], out[1]);
+            if constexpr (Out == Layout::Planar)
+            {
+                store32(cb + x, out[2], out[3]);
+                store32(cr + x, out[4], out[5]);
+            }
+        }
+    }
+#endif
+
+    for (; x < n; ++x)
+    {
+        const uint8_t* p = src + x * C;
+        auto dot = [&](size_t k)
+        {
+            return clampU8((f.W[k][0] * p[0] + f.W[k][1] * p[1] +
+                            f.W[k][2] * p[2] + f.Bias[k]) >>
+                           ForwardBits);
+        };
+
+        if constexpr (Out == Layout::Interleaved)
+        {
+            y[3 * x] = dot(0);
+            y[3 * x + 1] = dot(1);
+            y[3 * x + 2] = dot(2);
+        }
+        else
+        {
+            y[x] = dot(0);
+            if constexpr (Out == Layout::Planar)
+            {
+                cb[x] = dot(1);
+                cr[x] = dot(2);
+            }
+        }
+    }
+}
+
+// Y, Cb, Cr to interleaved RGB. With Interleaved, `y` holds all three.
+template <bool Interleaved>
+void inverseU8(const uint8_t* y, const uint8_t* cb, const uint8_t* cr,
+               size_t n, const InverseFixed& f, uint8_t* dst)
+{
+    size_t x = 0;
+
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i yOffset = _mm_set1_epi16(f.YOffset);
+    const __m128i half = _mm_set1_epi16(128);
+    const __m128i round = _mm_set1_epi32(1 << (InverseBits - 1));
+    const __m128i wR = weightPair(f.Y, f.CrR);
+    const __m128i wG = weightPair(f.Y, f.CbG);
+    const __m128i wGr = weightPair(f.CrG, 0);
+    const __m128i wB = weightPair(f.Y, f.CbB);
+
+    for (; x + 32 <= n; x += 32)
+    {
+        __m128i v[6];
+        if constexpr (Interleaved)
+        {
+            loadPixels<3>(y + 3 * x, v);
+        }
+        else
+        {
+            const uint8_t* planes[3] = {y + x, cb + x, cr + x};
+            for (size_t i = 0; i < 6; ++i)
+            {
+                v[i] = _mm_loadu_si128(
+                    reinterpret_cast<const __m128i*>(planes[i / 2] + 16 * (i % 2)));
+            }
+        }
+
+        __m128i out[6];
+        for (size_t h = 0; h < 2; ++h)
+        {
+            __m128i rgb[3][2];
+            for (size_t q = 0; q < 2; ++q)
+            {
+                auto widen = [&](__m128i u)
+                {
+                    return q == 0 ? _mm_unpacklo_epi8(u, zero)
+                                  : _mm_unpackhi_epi8(u, zero);
+                };
+                const __m128i Y = _mm_sub_epi16(widen(v[h]), yOffset);
+                const __m128i Cb = _mm_sub_epi16(widen(v[2 + h]), half);
+                const __m128i Cr = _mm_sub_epi16(widen(v[4 + h]), half);
+
+                rgb[0][q] = dot2<InverseBits>(Y, Cr, wR, round);
+                rgb[1][q] = dot3<InverseBits>(Y, Cb, Cr, wG, wGr, round);
+                rgb[2][q] = dot2<InverseBits>(Y, Cb, wB, round);
+            }
+            for (size_t c = 0; c < 3; ++c)
+            {
+                out[2 * c + h] = _mm_packus_epi16(rgb[c][0], rgb[c][1]);
+            }
+        }
+        storePixels3(dst + 3 * x, out);
+    }
+#endif
+
+    constexpr int round1 = 1 << (InverseBits - 1);
+    for (; x < n; ++x)
+    {
+        int32_t Y, Cb, Cr;
+        if constexpr (Interleaved)
+        {
+            Y = y[3 * x];
+            Cb = y[3 * x + 1];
+            Cr = y[3 * x + 2];
+        }
+        else
+        {
+            Y = y[x];
+            Cb = cb[x];
+            Cr = cr[x];
+        }
+        Y -= f.YOffset;
+        Cb -= 128;
+        Cr -= 128;
+
+        uint8_t* p = dst + 3 * x;
+        p[0] = clampU8((f.Y * Y + f.CrR * Cr + round1) >> InverseBits);
+        p[1] = clampU8((f.Y * Y + f.CbG * Cb + f.CrG * Cr + round1) >> InverseBits);
+        p[2] = clampU8((f.Y * Y + f.CbB * Cb + round1) >> InverseBits);
+    }
+}
+
+void grayToRgbU8(const uint8_t* src, size_t n, uint8_t* dst)
+{
+    size_t x = 0;
+#if defined(__SSE2__)
+    for (; x + 32 <= n; x += 32)
+    {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+        const __m128i b =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x + 16));
+        __m128i v[6] = {a, b, a, b, a, b};
+        storePixels3(dst + 3 * x, v);
+    }
+#endif
+    for (; x < n; ++x) dst[3 * x] = dst[3 * x + 1] = dst[3 * x + 2] = src[x];
+}
+
+template <size_t C, Layout Out>
+void forwardF32(const float* src, size_t n, const Matrix& m, float* y,
+                float* cb, float* cr)
+{
+    float w[3][3];
+    for (size_t k = 0; k < 3; ++k)
+    {
+        for (size_t c = 0; c < 3; ++c) w[k][c] = float(m.Forward[k][c]);
+    }
+    const float offset[3] = {float(m.YOffset) / 255.0f, 0.5f, 0.5f};
+
+    for (size_t x = 0; x < n; ++x)
+    {
+        const float* p = src + x * C;
+        auto dot = [&](size_t k)
+        { return w[k][0] * p[0] + w[k][1] * p[1] + w[k][2] * p[2] + offset[k]; };
+
+        if constexpr (Out == Layout::Interleaved)
+        {
+            y[3 * x] = dot(0);
+            y[3 * x + 1] = dot(1);
+            y[3 * x + 2] = dot(2);
+        }
+        else
+        {
+            y[x] = dot(0);
+            if constexpr (Out == Layout::Planar)
+            {
+                cb[x] = dot(1);
+                cr[x] = dot(2);
+            }
+        }
+    }
+}
+
+template <bool Interleaved>
+void inverseF32(const float* y, const float* cb, const float* cr, size_t n,
+                const Matrix& m, float* dst)
+{
+    const float ys = float(m.YScale), yOffset = float(m.YOffset) / 255.0f;
+    const float crR = float(m.CrR), cbG = float(m.CbG), crG = float(m.CrG),
+                cbB = float(m.CbB);
+
+    for (size_t x = 0; x < n; ++x)
+    {
+        float Y, Cb, Cr;
+        if constexpr (Interleaved)
+        {
+            Y = y[3 * x];
+            Cb = y[3 * x + 1];
+            Cr = y[3 * x + 2];
+        }
+        else
+        {
+            Y = y[x];
+            Cb = cb[x];
+            Cr = cr[x];
+        }
+        Y = (Y - yOffset) * ys;
+        Cb -= 0.5f;
+        Cr -= 0.5f;
+
+        float* p = dst + 3 * x;
+        p[0] = Y + crR * Cr;
+        p[1] = Y + cbG * Cb + crG * Cr;
+        p[2] = Y + cbB * Cb;
+    }
+}
+
+// Hue in degrees, saturation in [0, 1], value in the scale of the input.
+inline void rgbToHsvPixel(float r, float g, float b, float& h, float& s,
+                          float& v)
+{
+    const float hi = std::max({r, g, b});
+    const float lo = std::min({r, g, b});
+    const float d = hi - lo;
+
+    v = hi;
+    s = hi > 0.0f ? d / hi : 0.0f;
+    if (d <= 0.0f)
+        h = 0.0f;
+    else if (hi == r)
+        h = 60.0f * (g - b) / d;
+    else if (hi == g)
+        h = 120.0f + 60.0f * (b - r) / d;
+    else
+        h = 240.0f + 60.0f * (r - g) / d;
+    if (h < 0.0f) h += 360.0f;
+}
+
+inline void hsvToRgbPixel(float h, float s, float v, float& r, float& g,
+                          float& b)
+{
+    h /= 60.0f;
+    const float sector = std::floor(h);
+    const float f = h - sector;
+    const float p = v * (1.0f - s);
+    const float q = v * (1.0f - s * f);
+    const float t = v * (1.0f - s * (1.0f - f));
+
+    auto i = static_cast<int>(sector) % 6;
+    if (i < 0) i += 6;
+    switch (i)
+    {
+        case 0: r = v; g = t; b = p; break;
+        case 1: r = q; g = v; b = p; break;
+        case 2: r = p; g = v; b = t; break;
+        case 3: r = p; g = q; b = v; break;
+        case 4: r = t; g = p; b = v; break;
+        default: r = v; g = p; b = q; break;
+    }
+}
+
+inline uint8_t roundU8(float v)
+{
+    return static_cast<uint8_t>(std::clamp(v + 0.5f, 0.0f, 255.0f));
+}
+
+template <size_t C>
+void rgbToHsvU8(const uint8_t* src, size_t n, uint8_t* dst)
+{
+    for (size_t x = 0; x < n; ++x)
+    {
+        const uint8_t* p = src + x * C;
+        float h, s, v;
+        rgbToHsvPixel(p[0], p[1], p[2], h, s, v);
+
+        uint8_t hue = roundU8(h * 0.5f);
+        if (hue >= 180) hue = static_cast<uint8_t>(hue - 180);
+        dst[3 * x] = hue;
+        dst[3 * x + 1] = roundU8(s * 255.0f);
+        dst[3 * x + 2] = static_cast<uint8_t>(v);
+    }
+}
+
+template <size_t C>
+void rgbToHsvF32(const float* src, size_t n, float* dst)
+{
+    for (size_t x = 0; x < n; ++x)
+    {
+        const float* p = src + x * C;
+        rgbToHsvPixel(p[0], p[1], p[2], dst[3 * x], dst[3 * x + 1],
+                      dst[3 * x + 2]);
+    }
+}
+
+void hsvToRgbU8(const uint8_t* src, size_t n, uint8_t* dst)
+{
+    for (size_t x = 0; x < n; ++x)
+    {
+        const uint8_t* p = src + 3 * x;
+        float r, g, b;
+        hsvToRgbPixel(p[0] * 2.0f, p[1] / 255.0f, p[2], r, g, b);
+        dst[3 * x] = roundU8(r);
+        dst[3 * x + 1] = roundU8(g);
+        dst[3 * x + 2] = roundU8(b);
+    }
+}
+
+void hsvToRgbF32(const float* src, size_t n, float* dst)
+{
+    for (size_t x = 0; x < n; ++x)
+    {
+        const float* p = src + 3 * x;
+        hsvToRgbPixel(p[0], p[1], p[2], dst[3 * x], dst[3 * x + 1],
+                      dst[3 * x + 2]);
+    }
+}
+
+// Runs fn(firstPixel, count) over bands of rows. Images are contiguous, so
+// a band is one long run of pixels.
+template <typename Fn>
+void forPixels(const Image& image, const ParallelOptions& options, Fn&& fn)
+{
+    const size_t w = image.width();
+    parallel_for_rows(
+        image,
+        [&](size_t first, size_t last) { fn(first * w, (last - first) * w); },
+        options);
+}
+
+// Calls fn.operator()<C>() with the pixel stride of an RGB or RGBA image.
+template <typename Fn>
+void dispatchAlpha(size_t channels, Fn&& fn)
+{
+    if (channels == 4)
+        fn.template operator()<4>();
+    else
+        fn.template operator()<3>();
+}
+
+// 4:2:0 chroma: the 2x2 average of full-resolution chroma rows a and b.
+template <typename T>
+void downsampleRow(const T* a, const T* b, size_t width, T* out)
+{
+    const size_t half = (width + 1) / 2;
+    for (size_t x = 0; x < half; ++x)
+    {
+        const size_t x0 = 2 * x;
+        const size_t x1 = std::min(x0 + 1, width - 1);
+        if constexpr (std::is_same_v<T, uint8_t>)
+            out[x] = static_cast<uint8_t>((a[x0] + a[x1] + b[x0] + b[x1] + 2) >> 2);
+        else
+            out[x] = 0.25f * (a[x0] + a[x1] + b[x0] + b[x1]);
+    }
+}
+
+template <typename T>
+void upsampleRow(const T* in, size_t width, T* out)
+{
+    for (size_t x = 0; x < width; ++x) out[x] = in[x / 2];
+}
+
+template <typename T>
+void forwardPlanar(const Image& src, PlanarYCbCr& dst,
+                   ChromaSubsampling subsampling, const Matrix& m,
+                   const ParallelOptions& options)
+{
+    const size_t w = src.width(), h = src.height(), C = src.channels();
+    const bool half = subsampling == ChromaSubsampling::Half;
+    const size_t cw = half ? (w + 1) / 2 : w;
+    const size_t ch = half ? (h + 1) / 2 : h;
+    const auto type = typeFor(std::is_same_v<T, float>, 1);
+
+    dst.Subsampling = subsampling;
+    dst.Y = Image(w, h, 1, type);
+    dst.Cb = Image(cw, ch, 1, type);
+    dst.Cr = Image(cw, ch, 1, type);
+
+    const T* in = src.dataAs<T>();
+    T* Y = dst.Y.dataAs<T>();
+    T* Cb = dst.Cb.dataAs<T>();
+    T* Cr = dst.Cr.dataAs<T>();
+    const ForwardFixed fixed = forwardFixed(m);
+
+    auto row = [&](const T* s, size_t n, T* y, T* cb, T* cr)
+    {
+        dispatchAlpha(
+            C,
+            [&]<size_t N>()
+            {
+                if constexpr (std::is_same_v<T, uint8_t>)
+                    forwardU8<N, Layout::Planar>(s, n, fixed, y, cb, cr);
+                else
+                    forwardF32<N, Layout::Planar>(s, n, m, y, cb, cr);
+            });
+    };
+
+    if (!half)
+    {
+        forPixels(src, options,
+                  [&](size_t first, size_t n)
+                  { row(in + first * C, n, Y + first, Cb + first, Cr + first); });
+        return;
+    }
+
+    // One chroma row per pair of source rows: luma goes straight to the
+    // output, chroma through two full-width rows that are averaged down.
+    parallel_for(
+        0, ch,
+        [&](size_t first, size_t last)
+        {
+            std::vector<T> rows(4 * w);
+            T* cb0 = rows.data();
+            T* cr0 = cb0 + w;
+            T* cb1 = cr0 + w;
+            T* cr1 = cb1 + w;
+
+            for (size_t cy = first; cy < last; ++cy)
+            {
+                const size_t y0 = 2 * cy;
+                const size_t y1 = std::min(y0 + 1, h - 1);
+                row(in + y0 * w * C, w, Y + y0 * w, cb0, cr0);
+                if (y1 != y0)
+                    row(in + y1 * w * C, w, Y + y1 * w, cb1, cr1);
+                else
+                    std::copy(cb0, cb0 + 2 * w, cb1);
+
+                downsampleRow(cb0, cb1, w, Cb + cy * cw);
+                downsampleRow(cr0, cr1, w, Cr + cy * cw);
+            }
+        },
+        options);
+}
+
+template <typename T>
+void inversePlanar(const PlanarYCbCr& src, Image& dst, const Matrix& m,
+                   const ParallelOptions& options)
+{
+    const size_t w = src.Y.width();
+    const bool half = src.Subsampling == ChromaSubsampling::Half;
+    const size_t cw = src.Cb.width();
+
+    const T* Y = src.Y.dataAs<T>();
+    const T* Cb = src.Cb.dataAs<T>();
+    const T* Cr = src.Cr.dataAs<T>();
+    T* out = dst.dataAs<T>();
+    const InverseFixed fixed = inverseFixed(m);
+
+    auto row = [&](const T* y, const T* cb, const T* cr, size_t n, T* d)
+    {
+        if constexpr (std::is_same_v<T, uint8_t>)
+            inverseU8<false>(y, cb, cr, n, fixed, d);
+        else
+            inverseF32<false>(y, cb, cr, n, m, d);
+    };
+
+    if (!half)
+    {
+        forPixels(src.Y, options,
+                  [&](size_t first, size_t n)
+                  { row(Y + first, Cb + first, Cr + first, n, out + 3 * first); });
+        return;
+    }
+
+    parallel_for_rows(
+        src.Y,
+        [&](size_t first, size_t last)
+        {
+            std::vector<T> rows(2 * w);
+            T* cb = rows.data();
+            T* cr = cb + w;
+            for (size_t y = first; y < last; ++y)
+            {
+                upsampleRow(Cb + (y / 2) * cw, w, cb);
+                upsampleRow(Cr + (y / 2) * cw, w, cr);
+                row(Y + y * w, cb, cr, w, out + 3 * y * w);
+            }
+        },
+        options);
+}
+
+void checkPlanar(const PlanarYCbCr& src)
+{
+    const Image& Y = src.Y;
+    if (Y.empty() || Y.channels() != 1)
+    {
+        throw std::invalid_argument("yCbCrToRgb: Y must be a non-empty plane");
+    }
+
+    const bool half = src.Subsampling == ChromaSubsampling::Half;
+    const size_t cw = half ? (Y.width() + 1) / 2 : Y.width();
+    const size_t ch = half ? (Y.height() + 1) / 2 : Y.height();
+    for (const Image* plane : {&src.Cb, &src.Cr})
+    {
+        if (plane->width() != cw || plane->height() != ch ||
+            plane->type() != Y.type())
+        {
+            throw std::invalid_argument(
+                "yCbCrToRgb: chroma planes do not match the subsampling");
+        }
+    }
+}
+}  // namespace
+
+void rgbToGray(const Image& src, Image& dst, const ColorOptions& options)
+{
+    checkChannels(src, true, "rgbToGray");
+    IPS_PROFILE_SCOPE("rgbToGray", "color", src);
+
+    Image scratch;
+    Image& out = target(src, dst, scratch, 1);
+    const Matrix m = matrixFor(options.Matrix, ColorRange::Full);
+    const ForwardFixed fixed = forwardFixed(m);
+    const size_t C = src.channels();
+
+    forPixels(src, options.Parallel,
+              [&](size_t first, size_t n)
+              {
+                  dispatchAlpha(
+                      C,
+                      [&]<size_t N>()
+                      {
+                          if (Image::isFloat(src.type()))
+                              forwardF32<N, Layout::Luma>(
+                                  src.dataAsFloat() + first * N, n, m,
+                                  out.dataAsFloat() + first, nullptr, nullptr);
+                          else
+                              forwardU8<N, Layout::Luma>(
+                                  src.dataAsUint8() + first * N, n, fixed,
+                                  out.dataAsUint8() + first, nullptr, nullptr);
+                      });
+              });
+    finish(dst, out, scratch);
+}
+
+void grayToRgb(const Image& src, Image& dst, const ParallelOptions& options)
+{
+    if (src.empty() || src.channels() != 1)
+    {
+        throw std::invalid_argument(
+            "grayToRgb: expected a non-empty single-channel image");
+    }
+    IPS_PROFILE_SCOPE("grayToRgb", "color", src);
+
+    Image scratch;
+    Image& out = target(src, dst, scratch, 3);
+    forPixels(src, options,
+              [&](size_t first, size_t n)
+              {
+                  if (Image::isFloat(src.type()))
+                  {
+                      const float* s = src.dataAsFloat() + first;
+                      float* d = out.dataAsFloat() + 3 * first;
+                      for (size_t x = 0; x < n; ++x)
+                      {
+                          d[3 * x] = d[3 * x + 1] = d[3 * x + 2] = s[x];
+                      }
+                  }
+                  else
+                  {
+                      grayToRgbU8(src.dataAsUint8() + first, n,
+                                  out.dataAsUint8() + 3 * first);
+                  }
+              });
+    finish(dst, out, scratch);
+}
+
+void rgbToYCbCr(const Image& src, Image& dst, const ColorOptions& options)
+{
+    checkChannels(src, true, "rgbToYCbCr");
+    IPS_PROFILE_SCOPE("rgbToYCbCr", "color", src);
+
+    Image scratch;
+    Image& out = target(src, dst, scratch, 3);
+    const Matrix m = matrixFor(options.Matrix, options.Range);
+    const ForwardFixed fixed = forwardFixed(m);
+    const size_t C = src.channels();
+
+    forPixels(src, options.Parallel,
+              [&](size_t first, size_t n)
+              {
+                  dispatchAlpha(
+                      C,
+                      [&]<size_t N>()
+                      {
+                          if (Image::isFloat(src.type()))
+                              forwardF32<N, Layout::Interleaved>(
+                                  src.dataAsFloat() + first * N, n, m,
+                                  out.dataAsFloat() + 3 * first, nullptr,
+                                  nullptr);
+                          else
+                              forwardU8<N, Layout::Interleaved>(
+                                  src.dataAsUint8() + first * N, n, fixed,
+                                  out.dataAsUint8() + 3 * first, nullptr,
+                                  nullptr);
+                      });
+              });
+    finish(dst, out, scratch);
+}
+
+void yCbCrToRgb(const Image& src, Image& dst, const ColorOptions& options)
+{
+    checkChannels(src, false, "yCbCrToRgb");
+    IPS_PROFILE_SCOPE("yCbCrToRgb", "color", src);
+
+    Image scratch;
+    Image& out = target(src, dst, scratch, 3);
+    const Matrix m = matrixFor(options.Matrix, options.Range);
+    const InverseFixed fixed = inverseFixed(m);
+
+    forPixels(src, options.Parallel,
+              [&](size_t first, size_t n)
+              {
+                  if (Image::isFloat(src.type()))
+                      inverseF32<true>(src.dataAsFloat() + 3 * first, nullptr,
+                                       nullptr, n, m,
+                                       out.dataAsFloat() + 3 * first);
+                  else
+                      inverseU8<true>(src.dataAsUint8() + 3 * first, nullptr,
+                                      nullptr, n, fixed,
+                                      out.dataAsUint8() + 3 * first);
+              });
+    finish(dst, out, scratch);
+}
+
+void rgbToYCbCr(const Image& src, PlanarYCbCr& dst,
+                ChromaSubsampling subsampling, const ColorOptions& options)
+{
+    checkChannels(src, true, "rgbToYCbCr");
+    IPS_PROFILE_SCOPE("rgbToYCbCr", "color", src);
+
+    const Matrix m = matrixFor(options.Matrix, options.Range);
+    if (Image::isFloat(src.type()))
+        forwardPlanar<float>(src, dst, subsampling, m, options.Parallel);
+    else
+        forwardPlanar<uint8_t>(src, dst, subsampling, m, options.Parallel);
+}
+
+void yCbCrToRgb(const PlanarYCbCr& src, Image& dst, const ColorOptions& options)
+{
+    checkPlanar(src);
+    IPS_PROFILE_SCOPE("yCbCrToRgb", "color", src.Y);
+
+    const bool floating = Image::isFloat(src.Y.type());
+    const auto type = typeFor(floating, 3);
+    if (dst.width() != src.Y.width() || dst.height() != src.Y.height() ||
+        dst.type() != type || dst.channels() != 3)
+    {
+        dst = Image(src.Y.width(), src.Y.height(), 3, type);
+    }
+
+    const Matrix m = matrixFor(options.Matrix, options.Range);
+    if (floating)
+        inversePlanar<float>(src, dst, m, options.Parallel);
+    else
+        inversePlanar<uint8_t>(src, dst, m, options.Parallel);
+}
+
+void rgbToHsv(const Image& src, Image& dst, const ParallelOptions& options)
+{
+    checkChannels(src, true, "rgbToHsv");
+    IPS_PROFILE_SCOPE("rgbToHsv", "color", src);
+
+    Image scratch;
+    Image& out = target(src, dst, scratch, 3);
+    const size_t C = src.channels();
+
+    forPixels(src, options,
+              [&](size_t first, size_t n)
+              {
+                  dispatchAlpha(
+                      C,
+                      [&]<size_t N>()
+                      {
+                          if (Image::isFloat(src.type()))
+                              rgbToHsvF32<N>(src.dataAsFloat() + first * N, n,
+                                             out.dataAsFloat() + 3 * first);
+                          else
+                              rgbToHsvU8<N>(src.dataAsUint8() + first * N, n,
+                                            out.dataAsUint8() + 3 * first);
+                      });
+              });
+    finish(dst, out, scratch);
+}
+
+void hsvToRgb(const Image& src, Image& dst, const ParallelOptions& options)
+{
+    checkChannels(src, false, "hsvToRgb");
+    IPS_PROFILE_SCOPE("hsvToRgb", "color", src);
+
+    Image scratch;
+    Image& out = target(src, dst, scratch, 3);
+    forPixels(src, options,
+              [&](size_t first, size_t n)
+              {
+                  if (Image::isFloat(src.type()))
+                      hsvToRgbF32(src.dataAsFloat() + 3 * first, n,
+                                  out.dataAsFloat() + 3 * first);
+                  else
+                      hsvToRgbU8(src.dataAsUint8() + 3 * first, n,
+                                 out.dataAsUint8() + 3 * first);
+              });
+    finish(dst, out, scratch);
+}
+
+Node colorNode(Conversion conversion, ColorOptions options, std::string name)
+{
+    auto run = [conversion, options](Image& image)
+    {
+        if (image.empty()) return EXECError::EXEC_FAIL;
+
+        // Same channel rules as the functions: RGB sources may carry alpha,
+        // YCbCr and HSV sources are three-channel, gray is one channel.
+        const size_t C = image.channels();
+        bool accepted = C == 3;
+        switch (conversion)
+        {
+            case Conversion::RgbToGray:
+            case Conversion::RgbToYCbCr:
+            case Conversion::RgbToHsv:
+                accepted = C == 3 || C == 4;
+                break;
+            case Conversion::GrayToRgb:
+                accepted = C == 1;
+                break;
+            case Conversion::YCbCrToRgb:
+            case Conversion::HsvToRgb:
+                break;
+        }
+        if (!accepted) return EXECError::EXEC_FAIL;
+
+        switch (conversion)
+        {
+            case Conversion::RgbToGray:
+                rgbToGray(image, image, options);
+                break;
+            case Conversion::GrayToRgb:
+                grayToRgb(image, image, options.Parallel);
+                break;
+            case Conversion::RgbToYCbCr:
+                rgbToYCbCr(image, image, options);
+                break;
+            case Conversion::YCbCrToRgb:
+                yCbCrToRgb(image, image, options);
+                break;
+            case Conversion::RgbToHsv:
+                rgbToHsv(image, image, options.Parallel);
+                break;
+            case Conversion::HsvToRgb:
+                hsvToRgb(image, image, options.Parallel);
+                break;
+        }
+        return EXECError::EXEC_SUCCESS;
+    };
+    return Node(nullptr, std::move(run), std::move(name));
+}
+
+}  // namespace ips::color
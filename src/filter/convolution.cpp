@@ -0,0 +1,616 @@
+#include "filter/convolution.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace ips::filter
+{
+
+namespace
+{
+// Working set the ring of intermediate rows of one tile should fit in.
+constexpr size_t TileCacheBytes = 256 * 1024;
+
+void checkKernel(std::span<const float> taps, const char* what)
+{
+    if (taps.empty() || taps.size() % 2 == 0)
+    {
+        throw std::invalid_argument(std::string(what) +
+                                    ": kernel size must be odd");
+    }
+}
+
+// Tile shape: full rows unless the ring of `rows` intermediate rows would
+// spill out of cache, then narrower column strips.
+void tileShape(const detail::Layout& layout, size_t rows, size_t elementBytes,
+               size_t& tileW, size_t& tileH)
+{
+    const size_t rowBytes = layout.Width * layout.Channels * elementBytes;
+    tileW = layout.Width;
+    if (rowBytes * (rows + 1) > TileCacheBytes)
+    {
+        tileW = std::max<size_t>(
+            64, TileCacheBytes / ((rows + 1) * layout.Channels * elementBytes));
+        tileW = std::min(tileW, layout.Width);
+    }
+    // Tall enough that the 2 * radius halo rows recomputed per tile stay a
+    // small fraction of the work.
+    tileH = std::max<size_t>(32, 4 * rows);
+}
+
+// Fixed-point weights with `bits` fraction bits that sum to
+// round(sum(taps) * 2^bits), plus their SIMD broadcasts.
+struct FixedTaps
+{
+    std::vector<uint16_t> Q;
+#if defined(__SSE2__)
+    struct Lanes
+    {
+        __m128i V;
+    };
+    // Q[k] in every 16-bit lane.
+    std::vector<Lanes> Splat;
+    // (Q[2j], Q[2j + 1]) in every 32-bit lane, for _mm_madd_epi16.
+    std::vector<Lanes> Pairs;
+#endif
+
+    FixedTaps(std::span<const float> taps, int bits) : Q(taps.size())
+    {
+        const float one = static_cast<float>(1 << bits);
+        float sum = 0.0f;
+        int total = 0;
+        for (size_t i = 0; i < taps.size(); ++i)
+        {
+            Q[i] = static_cast<uint16_t>(std::lround(taps[i] * one));
+            total += Q[i];
+            sum += taps[i];
+        }
+
+        // Rounding error goes to the largest tap.
+        const auto largest = static_cast<size_t>(
+            std::max_element(taps.begin(), taps.end()) - taps.begin());
+        const int diff = static_cast<int>(std::lround(sum * one)) - total;
+        Q[largest] = static_cast<uint16_t>(std::max(0, Q[largest] + diff));
+
+#if defined(__SSE2__)
+        for (size_t k = 0; k < Q.size(); ++k)
+        {
+            Splat.push_back({_mm_set1_epi16(static_cast<short>(Q[k]))});
+        }
+        for (size_t k = 0; k < Q.size(); k += 2)
+        {
+            const uint32_t next = k + 1 < Q.size() ? Q[k + 1] : 0;
+            Pairs.push_back({_mm_set1_epi32(static_cast<int>(next << 16 | Q[k]))});
+        }
+#endif
+    }
+};
+
+// u8 * 2.14 weights summed in 32 bits, stored as 8.8 fixed point. The
+// result fits 16 bits for non-negative kernels summing to at most one.
+void rowU8(const uint8_t* pad, uint16_t* out, size_t n, size_t C,
+           const FixedTaps& taps)
+{
+    const size_t count = taps.Q.size();
+    const uint16_t* q = taps.Q.data();
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i half = _mm_set1_epi32(1 << 5);
+    const __m128i bias32 = _mm_set1_epi32(32768);
+    const __m128i bias16 = _mm_set1_epi16(-32768);
+    const auto* pairs = taps.Pairs.data();
+    const size_t step = 2 * C;
+
+    for (; i + 8 <= n; i += 8)
+    {
+        // Two taps per multiply-add: interleave their pixels. An odd last
+        // tap pairs with a zero weight, reading the pixel after it, which
+        // is still inside the padded row.
+        __m128i lo = zero, hi = zero;
+        const uint8_t* p = pad + i;
+        for (size_t j = 0; j < taps.Pairs.size(); ++j, p += step)
+        {
+            const __m128i a = _mm_unpacklo_epi8(
+                _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)), zero);
+            const __m128i b = _mm_unpacklo_epi8(
+                _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p + C)),
+                zero);
+            lo = _mm_add_epi32(
+                lo, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), pairs[j].V));
+            hi = _mm_add_epi32(
+                hi, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), pairs[j].V));
+        }
+
+        lo = _mm_srli_epi32(_mm_add_epi32(lo, half), 6);
+        hi = _mm_srli_epi32(_mm_add_epi32(hi, half), 6);
+        // SSE2 only packs signed: shift into int16 range and back.
+        const __m128i packed = _mm_packs_epi32(_mm_sub_epi32(lo, bias32),
+                                               _mm_sub_epi32(hi, bias32));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i),
+                         _mm_add_epi16(packed, bias16));
+    }
+#endif
+    for (; i < n; ++i)
+    {
+        uint32_t acc = 0;
+        for (size_t k = 0; k < count; ++k) acc += uint32_t(q[k]) * pad[i + k * C];
+        out[i] = static_cast<uint16_t>((acc + (1u << 5)) >> 6);
+    }
+}
+
+// 8.8 rows * 1.15 weights in 32 bits, rounded back to u8.
+void columnU8(const uint16_t* const* rows, uint8_t* out, size_t n,
+              const FixedTaps& taps)
+{
+    const size_t count = taps.Q.size();
+    const uint16_t* q = taps.Q.data();
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i half = _mm_set1_epi32(1 << 22);
+    const auto* splat = taps.Splat.data();
+
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i a0 = zero, a1 = zero, a2 = zero, a3 = zero;
+        for (size_t k = 0; k < count; ++k)
+        {
+            const __m128i w = splat[k].V;
+            const auto* row = reinterpret_cast<const __m128i*>(rows[k] + i);
+            const __m128i v0 = _mm_loadu_si128(row);
+            const __m128i v1 = _mm_loadu_si128(row + 1);
+
+            const __m128i l0 = _mm_mullo_epi16(v0, w);
+            const __m128i h0 = _mm_mulhi_epu16(v0, w);
+            const __m128i l1 = _mm_mullo_epi16(v1, w);
+            const __m128i h1 = _mm_mulhi_epu16(v1, w);
+            a0 = _mm_add_epi32(a0, _mm_unpacklo_epi16(l0, h0));
+            a1 = _mm_add_epi32(a1, _mm_unpackhi_epi16(l0, h0));
+            a2 = _mm_add_epi32(a2, _mm_unpacklo_epi16(l1, h1));
+            a3 = _mm_add_epi32(a3, _mm_unpackhi_epi16(l1, h1));
+        }
+        a0 = _mm_srli_epi32(_mm_add_epi32(a0, half), 23);
+        a1 = _mm_srli_epi32(_mm_add_epi32(a1, half), 23);
+        a2 = _mm_srli_epi32(_mm_add_epi32(a2, half), 23);
+        a3 = _mm_srli_epi32(_mm_add_epi32(a3, half), 23);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i),
+                         _mm_packus_epi16(_mm_packs_epi32(a0, a1),
+                                          _mm_packs_epi32(a2, a3)));
+    }
+#endif
+    for (; i < n; ++i)
+    {
+        uint32_t acc = 0;
+        for (size_t k = 0; k < count; ++k) acc += uint32_t(q[k]) * rows[k][i];
+        out[i] = static_cast<uint8_t>(
+            std::min<uint32_t>((acc + (1u << 22)) >> 23, 255));
+    }
+}
+
+// One tap at a time over the whole row: plain loops the compiler turns
+// into SIMD multiply-adds.
+void rowF32(const float* pad, float* out, size_t n, size_t C, const float* w,
+            size_t taps)
+{
+    const float w0 = w[0];
+    for (size_t i = 0; i < n; ++i) out[i] = w0 * pad[i];
+
+    for (size_t k = 1; k < taps; ++k)
+    {
+        const float wk = w[k];
+        const float* s = pad + k * C;
+        for (size_t i = 0; i < n; ++i) out[i] += wk * s[i];
+    }
+}
+
+void columnF32(const float* const* rows, float* out, size_t n, const float* w,
+               size_t taps)
+{
+    const float w0 = w[0];
+    const float* r0 = rows[0];
+    for (size_t i = 0; i < n; ++i) out[i] = w0 * r0[i];
+
+    for (size_t k = 1; k < taps; ++k)
+    {
+        const float wk = w[k];
+        const float* s = rows[k];
+        for (size_t i = 0; i < n; ++i) out[i] += wk * s[i];
+    }
+}
+
+void storeRow(const float* acc, float* out, size_t n)
+{
+    std::memcpy(out, acc, n * sizeof(float));
+}
+
+void storeRow(const float* acc, uint8_t* out, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+    {
+        out[i] = static_cast<uint8_t>(
+            std::min(std::max(acc[i] + 0.5f, 0.0f), 255.0f));
+    }
+}
+
+bool fixedPointFits(std::span<const float> taps)
+{
+    float sum = 0.0f;
+    for (float t : taps)
+    {
+        if (t < 0.0f) return false;
+        sum += t;
+    }
+    return sum <= 1.0f + 1e-4f;
+}
+
+void sepU8Fixed(const Image& src, Image& dst, std::span<const float> row,
+                std::span<const float> column, const FilterOptions& options)
+{
+    const detail::Layout layout{src.width(), src.height(), src.channels()};
+    // The vertical pass multiplies 16-bit rows and stays within 32 bits
+    // with 15 fraction bits; the horizontal one has room for 14.
+    const FixedTaps qx(row, 14);
+    const FixedTaps qy(column, 15);
+    const size_t rx = row.size() / 2, ry = column.size() / 2;
+    const size_t taps = column.size();
+    const uint8_t constant = detail::borderConstant<uint8_t>(options);
+
+    const uint8_t* in = src.dataAsUint8();
+    uint8_t* out = dst.dataAsUint8();
+
+    size_t tileW, tileH;
+    tileShape(layout, taps, sizeof(uint16_t), tileW, tileH);
+
+    parallel_for_tiles(
+        src, tileW, tileH,
+        [&](const Tile& tile)
+        {
+            const size_t C = layout.Channels;
+            const size_t n = tile.Width * C;
+            // One spare pixel for the zero-weight partner of an odd tap.
+            std::vector<uint8_t> pad((tile.Width + 2 * rx + 1) * C);
+            std::vector<uint16_t> ring(taps * n);
+            std::vector<const uint16_t*> rows(taps);
+
+            const auto top = static_cast<std::ptrdiff_t>(tile.Y) -
+                             static_cast<std::ptrdiff_t>(ry);
+            const auto left = static_cast<std::ptrdiff_t>(tile.X) -
+                              static_cast<std::ptrdiff_t>(rx);
+
+            for (size_t r = 0; r < tile.Height + 2 * ry; ++r)
+            {
+                const std::ptrdiff_t sy = borderIndex(
+                    top + static_cast<std::ptrdiff_t>(r), layout.Height,
+                    options.Border);
+                detail::loadRow(in, sy, layout, left, tile.Width + 2 * rx,
+                        options.Border, constant, pad.data());
+                rowU8(pad.data(), ring.data() + (r % taps) * n, n, C, qx);
+
+                if (r + 1 < taps) continue;
+
+                const size_t y = r + 1 - taps;
+                for (size_t k = 0; k < taps; ++k)
+                {
+                    rows[k] = ring.data() + ((y + k) % taps) * n;
+                }
+                columnU8(rows.data(),
+                         out + ((tile.Y + y) * layout.Width + tile.X) * C, n,
+                         qy);
+            }
+        },
+        options.Parallel);
+}
+
+template <typename T>
+void sepFloat(const Image& src, Image& dst, std::span<const float> row,
+              std::span<const float> column, const FilterOptions& options)
+{
+    const detail::Layout layout{src.width(), src.height(), src.channels()};
+    const size_t rx = row.size() / 2, ry = column.size() / 2;
+    const size_t taps = column.size();
+
+    const T* in = src.dataAs<T>();
+    T* out = dst.dataAs<T>();
+
+    size_t tileW, tileH;
+    tileShape(layout, taps, sizeof(float), tileW, tileH);
+
+    parallel_for_tiles(
+        src, tileW, tileH,
+        [&](const Tile& tile)
+        {
+            const size_t C = layout.Channels;
+            const size_t n = tile.Width * C;
+            std::vector<float> pad((tile.Width + 2 * rx) * C);
+            std::vector<float> ring(taps * n);
+            std::vector<float> acc(n);
+            std::vector<const float*> rows(taps);
+
+            const auto top = static_cast<std::ptrdiff_t>(tile.Y) -
+                             static_cast<std::ptrdiff_t>(ry);
+            const auto left = static_cast<std::ptrdiff_t>(tile.X) -
+                              static_cast<std::ptrdiff_t>(rx);
+
+            for (size_t r = 0; r < tile.Height + 2 * ry; ++r)
+            {
+                const std::ptrdiff_t sy = borderIndex(
+                    top + static_cast<std::ptrdiff_t>(r), layout.Height,
+                    options.Border);
+                detail::loadRow(in, sy, layout, left, tile.Width + 2 * rx,
+                        options.Border, options.BorderValue, pad.data());
+                rowF32(pad.data(), ring.data() + (r % taps) * n, n, C,
+                       row.data(), row.size());
+
+                if (r + 1 < taps) continue;
+
+                const size_t y = r + 1 - taps;
+                for (size_t k = 0; k < taps; ++k)
+                {
+                    rows[k] = ring.data() + ((y + k) % taps) * n;
+                }
+                columnF32(rows.data(), acc.data(), n, column.data(), taps);
+                storeRow(acc.data(),
+                         out + ((tile.Y + y) * layout.Width + tile.X) * C, n);
+            }
+        },
+        options.Parallel);
+}
+
+// Direct path for kernels that do not factor: a ring of bordered input
+// rows, and one multiply-add sweep per non-zero weight.
+template <typename T>
+void directFloat(const Image& src, Image& dst, const Kernel& kernel,
+                 const FilterOptions& options)
+{
+    const detail::Layout layout{src.width(), src.height(), src.channels()};
+    const size_t rx = kernel.Width / 2, ry = kernel.Height / 2;
+    const size_t taps = kernel.Height;
+
+    const T* in = src.dataAs<T>();
+    T* out = dst.dataAs<T>();
+
+    size_t tileW, tileH;
+    tileShape(layout, taps, sizeof(float), tileW, tileH);
+
+    parallel_for_tiles(
+        src, tileW, tileH,
+        [&](const Tile& tile)
+        {
+            const size_t C = layout.Channels;
+            const size_t n = tile.Width * C;
+            const size_t padded = (tile.Width + 2 * rx) * C;
+            std::vector<float> ring(taps * padded);
+            std::vector<float> acc(n);
+
+            const auto top = static_cast<std::ptrdiff_t>(tile.Y) -
+                             static_cast<std::ptrdiff_t>(ry);
+            const auto left = static_cast<std::ptrdiff_t>(tile.X) -
+                              static_cast<std::ptrdiff_t>(rx);
+
+            for (size_t r = 0; r < tile.Height + 2 * ry; ++r)
+            {
+                const std::ptrdiff_t sy = borderIndex(
+                    top + static_cast<std::ptrdiff_t>(r), layout.Height,
+                    options.Border);
+                detail::loadRow(in, sy, layout, left, tile.Width + 2 * rx,
+                        options.Border, options.BorderValue,
+                        ring.data() + (r % taps) * padded);
+
+                if (r + 1 < taps) continue;
+
+                const size_t y = r + 1 - taps;
+                std::fill(acc.begin(), acc.end(), 0.0f);
+                for (size_t ky = 0; ky < taps; ++ky)
+                {
+                    const float* line = ring.data() + ((y + ky) % taps) * padded;
+                    for (size_t kx = 0; kx < kernel.Width; ++kx)
+                    {
+                        const float w = kernel(kx, ky);
+                        if (w == 0.0f) continue;
+
+                        const float* s = line + kx * C;
+                        float* a = acc.data();
+                        for (size_t i = 0; i < n; ++i) a[i] += w * s[i];
+                    }
+                }
+                storeRow(acc.data(),
+                         out + ((tile.Y + y) * layout.Width + tile.X) * C, n);
+            }
+        },
+        options.Parallel);
+}
+
+void checkImage(const Image& src, const char* what)
+{
+    if (src.empty())
+    {
+        throw std::invalid_argument(std::string(what) + ": empty image");
+    }
+}
+
+// Output buffer for src -> dst; a fresh image when they are the same.
+Image& target(const Image& src, Image& dst, Image& scratch)
+{
+    Image& out = (&src == &dst) ? scratch : dst;
+    if (out.width() != src.width() || out.height() != src.height() ||
+        out.type() != src.type() || out.channels() != src.channels())
+    {
+        out = Image(src.width(), src.height(), src.channels(), src.type());
+    }
+    return out;
+}
+}  // namespace
+
+Kernel::Kernel(size_t w, size_t h, std::vector<float> weights)
+    : Width(w), Height(h), Weights(std::move(weights))
+{
+    if (w % 2 == 0 || h % 2 == 0 || Weights.size() != w * h)
+    {
+        throw std::invalid_argument(
+            "Kernel: sizes must be odd and match the weights");
+    }
+}
+
+std::vector<float> gaussianKernel(float sigma, size_t radius)
+{
+    if (!(sigma > 0.0f))
+    {
+        throw std::invalid_argument("gaussianKernel: sigma must be positive");
+    }
+    if (radius == 0)
+    {
+        radius = std::max<size_t>(1, static_cast<size_t>(std::ceil(3.0f * sigma)));
+    }
+
+    std::vector<float> taps(2 * radius + 1);
+    const double scale = -0.5 / (double(sigma) * sigma);
+    double sum = 0.0;
+    for (size_t i = 0; i < taps.size(); ++i)
+    {
+        const double d = double(i) - double(radius);
+        const double v = std::exp(d * d * scale);
+        taps[i] = static_cast<float>(v);
+        sum += v;
+    }
+    for (float& t : taps) t = static_cast<float>(t / sum);
+    return taps;
+}
+
+bool separateKernel(const Kernel& kernel, std::vector<float>& row,
+                    std::vector<float>& column, float tolerance)
+{
+    if (kernel.Weights.empty()) return false;
+
+    // Pivot on the largest weight: its row and column span a rank-1 kernel.
+    const auto pivot = static_cast<size_t>(
+        std::max_element(kernel.Weights.begin(), kernel.Weights.end(),
+                         [](float a, float b)
+                         { return std::abs(a) < std::abs(b); }) -
+        kernel.Weights.begin());
+    const size_t px = pivot % kernel.Width, py = pivot / kernel.Width;
+    const float peak = kernel.Weights[pivot];
+    if (peak == 0.0f) return false;
+
+    std::vector<float> r(kernel.Width), c(kernel.Height);
+    for (size_t x = 0; x < kernel.Width; ++x) r[x] = kernel(x, py) / peak;
+    for (size_t y = 0; y < kernel.Height; ++y) c[y] = kernel(px, y);
+
+    const float limit = tolerance * std::abs(peak);
+    for (size_t y = 0; y < kernel.Height; ++y)
+    {
+        for (size_t x = 0; x < kernel.Width; ++x)
+        {
+            if (std::abs(kernel(x, y) - c[y] * r[x]) > limit) return false;
+        }
+    }
+
+    row = std::move(r);
+    column = std::move(c);
+    return true;
+}
+
+void sepFilter2D(const Image& src, Image& dst, std::span<const float> row,
+                 std::span<const float> column, const FilterOptions& options)
+{
+    checkKernel(row, "sepFilter2D");
+    checkKernel(column, "sepFilter2D");
+    checkImage(src, "sepFilter2D");
+
+    Image scratch;
+    Image& out = target(src, dst, scratch);
+
+    if (Image::isFloat(src.type()))
+    {
+        sepFloat<float>(src, out, row, column, options);
+    }
+    else if (fixedPointFits(row) && fixedPointFits(column))
+    {
+        sepU8Fixed(src, out, row, column, options);
+    }
+    else
+    {
+        sepFloat<uint8_t>(src, out, row, column, options);
+    }
+
+    if (&out == &scratch) dst = std::move(scratch);
+}
+
+void filter2D(const Image& src, Image& dst, const Kernel& kernel,
+              const FilterOptions& options)
+{
+    std::vector<float> row, column;
+    if (separateKernel(kernel, row, column))
+    {
+        sepFilter2D(src, dst, row, column, options);
+        return;
+    }
+
+    checkImage(src, "filter2D");
+    if (kernel.Weights.empty())
+    {
+        throw std::invalid_argument("filter2D: empty kernel");
+    }
+
+    Image scratch;
+    Image& out = target(src, dst, scratch);
+
+    if (Image::isFloat(src.type()))
+        directFloat<float>(src, out, kernel, options);
+    else
+        directFloat<uint8_t>(src, out, kernel, options);
+
+    if (&out == &scratch) dst = std::move(scratch);
+}
+
+void gaussianBlur(const Image& src, Image& dst, float sigmaX, float sigmaY,
+                  const FilterOptions& options)
+{
+    const std::vector<float> row = gaussianKernel(sigmaX);
+    if (sigmaY <= 0.0f || sigmaY == sigmaX)
+    {
+        sepFilter2D(src, dst, row, row, options);
+    }
+    else
+    {
+        sepFilter2D(src, dst, row, gaussianKernel(sigmaY), options);
+    }
+}
+
+Node filterNode(Kernel kernel, FilterOptions options, std::string name)
+{
+    if (kernel.Weights.empty())
+    {
+        throw std::invalid_argument("filterNode: empty kernel");
+    }
+
+    auto run = [kernel = std::move(kernel), options](Image& image)
+    {
+        if (image.empty()) return EXECError::EXEC_FAIL;
+        filter2D(image, image, kernel, options);
+        return EXECError::EXEC_SUCCESS;
+    };
+    return Node(nullptr, std::move(run), std::move(name));
+}
+
+Node gaussianNode(float sigma, FilterOptions options, std::string name)
+{
+    auto taps = gaussianKernel(sigma);
+
+    auto run = [taps = std::move(taps), options](Image& image)
+    {
+        if (image.empty()) return EXECError::EXEC_FAIL;
+        sepFilter2D(image, image, taps, taps, options);
+        return EXECError::EXEC_SUCCESS;
+    };
+    return Node(nullptr, std::move(run), std::move(name));
+}
+
+}  // namespace ips::filter
@@ -0,0 +1,428 @@
+#include "filter/gradient.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "filter/border.hpp"
+#include "profiler.hpp"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace ips::filter
+{
+
+namespace
+{
+// tan(22.5) and tan(67.5): sector limits of the direction quantization.
+constexpr float Tan22 = 0.41421356f;
+constexpr float Tan67 = 2.41421356f;
+
+// Hysteresis map values. Traced marks edge pixels already followed.
+constexpr uint8_t NotEdge = 0, Weak = 1, Strong = 2, Traced = 3;
+
+void checkSource(const Image& src, const char* what)
+{
+    if (src.empty())
+    {
+        throw std::invalid_argument(std::string(what) + ": empty image");
+    }
+    if (src.type() != Image::IMAGE_TYPE::IMAGE_U8C1 &&
+        src.type() != Image::IMAGE_TYPE::IMAGE_F32C1)
+    {
+        throw std::invalid_argument(std::string(what) +
+                                    ": expected a U8C1 or F32C1 image");
+    }
+}
+
+// Sums of U8 rows stay within int16 even with Scharr weights
+// (16 * 255 * 2), so the U8 path works in 8-lane int16.
+template <typename T>
+using Work = std::conditional_t<std::is_same_v<T, uint8_t>, int16_t, float>;
+
+// Derivatives of image rows one at a time. Each row reads three source
+// rows padded by one pixel on both sides; the smoothing is separable, so
+// columns are combined once and then differenced along the row.
+template <typename T>
+class DerivativeRows
+{
+   public:
+    DerivativeRows(const Image& src, GradientOperator op,
+                   const FilterOptions& options)
+        : In(src.dataAs<T>()),
+          Layout{src.width(), src.height(), 1},
+          Border(options.Border),
+          Constant(detail::borderConstant<T>(options)),
+          Outer(op == GradientOperator::Sobel ? 1 : 3),
+          Inner(op == GradientOperator::Sobel ? 2 : 10),
+          Rows(3 * (src.width() + 2)),
+          Smooth(src.width() + 2),
+          Diff(src.width() + 2)
+    {
+    }
+
+    void row(size_t y, float* dx, float* dy)
+    {
+        const size_t w = Layout.Width, padded = w + 2;
+        Work<T>* r[3];
+        for (size_t k = 0; k < 3; ++k)
+        {
+            r[k] = Rows.data() + k * padded;
+            const std::ptrdiff_t sy = borderIndex(
+                static_cast<std::ptrdiff_t>(y + k) - 1, Layout.Height, Border);
+            detail::loadRow(In, sy, Layout, -1, padded, Border, Constant, r[k]);
+        }
+
+        // Locals: the stores below could otherwise alias the members.
+        const Work<T> a = Outer, b = Inner;
+        Work<T>* sm = Smooth.data();
+        Work<T>* df = Diff.data();
+        for (size_t i = 0; i < padded; ++i)
+        {
+            sm[i] = static_cast<Work<T>>(a * r[0][i] + b * r[1][i] + a * r[2][i]);
+            df[i] = static_cast<Work<T>>(r[2][i] - r[0][i]);
+        }
+        for (size_t x = 0; x < w; ++x)
+        {
+            dx[x] = static_cast<float>(sm[x + 2] - sm[x]);
+            dy[x] = static_cast<float>(a * df[x] + b * df[x + 1] + a * df[x + 2]);
+        }
+    }
+
+   private:
+    const T* In;
+    detail::Layout Layout;
+    BorderMode Border;
+    Work<T> Constant;
+    Work<T> Outer, Inner;
+    std::vector<Work<T>> Rows, Smooth, Diff;
+};
+
+void magnitudeRow(const float* dx, const float* dy, size_t w, float* mag)
+{
+    for (size_t x = 0; x < w; ++x)
+    {
+        mag[x] = std::sqrt(dx[x] * dx[x] + dy[x] * dy[x]);
+    }
+}
+
+void squaredMagnitudeRow(const float* dx, const float* dy, size_t w,
+                         float* mag)
+{
+    for (size_t x = 0; x < w; ++x) mag[x] = dx[x] * dx[x] + dy[x] * dy[x];
+}
+
+void directionRow(const float* dx, const float* dy, size_t w, uint8_t* dir)
+{
+    for (size_t x = 0; x < w; ++x)
+    {
+        const float ax = std::abs(dx[x]), ay = std::abs(dy[x]);
+        const bool sameSign = (dx[x] > 0.0f) == (dy[x] > 0.0f);
+        uint8_t d = sameSign ? uint8_t(Direction45) : uint8_t(Direction135);
+        d = ay <= ax * Tan22 ? uint8_t(Direction0) : d;
+        d = ay >= ax * Tan67 ? uint8_t(Direction90) : d;
+        dir[x] = d;
+    }
+}
+
+template <typename T>
+void gradientImages(const Image& src, Gradients& out, GradientOperator op,
+                    const FilterOptions& options)
+{
+    const size_t w = src.width();
+    float* dx = out.Dx.dataAsFloat();
+    float* dy = out.Dy.dataAsFloat();
+    float* mag = out.Magnitude.dataAsFloat();
+    uint8_t* dir = out.Direction.dataAsUint8();
+
+    parallel_for_rows(
+        src,
+        [&](size_t first, size_t last)
+        {
+            DerivativeRows<T> rows(src, op, options);
+            for (size_t y = first; y < last; ++y)
+            {
+                const size_t at = y * w;
+                rows.row(y, dx + at, dy + at);
+                magnitudeRow(dx + at, dy + at, w, mag + at);
+                directionRow(dx + at, dy + at, w, dir + at);
+            }
+        },
+        options.Parallel);
+}
+
+// Non-maximum suppression of row y into `map` (Weak / Strong / NotEdge),
+// from magnitudes of rows y - 1, y, y + 1 padded by a zero on each side.
+// A pixel must beat the neighbour before it across the edge and at least
+// match the one after, so plateaus give one-pixel-wide edges.
+void suppressRow(const float* above, const float* mid, const float* below,
+                 const uint8_t* dir, size_t w, float low, float high,
+                 uint8_t* map)
+{
+    size_t x = 0;
+#if defined(__SSE2__)
+    // Four pixels at a time, with the direction turned into lane masks
+    // that select the neighbours instead of branching on it.
+    auto select = [](__m128i mask, __m128 a, __m128 b)
+    {
+        const __m128 m = _mm_castsi128_ps(mask);
+        return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b));
+    };
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi32(1);
+    const __m128 lowV = _mm_set1_ps(low), highV = _mm_set1_ps(high);
+
+    for (; x + 4 <= w; x += 4)
+    {
+        int32_t packed;
+        std::memcpy(&packed, dir + x, 4);
+        const __m128i d = _mm_unpacklo_epi16(
+            _mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), zero), zero);
+        const __m128i is0 = _mm_cmpeq_epi32(d, _mm_set1_epi32(Direction0));
+        const __m128i is45 = _mm_cmpeq_epi32(d, _mm_set1_epi32(Direction45));
+        const __m128i is90 = _mm_cmpeq_epi32(d, _mm_set1_epi32(Direction90));
+
+        const __m128 m = _mm_loadu_ps(mid + x + 1);
+        const __m128 before = select(
+            is0, _mm_loadu_ps(mid + x),
+            select(is45, _mm_loadu_ps(above + x),
+                   select(is90, _mm_loadu_ps(above + x + 1),
+                          _mm_loadu_ps(above + x + 2))));
+        const __m128 after = select(
+            is0, _mm_loadu_ps(mid + x + 2),
+            select(is45, _mm_loadu_ps(below + x + 2),
+                   select(is90, _mm_loadu_ps(below + x + 1),
+                          _mm_loadu_ps(below + x))));
+
+        const __m128 peak =
+            _mm_and_ps(_mm_and_ps(_mm_cmpgt_ps(m, lowV), _mm_cmpgt_ps(m, before)),
+                       _mm_cmpge_ps(m, after));
+        const __m128 strong = _mm_and_ps(peak, _mm_cmpgt_ps(m, highV));
+
+        // Weak = 1, Strong = 2: one for a peak, one more if strong.
+        const __m128i value =
+            _mm_add_epi32(_mm_and_si128(_mm_castps_si128(peak), one),
+                          _mm_and_si128(_mm_castps_si128(strong), one));
+        const __m128i bytes =
+            _mm_packus_epi16(_mm_packs_epi32(value, zero), zero);
+        const int32_t out = _mm_cvtsi128_si32(bytes);
+        std::memcpy(map + x, &out, 4);
+    }
+#endif
+    for (; x < w; ++x)
+    {
+        const uint8_t d = dir[x];
+        const float m = mid[x + 1];
+        const float before = d == Direction0    ? mid[x]
+                             : d == Direction45 ? above[x]
+                             : d == Direction90 ? above[x + 1]
+                                                : above[x + 2];
+        const float after = d == Direction0    ? mid[x + 2]
+                            : d == Direction45 ? below[x + 2]
+                            : d == Direction90 ? below[x + 1]
+                                               : below[x];
+        const bool peak = m > low && m > before && m >= after;
+        map[x] = peak ? (m > high ? Strong : Weak) : NotEdge;
+    }
+}
+
+// Fills the interior of `map`, (w + 2) x (h + 2) with a NotEdge frame.
+// Each band keeps magnitude rows y - 1, y and y + 1 in a ring. Squared
+// magnitudes order the same way and save the square roots.
+template <typename T>
+void suppress(const Image& src, std::vector<uint8_t>& map, float low,
+              float high, GradientOperator op, const FilterOptions& options)
+{
+    const size_t w = src.width(), h = src.height();
+    const size_t stride = w + 2;
+    // Negative thresholds pass every magnitude, as they would unsquared.
+    const float lowSq = low < 0.0f ? -1.0f : low * low;
+    const float highSq = high < 0.0f ? -1.0f : high * high;
+
+    parallel_for_rows(
+        src,
+        [&](size_t first, size_t last)
+        {
+            DerivativeRows<T> rows(src, op, options);
+            std::vector<float> dx(w), dy(w);
+            std::vector<float> ring(3 * stride, 0.0f);
+            std::vector<uint8_t> dir(w);
+
+            // Magnitude of row y into its ring slot; zero outside the image.
+            auto load = [&](std::ptrdiff_t y)
+            {
+                float* slot = ring.data() + size_t((y + 3) % 3) * stride;
+                if (y < 0 || y >= static_cast<std::ptrdiff_t>(h))
+                {
+                    std::fill(slot, slot + stride, 0.0f);
+                    return;
+                }
+                rows.row(static_cast<size_t>(y), dx.data(), dy.data());
+                squaredMagnitudeRow(dx.data(), dy.data(), w, slot + 1);
+            };
+
+            const auto top = static_cast<std::ptrdiff_t>(first);
+            load(top - 1);
+            load(top);
+
+            for (size_t y = first; y < last; ++y)
+            {
+                // dx and dy hold row y until row y + 1 is loaded.
+                directionRow(dx.data(), dy.data(), w, dir.data());
+                const auto yy = static_cast<std::ptrdiff_t>(y);
+                load(yy + 1);
+
+                suppressRow(ring.data() + size_t((yy + 2) % 3) * stride,
+                            ring.data() + size_t(yy % 3) * stride,
+                            ring.data() + size_t((yy + 1) % 3) * stride,
+                            dir.data(), w, lowSq, highSq,
+                            map.data() + (y + 1) * stride + 1);
+            }
+        },
+        options.Parallel);
+}
+
+// Grows Strong pixels into connected Weak ones with an explicit stack,
+// marking everything reached Traced. Each seed is followed as soon as the
+// scan finds it, so the stack stays short and its pixels stay in cache.
+void hysteresis(std::vector<uint8_t>& map, size_t w, size_t h)
+{
+    const auto stride = static_cast<std::ptrdiff_t>(w + 2);
+    const std::ptrdiff_t neighbours[8] = {-stride - 1, -stride, -stride + 1,
+                                          -1,          1,       stride - 1,
+                                          stride,      stride + 1};
+
+    std::vector<uint8_t*> stack;
+    auto trace = [&](uint8_t* seed)
+    {
+        *seed = Traced;
+        stack.push_back(seed);
+        while (!stack.empty())
+        {
+            uint8_t* p = stack.back();
+            stack.pop_back();
+            for (const std::ptrdiff_t offset : neighbours)
+            {
+                uint8_t* q = p + offset;
+                if (*q == Weak)
+                {
+                    *q = Traced;
+                    stack.push_back(q);
+                }
+            }
+        }
+    };
+
+    // Most of the map is NotEdge, so skip it eight bytes at a time.
+    uint8_t* const begin = map.data() + stride;
+    const size_t count = static_cast<size_t>(stride) * h;
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        uint64_t word;
+        std::memcpy(&word, begin + i, 8);
+        if (word == 0) continue;
+        for (size_t k = i; k < i + 8; ++k)
+        {
+            if (begin[k] == Strong) trace(begin + k);
+        }
+    }
+    for (; i < count; ++i)
+    {
+        if (begin[i] == Strong) trace(begin + i);
+    }
+}
+}  // namespace
+
+void gradients(const Image& src, Gradients& out, GradientOperator op,
+               const FilterOptions& options)
+{
+    checkSource(src, "gradients");
+    IPS_PROFILE_SCOPE("gradients", "filter", src);
+
+    const size_t w = src.width(), h = src.height();
+    for (Image* image : {&out.Dx, &out.Dy, &out.Magnitude})
+    {
+        if (image->width() != w || image->height() != h ||
+            image->type() != Image::IMAGE_TYPE::IMAGE_F32C1)
+        {
+            *image = Image(w, h, 1, Image::IMAGE_TYPE::IMAGE_F32C1);
+        }
+    }
+    if (out.Direction.width() != w || out.Direction.height() != h ||
+        out.Direction.type() != Image::IMAGE_TYPE::IMAGE_U8C1)
+    {
+        out.Direction = Image(w, h, 1, Image::IMAGE_TYPE::IMAGE_U8C1);
+    }
+
+    if (src.type() == Image::IMAGE_TYPE::IMAGE_U8C1)
+        gradientImages<uint8_t>(src, out, op, options);
+    else
+        gradientImages<float>(src, out, op, options);
+}
+
+void canny(const Image& src, Image& edges, float low, float high,
+           GradientOperator op, const FilterOptions& options)
+{
+    checkSource(src, "canny");
+    if (low > high)
+    {
+        throw std::invalid_argument("canny: low threshold above high");
+    }
+    IPS_PROFILE_SCOPE("canny", "filter", src);
+
+    const size_t w = src.width(), h = src.height();
+    std::vector<uint8_t> map((w + 2) * (h + 2), NotEdge);
+
+    if (src.type() == Image::IMAGE_TYPE::IMAGE_U8C1)
+        suppress<uint8_t>(src, map, low, high, op, options);
+    else
+        suppress<float>(src, map, low, high, op, options);
+
+    hysteresis(map, w, h);
+
+    // Assigned only now so src may be edges.
+    Image out(w, h, 1, Image::IMAGE_TYPE::IMAGE_U8C1);
+    uint8_t* o = out.dataAsUint8();
+    parallel_for_rows(
+        out,
+        [&](size_t first, size_t last)
+        {
+            for (size_t y = first; y < last; ++y)
+            {
+                const uint8_t* m = map.data() + (y + 1) * (w + 2) + 1;
+                uint8_t* d = o + y * w;
+                for (size_t x = 0; x < w; ++x)
+                {
+                    d[x] = m[x] == Traced ? 255 : 0;
+                }
+            }
+        },
+        options.Parallel);
+    edges = std::move(out);
+}
+
+Node cannyNode(float low, float high, GradientOperator op,
+               FilterOptions options, std::string name)
+{
+    if (low > high)
+    {
+        throw std::invalid_argument("cannyNode: low threshold above high");
+    }
+
+    auto run = [low, high, op, options](Image& image)
+    {
+        if (image.empty() || image.channels() != 1) return EXECError::EXEC_FAIL;
+        canny(image, image, low, high, op, options);
+        return EXECError::EXEC_SUCCESS;
+    };
+    return Node(nullptr, std::move(run), std::move(name));
+}
+
+}  // namespace ips::filter
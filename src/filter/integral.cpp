@@ -0,0 +1,356 @@
+#include "filter/integral.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+
+#include "filter/border.hpp"
+#include "profiler.hpp"
+
+namespace ips::filter
+{
+
+namespace
+{
+// Fewest columns worth handing to a thread in the column pass.
+constexpr size_t MinColumnBlock = 256;
+
+// Summed-area tables of the w x h region of src starting at (x0, y0),
+// which may reach outside the image and is read through the border.
+// squares may be null.
+template <typename T, typename AccS, typename AccQ>
+void buildTables(const Image& src, std::ptrdiff_t x0, std::ptrdiff_t y0,
+                 size_t w, size_t h, BorderMode mode, T constant, AccS* sums,
+                 AccQ* squares, const ParallelOptions& options)
+{
+    const detail::Layout layout{src.width(), src.height(), src.channels()};
+    const size_t C = layout.Channels;
+    const size_t stride = (w + 1) * C;
+    const T* in = src.dataAs<T>();
+
+    std::fill(sums, sums + stride, AccS(0));
+    if (squares) std::fill(squares, squares + stride, AccQ(0));
+
+    // Rows: independent prefix sums, with the first column zero.
+    parallel_for(
+        0, h,
+        [&](size_t first, size_t last)
+        {
+            std::vector<T> pad(w * C);
+            for (size_t y = first; y < last; ++y)
+            {
+                const std::ptrdiff_t sy = borderIndex(
+                    y0 + static_cast<std::ptrdiff_t>(y), layout.Height, mode);
+                detail::loadRow(in, sy, layout, x0, w, mode, constant,
+                                pad.data());
+
+                AccS* s = sums + (y + 1) * stride;
+                std::fill(s, s + C, AccS(0));
+                for (size_t i = 0; i < w * C; ++i)
+                {
+                    s[i + C] = s[i] + AccS(pad[i]);
+                }
+
+                if (!squares) continue;
+                AccQ* q = squares + (y + 1) * stride;
+                std::fill(q, q + C, AccQ(0));
+                for (size_t i = 0; i < w * C; ++i)
+                {
+                    q[i + C] = q[i] + AccQ(pad[i]) * AccQ(pad[i]);
+                }
+            }
+        },
+        options);
+
+    // Columns: add each row to the one below, in blocks of columns so
+    // threads split the work and the inner loop vectorizes.
+    ParallelOptions blocks = options;
+    blocks.Grain = std::max(
+        MinColumnBlock,
+        ips::detail::grainFor(stride, 0, ips::detail::poolOf(options)));
+
+    auto columns = [&](auto* table)
+    {
+        parallel_for(
+            0, stride,
+            [&](size_t c0, size_t c1)
+            {
+                for (size_t y = 2; y <= h; ++y)
+                {
+                    auto* row = table + y * stride;
+                    const auto* above = row - stride;
+                    for (size_t i = c0; i < c1; ++i) row[i] += above[i];
+                }
+            },
+            blocks);
+    };
+    columns(sums);
+    if (squares) columns(squares);
+}
+
+// Unsigned tables may wrap: a window sum is a difference of four entries,
+// which modular arithmetic gets right as long as the sum itself fits. So
+// 32 bits are enough whenever the largest possible window sum fits.
+template <typename Fn>
+void withAccumulator(uint64_t largestSum, Fn&& fn)
+{
+    if (largestSum <= std::numeric_limits<uint32_t>::max())
+        fn.template operator()<uint32_t>();
+    else
+        fn.template operator()<uint64_t>();
+}
+
+// Tables of the image extended by the window's reach on every side, so
+// output pixel (x, y) reads window [x, x + kw) x [y, y + kh) of the table.
+struct Window
+{
+    size_t Width, Height;
+    std::ptrdiff_t Left, Top;
+    size_t TableWidth, TableHeight;
+
+    Window(const Image& src, size_t kw, size_t kh)
+        : Width(kw),
+          Height(kh),
+          Left(-static_cast<std::ptrdiff_t>(kw / 2)),
+          Top(-static_cast<std::ptrdiff_t>(kh / 2)),
+          TableWidth(src.width() + kw - 1),
+          TableHeight(src.height() + kh - 1)
+    {
+    }
+
+    size_t entries(size_t channels) const
+    {
+        return (TableWidth + 1) * (TableHeight + 1) * channels;
+    }
+};
+
+template <typename T, typename Acc>
+void boxMean(const Image& src, Image& out, const Window& win,
+             const FilterOptions& options)
+{
+    const size_t w = src.width(), C = src.channels();
+    const size_t stride = (win.TableWidth + 1) * C;
+    const size_t span = win.Width * C;
+
+    std::vector<Acc> table(win.entries(C));
+    buildTables<T, Acc, Acc>(src, win.Left, win.Top, win.TableWidth,
+                             win.TableHeight, options.Border,
+                             detail::borderConstant<T>(options), table.data(),
+                             nullptr, options.Parallel);
+
+    const float inverse = 1.0f / float(win.Width * win.Height);
+    T* dst = out.dataAs<T>();
+
+    parallel_for_rows(
+        src,
+        [&](size_t first, size_t last)
+        {
+            for (size_t y = first; y < last; ++y)
+            {
+                const Acc* top = table.data() + y * stride;
+                const Acc* bottom = top + win.Height * stride;
+                T* d = dst + y * w * C;
+                for (size_t i = 0; i < w * C; ++i)
+                {
+                    const Acc s = bottom[i + span] - bottom[i] - top[i + span] + top[i];
+                    if constexpr (std::is_same_v<T, uint8_t>)
+                        d[i] = static_cast<uint8_t>(float(s) * inverse + 0.5f);
+                    else
+                        d[i] = float(s) * inverse;
+                }
+            }
+        },
+        options.Parallel);
+}
+
+template <typename T, typename AccS, typename AccQ>
+void meanVariance(const Image& src, Image& mean, Image& variance,
+                  const Window& win, const FilterOptions& options)
+{
+    const size_t w = src.width(), C = src.channels();
+    const size_t stride = (win.TableWidth + 1) * C;
+    const size_t span = win.Width * C;
+
+    std::vector<AccS> sums(win.entries(C));
+    std::vector<AccQ> squares(win.entries(C));
+    buildTables<T, AccS, AccQ>(src, win.Left, win.Top, win.TableWidth,
+                               win.TableHeight, options.Border,
+                               detail::borderConstant<T>(options), sums.data(),
+                               squares.data(), options.Parallel);
+
+    const double inverse = 1.0 / double(win.Width * win.Height);
+    float* m = mean.dataAsFloat();
+    float* v = variance.dataAsFloat();
+
+    parallel_for_rows(
+        src,
+        [&](size_t first, size_t last)
+        {
+            for (size_t y = first; y < last; ++y)
+            {
+                const AccS* st = sums.data() + y * stride;
+                const AccS* sb = st + win.Height * stride;
+                const AccQ* qt = squares.data() + y * stride;
+                const AccQ* qb = qt + win.Height * stride;
+                const size_t row = y * w * C;
+                for (size_t i = 0; i < w * C; ++i)
+                {
+                    const AccS s = sb[i + span] - sb[i] - st[i + span] + st[i];
+                    const AccQ q = qb[i + span] - qb[i] - qt[i + span] + qt[i];
+                    const double mu = double(s) * inverse;
+                    m[row + i] = static_cast<float>(mu);
+                    v[row + i] = static_cast<float>(
+                        std::max(0.0, double(q) * inverse - mu * mu));
+                }
+            }
+        },
+        options.Parallel);
+}
+
+void checkWindow(const Image& src, size_t width, size_t height,
+                 const char* what)
+{
+    if (src.empty())
+    {
+        throw std::invalid_argument(std::string(what) + ": empty image");
+    }
+    if (width == 0 || height == 0)
+    {
+        throw std::invalid_argument(std::string(what) + ": empty window");
+    }
+}
+}  // namespace
+
+template <typename Acc>
+void integral(const Image& src, IntegralImage<Acc>& sums,
+              IntegralImage<Acc>* squares, const ParallelOptions& options)
+{
+    if (src.empty())
+    {
+        throw std::invalid_argument("integral: empty image");
+    }
+    const bool floating = Image::isFloat(src.type());
+    if (floating && !std::is_floating_point_v<Acc>)
+    {
+        throw std::invalid_argument(
+            "integral: F32 images need a floating-point accumulator");
+    }
+    IPS_PROFILE_SCOPE("integral", "filter", src);
+
+    const size_t w = src.width(), h = src.height(), C = src.channels();
+    const size_t entries = (w + 1) * (h + 1) * C;
+    for (IntegralImage<Acc>* table : {&sums, squares})
+    {
+        if (!table) continue;
+        table->Width = w;
+        table->Height = h;
+        table->Channels = C;
+        table->Table.resize(entries);
+    }
+
+    Acc* sq = squares ? squares->Table.data() : nullptr;
+    if (floating)
+        buildTables<float, Acc, Acc>(src, 0, 0, w, h, BorderMode::Replicate,
+                                     0.0f, sums.Table.data(), sq, options);
+    else
+        buildTables<uint8_t, Acc, Acc>(src, 0, 0, w, h, BorderMode::Replicate,
+                                       uint8_t(0), sums.Table.data(), sq,
+                                       options);
+}
+
+template void integral<uint64_t>(const Image&, IntegralImage<uint64_t>&,
+                                 IntegralImage<uint64_t>*,
+                                 const ParallelOptions&);
+template void integral<double>(const Image&, IntegralImage<double>&,
+                               IntegralImage<double>*, const ParallelOptions&);
+
+void boxFilter(const Image& src, Image& dst, size_t width, size_t height,
+               const FilterOptions& options)
+{
+    checkWindow(src, width, height, "boxFilter");
+    IPS_PROFILE_SCOPE("boxFilter", "filter", src);
+
+    Image scratch;
+    Image& out = (&src == &dst) ? scratch : dst;
+    if (out.width() != src.width() || out.height() != src.height() ||
+        out.type() != src.type() || out.channels() != src.channels())
+    {
+        out = Image(src.width(), src.height(), src.channels(), src.type());
+    }
+
+    const Window win(src, width, height);
+    if (Image::isFloat(src.type()))
+    {
+        boxMean<float, double>(src, out, win, options);
+    }
+    else
+    {
+        withAccumulator(uint64_t(255) * width * height,
+                        [&]<typename Acc>()
+                        { boxMean<uint8_t, Acc>(src, out, win, options); });
+    }
+
+    if (&out == &scratch) dst = std::move(scratch);
+}
+
+void localMeanVariance(const Image& src, Image& mean, Image& variance,
+                       size_t width, size_t height, const FilterOptions& options)
+{
+    checkWindow(src, width, height, "localMeanVariance");
+    const size_t C = src.channels();
+    if (C != 1 && C != 3)
+    {
+        throw std::invalid_argument(
+            "localMeanVariance: expected one or three channels");
+    }
+    IPS_PROFILE_SCOPE("localMeanVariance", "filter", src);
+
+    const auto type =
+        C == 1 ? Image::IMAGE_TYPE::IMAGE_F32C1 : Image::IMAGE_TYPE::IMAGE_F32C3;
+    Image m(src.width(), src.height(), C, type);
+    Image v(src.width(), src.height(), C, type);
+
+    const Window win(src, width, height);
+    if (Image::isFloat(src.type()))
+    {
+        meanVariance<float, double, double>(src, m, v, win, options);
+    }
+    else
+    {
+        const uint64_t area = uint64_t(width) * height;
+        withAccumulator(
+            255 * area,
+            [&]<typename AccS>()
+            {
+                withAccumulator(
+                    255 * 255 * area,
+                    [&]<typename AccQ>()
+                    { meanVariance<uint8_t, AccS, AccQ>(src, m, v, win, options); });
+            });
+    }
+
+    // Assigned last so src may be mean or variance.
+    mean = std::move(m);
+    variance = std::move(v);
+}
+
+Node boxFilterNode(size_t width, size_t height, FilterOptions options,
+                   std::string name)
+{
+    if (width == 0 || height == 0)
+    {
+        throw std::invalid_argument("boxFilterNode: empty window");
+    }
+
+    auto run = [width, height, options](Image& image)
+    {
+        if (image.empty()) return EXECError::EXEC_FAIL;
+        boxFilter(image, image, width, height, options);
+        return EXECError::EXEC_SUCCESS;
+    };
+    return Node(nullptr, std::move(run), std::move(name));
+}
+
+}  // namespace ips::filter
@@ -0,0 +1,438 @@
+#include "filter/median.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "filter/border.hpp"
+#include "profiler.hpp"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace ips::filter
+{
+
+namespace
+{
+// Working set the column histograms of one stripe should fit in.
+constexpr size_t StripeCacheBytes = 256 * 1024;
+// Narrowest stripe worth its 2 * radius columns of overlap.
+constexpr size_t MinStripe = 64;
+
+constexpr size_t Bins = 256;
+constexpr size_t Coarse = 16;
+
+using Exchange = std::pair<uint8_t, uint8_t>;
+
+// Median-selecting networks (Devillard, after Paeth and Smith): after
+// the exchanges, element 4 of 9 and element 12 of 25 hold the median.
+constexpr std::array<Exchange, 19> Median9 = {{
+    {1, 2}, {4, 5}, {7, 8}, {0, 1}, {3, 4}, {6, 7}, {1, 2},
+    {4, 5}, {7, 8}, {0, 3}, {5, 8}, {4, 7}, {3, 6}, {1, 4},
+    {2, 5}, {4, 7}, {4, 2}, {6, 4}, {4, 2},
+}};
+
+constexpr std::array<Exchange, 99> Median25 = {{
+    {0, 1},   {3, 4},   {2, 4},   {2, 3},   {6, 7},   {5, 7},   {5, 6},
+    {9, 10},  {8, 10},  {8, 9},   {12, 13}, {11, 13}, {11, 12}, {15, 16},
+    {14, 16}, {14, 15}, {18, 19}, {17, 19}, {17, 18}, {21, 22}, {20, 22},
+    {20, 21}, {23, 24}, {2, 5},   {3, 6},   {0, 6},   {0, 3},   {4, 7},
+    {1, 7},   {1, 4},   {11, 14}, {8, 14},  {8, 11},  {12, 15}, {9, 15},
+    {9, 12},  {13, 16}, {10, 16}, {10, 13}, {20, 23}, {17, 23}, {17, 20},
+    {21, 24}, {18, 24}, {18, 21}, {19, 22}, {8, 17},  {9, 18},  {0, 18},
+    {0, 9},   {10, 19}, {1, 19},  {1, 10},  {11, 20}, {2, 20},  {2, 11},
+    {12, 21}, {3, 21},  {3, 12},  {13, 22}, {4, 22},  {4, 13},  {14, 23},
+    {5, 23},  {5, 14},  {15, 24}, {6, 24},  {6, 15},  {7, 16},  {7, 19},
+    {13, 21}, {15, 23}, {7, 13},  {7, 15},  {1, 9},   {3, 11},  {5, 17},
+    {11, 17}, {9, 17},  {4, 10},  {6, 12},  {7, 14},  {4, 6},   {4, 7},
+    {12, 14}, {10, 14}, {6, 7},   {10, 12}, {6, 10},  {6, 17},  {12, 17},
+    {7, 17},  {7, 10},  {12, 18}, {7, 12},  {10, 18}, {12, 20}, {10, 20},
+    {10, 12},
+}};
+
+uint8_t lower(uint8_t a, uint8_t b) { return std::min(a, b); }
+uint8_t upper(uint8_t a, uint8_t b) { return std::max(a, b); }
+#if defined(__SSE2__)
+__m128i lower(__m128i a, __m128i b) { return _mm_min_epu8(a, b); }
+__m128i upper(__m128i a, __m128i b) { return _mm_max_epu8(a, b); }
+#endif
+
+// Runs the network fully unrolled; exchanges whose outputs never reach
+// the median are dropped by the compiler.
+template <const auto& Network, size_t Taps, typename V>
+V selectMedian(V* v)
+{
+    [&]<size_t... I>(std::index_sequence<I...>)
+    {
+        (
+            [&]
+            {
+                constexpr Exchange e = Network[I];
+                const V a = v[e.first], b = v[e.second];
+                v[e.first] = lower(a, b);
+                v[e.second] = upper(a, b);
+            }(),
+            ...);
+    }(std::make_index_sequence<Network.size()>{});
+    return v[Taps / 2];
+}
+
+// acc += plus - minus over one 16-bin histogram segment.
+void slide(uint16_t* acc, const uint16_t* plus, const uint16_t* minus)
+{
+#if defined(__SSE2__)
+    for (size_t b = 0; b < Coarse; b += 8)
+    {
+        auto at = [](const uint16_t* p)
+        { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); };
+        const __m128i v =
+            _mm_sub_epi16(_mm_add_epi16(at(acc + b), at(plus + b)), at(minus + b));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(acc + b), v);
+    }
+#else
+    for (size_t b = 0; b < Coarse; ++b)
+    {
+        acc[b] = static_cast<uint16_t>(acc[b] + plus[b] - minus[b]);
+    }
+#endif
+}
+
+// First of 16 bins whose running total, starting from `below`, exceeds
+// rank; `below` becomes the total before it. Branch-free with SSE2: prefix
+// sums, one compare and a mask count instead of a data-dependent loop.
+size_t findBin(const uint16_t* counts, size_t& below, size_t rank)
+{
+#if defined(__SSE2__)
+    auto prefix = [](__m128i v)
+    {
+        v = _mm_add_epi16(v, _mm_slli_si128(v, 2));
+        v = _mm_add_epi16(v, _mm_slli_si128(v, 4));
+        return _mm_add_epi16(v, _mm_slli_si128(v, 8));
+    };
+    const __m128i base = _mm_set1_epi16(static_cast<short>(below));
+    const __m128i lo = _mm_add_epi16(
+        prefix(_mm_loadu_si128(reinterpret_cast<const __m128i*>(counts))), base);
+    const __m128i last = _mm_shuffle_epi32(
+        _mm_shufflehi_epi16(lo, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+    const __m128i hi = _mm_add_epi16(
+        prefix(_mm_loadu_si128(reinterpret_cast<const __m128i*>(counts + 8))), last);
+
+    // Unsigned a > rank as a signed compare with the sign bits flipped.
+    const __m128i flip = _mm_set1_epi16(static_cast<short>(0x8000));
+    const __m128i limit = _mm_set1_epi16(static_cast<short>(rank ^ 0x8000));
+    const int above =
+        _mm_movemask_epi8(_mm_cmpgt_epi16(_mm_xor_si128(lo, flip), limit)) |
+        _mm_movemask_epi8(_mm_cmpgt_epi16(_mm_xor_si128(hi, flip), limit)) << 16;
+
+    const size_t bin = Coarse - static_cast<size_t>(std::popcount(
+                                    static_cast<unsigned>(above))) / 2;
+    if (bin > 0)
+    {
+        alignas(16) uint16_t totals[Coarse];
+        _mm_store_si128(reinterpret_cast<__m128i*>(totals), lo);
+        _mm_store_si128(reinterpret_cast<__m128i*>(totals + 8), hi);
+        below = totals[bin - 1];
+    }
+    return bin;
+#else
+    size_t bin = 0;
+    while (below + counts[bin] <= rank) below += counts[bin++];
+    return bin;
+#endif
+}
+
+// Radius 1 and 2: K padded source rows per output row, kept in a ring so
+// each is loaded once per row band.
+template <size_t R, const auto& Network>
+void networkMedian(const Image& src, Image& out, const FilterOptions& options)
+{
+    constexpr size_t K = 2 * R + 1;
+    const detail::Layout layout{src.width(), src.height(), src.channels()};
+    const size_t C = layout.Channels;
+    const size_t n = layout.Width * C;
+    const size_t padded = (layout.Width + 2 * R) * C;
+    const uint8_t constant = detail::borderConstant<uint8_t>(options);
+    const uint8_t* in = src.dataAsUint8();
+    uint8_t* dst = out.dataAsUint8();
+
+    parallel_for_rows(
+        src,
+        [&](size_t first, size_t last)
+        {
+            std::vector<uint8_t> ring(K * padded);
+            auto load = [&](std::ptrdiff_t y)
+            {
+                const std::ptrdiff_t sy =
+                    borderIndex(y, layout.Height, options.Border);
+                const size_t slot = static_cast<size_t>(
+                    (y % std::ptrdiff_t(K) + std::ptrdiff_t(K)) % std::ptrdiff_t(K));
+                detail::loadRow(in, sy, layout, -std::ptrdiff_t(R),
+                                layout.Width + 2 * R, options.Border, constant,
+                                ring.data() + slot * padded);
+            };
+
+            const auto top = static_cast<std::ptrdiff_t>(first);
+            for (std::ptrdiff_t y = top - std::ptrdiff_t(R);
+                 y < top + std::ptrdiff_t(R); ++y)
+            {
+                load(y);
+            }
+
+            for (size_t y = first; y < last; ++y)
+            {
+                load(static_cast<std::ptrdiff_t>(y + R));
+
+                // Window tap k = dy * K + dx reads rows[dy] + dx * C.
+                const uint8_t* rows[K];
+                for (size_t dy = 0; dy < K; ++dy)
+                {
+                    rows[dy] = ring.data() + ((y + dy + K - R) % K) * padded;
+                }
+
+                uint8_t* d = dst + y * n;
+                size_t i = 0;
+#if defined(__SSE2__)
+                for (; i + 16 <= n; i += 16)
+                {
+                    __m128i v[K * K];
+                    for (size_t dy = 0; dy < K; ++dy)
+                    {
+                        for (size_t dx = 0; dx < K; ++dx)
+                        {
+                            v[dy * K + dx] = _mm_loadu_si128(
+                                reinterpret_cast<const __m128i*>(rows[dy] + i +
+                                                                 dx * C));
+                        }
+                    }
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(d + i),
+                                     selectMedian<Network, K * K>(v));
+                }
+#endif
+                for (; i < n; ++i)
+                {
+                    uint8_t v[K * K];
+                    for (size_t dy = 0; dy < K; ++dy)
+                    {
+                        for (size_t dx = 0; dx < K; ++dx)
+                        {
+                            v[dy * K + dx] = rows[dy][i + dx * C];
+                        }
+                    }
+                    d[i] = selectMedian<Network, K * K>(v);
+                }
+            }
+        },
+        options.Parallel);
+}
+
+// Perreault-Hebert over output columns [x0, x0 + width): one 256-bin
+// histogram per padded column (and a 16-bin coarse one), updated by one
+// row in and one row out per output row. Each output pixel slides a
+// coarse kernel histogram by a column, finds the coarse bin holding the
+// median and brings only that fine segment up to date, lazily.
+void histogramStripe(const uint8_t* in, const detail::Layout& layout,
+                     uint8_t* dst, size_t x0, size_t width, size_t radius,
+                     const FilterOptions& options)
+{
+    const size_t C = layout.Channels;
+    const size_t K = 2 * radius + 1;
+    const size_t columns = (width + 2 * radius) * C;
+    const size_t rank = K * K / 2;
+    const uint8_t constant = detail::borderConstant<uint8_t>(options);
+    const std::ptrdiff_t left =
+        static_cast<std::ptrdiff_t>(x0) - static_cast<std::ptrdiff_t>(radius);
+
+    std::vector<uint16_t> fine(columns * Bins), coarse(columns * Coarse);
+    std::vector<uint8_t> row(columns);
+
+    auto update = [&](std::ptrdiff_t y, int delta)
+    {
+        const std::ptrdiff_t sy = borderIndex(y, layout.Height, options.Border);
+        detail::loadRow(in, sy, layout, left, width + 2 * radius,
+                        options.Border, constant, row.data());
+        for (size_t e = 0; e < columns; ++e)
+        {
+            const uint8_t v = row[e];
+            fine[e * Bins + v] += static_cast<uint16_t>(delta);
+            coarse[e * Coarse + v / Coarse] += static_cast<uint16_t>(delta);
+        }
+    };
+
+    const auto r = static_cast<std::ptrdiff_t>(radius);
+    for (std::ptrdiff_t y = -r; y <= r; ++y) update(y, 1);
+
+    alignas(16) uint16_t kernelCoarse[Coarse];
+    alignas(16) uint16_t kernelFine[Bins];
+    std::ptrdiff_t current[Coarse];
+
+    for (size_t y = 0; y < layout.Height; ++y)
+    {
+        if (y > 0)
+        {
+            update(static_cast<std::ptrdiff_t>(y) - r - 1, -1);
+            update(static_cast<std::ptrdiff_t>(y) + r, 1);
+        }
+
+        uint8_t* out = dst + (y * layout.Width + x0) * C;
+        for (size_t c = 0; c < C; ++c)
+        {
+            const uint16_t* colCoarse = coarse.data() + c * Coarse;
+            const uint16_t* colFine = fine.data() + c * Bins;
+            const size_t coarseStep = C * Coarse, fineStep = C * Bins;
+
+            std::fill(kernelCoarse, kernelCoarse + Coarse, uint16_t(0));
+            for (size_t p = 0; p < K; ++p)
+            {
+                const uint16_t* h = colCoarse + p * coarseStep;
+                for (size_t b = 0; b < Coarse; ++b) kernelCoarse[b] += h[b];
+            }
+            // Far enough back that every segment is rebuilt on first use.
+            std::fill(current, current + Coarse,
+                      -static_cast<std::ptrdiff_t>(K));
+
+            for (size_t j = 0; j < width; ++j)
+            {
+                if (j > 0)
+                {
+                    slide(kernelCoarse, colCoarse + (j + K - 1) * coarseStep,
+                        colCoarse + (j - 1) * coarseStep);
+                }
+
+                size_t below = 0;
+                const size_t k = findBin(kernelCoarse, below, rank);
+
+                // Refresh fine segment k for window j: slide it column by
+                // column, or rebuild it when that would cost more.
+                uint16_t* seg = kernelFine + k * Coarse;
+                const auto at = static_cast<std::ptrdiff_t>(j);
+                if (2 * (at - current[k]) > static_cast<std::ptrdiff_t>(K))
+                {
+                    std::fill(seg, seg + Coarse, uint16_t(0));
+                    for (size_t p = j; p < j + K; ++p)
+                    {
+                        const uint16_t* h = colFine + p * fineStep + k * Coarse;
+                        for (size_t b = 0; b < Coarse; ++b) seg[b] += h[b];
+                    }
+                }
+                else
+                {
+                    for (auto q = static_cast<size_t>(current[k] + 1); q <= j; ++q)
+                    {
+                        slide(seg, colFine + (q + K - 1) * fineStep + k * Coarse,
+                            colFine + (q - 1) * fineStep + k * Coarse);
+                    }
+                }
+                current[k] = at;
+
+                const size_t b = findBin(seg, below, rank);
+                out[j * C + c] = static_cast<uint8_t>(k * Coarse + b);
+            }
+        }
+    }
+}
+
+void histogramMedian(const Image& src, Image& out, size_t radius,
+                     const FilterOptions& options)
+{
+    const detail::Layout layout{src.width(), src.height(), src.channels()};
+    const size_t perColumn = (Bins + Coarse) * sizeof(uint16_t) * layout.Channels;
+    const size_t fit = StripeCacheBytes / perColumn;
+    const size_t stripe =
+        std::max(MinStripe, fit > 2 * radius ? fit - 2 * radius : 0);
+    const size_t stripes = (layout.Width + stripe - 1) / stripe;
+
+    const uint8_t* in = src.dataAsUint8();
+    uint8_t* dst = out.dataAsUint8();
+
+    ParallelOptions each = options.Parallel;
+    each.Grain = 1;
+    parallel_for(
+        0, stripes,
+        [&](size_t first, size_t last)
+        {
+            for (size_t s = first; s < last; ++s)
+            {
+                const size_t x0 = s * stripe;
+                histogramStripe(in, layout, dst, x0,
+                                std::min(stripe, layout.Width - x0), radius,
+                                options);
+            }
+        },
+        each);
+}
+}  // namespace
+
+void median(const Image& src, Image& dst, size_t radius,
+            const FilterOptions& options)
+{
+    if (src.empty())
+    {
+        throw std::invalid_argument("median: empty image");
+    }
+    if (src.type() == Image::IMAGE_TYPE::IMAGE_F32C1 ||
+        src.type() == Image::IMAGE_TYPE::IMAGE_F32C3)
+    {
+        throw std::invalid_argument("median: expected a U8 image");
+    }
+    if (radius > MaxMedianRadius)
+    {
+        throw std::invalid_argument("median: radius too large");
+    }
+    IPS_PROFILE_SCOPE("median", "filter", src);
+
+    Image scratch;
+    Image& out = (&src == &dst) ? scratch : dst;
+    if (out.width() != src.width() || out.height() != src.height() ||
+        out.type() != src.type() || out.channels() != src.channels())
+    {
+        out = Image(src.width(), src.height(), src.channels(), src.type());
+    }
+
+    switch (radius)
+    {
+        case 0:
+            std::memcpy(out.dataAsUint8(), src.dataAsUint8(), src.dataSize());
+            break;
+        case 1:
+            networkMedian<1, Median9>(src, out, options);
+            break;
+        case 2:
+            networkMedian<2, Median25>(src, out, options);
+            break;
+        default:
+            histogramMedian(src, out, radius, options);
+            break;
+    }
+
+    if (&out == &scratch) dst = std::move(scratch);
+}
+
+Node medianNode(size_t radius, FilterOptions options, std::string name)
+{
+    if (radius > MaxMedianRadius)
+    {
+        throw std::invalid_argument("medianNode: radius too large");
+    }
+
+    auto run = [radius, options](Image& image)
+    {
+        if (image.empty() || image.type() == Image::IMAGE_TYPE::IMAGE_F32C1 ||
+            image.type() == Image::IMAGE_TYPE::IMAGE_F32C3)
+        {
+            return EXECError::EXEC_FAIL;
+        }
+        median(image, image, radius, options);
+        return EXECError::EXEC_SUCCESS;
+    };
+    return Node(nullptr, std::move(run), std::move(name));
+}
+
+}  // namespace ips::filter
@@ -0,0 +1,520 @@
+#include "filter/morphology.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "filter/border.hpp"
+#include "profiler.hpp"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace ips::filter
+{
+
+namespace
+{
+// Working set the running extrema of one column strip should fit in.
+constexpr size_t TileCacheBytes = 256 * 1024;
+constexpr size_t WordBits = 64;
+
+// Elementwise min or max of two rows; plain loops the compiler turns into
+// pminub / minps and friends.
+template <typename T, bool Max>
+struct Extremum
+{
+    static void apply(const T* a, const T* b, T* out, size_t n)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            if constexpr (Max)
+                out[i] = std::max(a[i], b[i]);
+            else
+                out[i] = std::min(a[i], b[i]);
+        }
+    }
+};
+
+// AND (erode) or OR (dilate) of packed mask words.
+template <bool Dilate>
+struct BitOp
+{
+    static void apply(const uint64_t* a, const uint64_t* b, uint64_t* out,
+                      size_t n)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            out[i] = Dilate ? (a[i] | b[i]) : (a[i] & b[i]);
+        }
+    }
+};
+
+// van Herk / Gil-Werman over `count` items of `stride` elements: within
+// blocks of k items, g holds running extrema forwards and h backwards, so
+// the window of k items starting at i is op(h[i], g[i + k - 1]) whatever
+// k is. item(j) returns the j-th input item.
+template <typename Op, typename T, typename Item>
+void runningBlocks(size_t count, size_t k, size_t stride, Item&& item, T* g,
+                   T* h)
+{
+    for (size_t b = 0; b < count; b += k)
+    {
+        const size_t e = std::min(b + k, count);
+
+        std::copy_n(item(b), stride, g + b * stride);
+        for (size_t j = b + 1; j < e; ++j)
+        {
+            Op::apply(g + (j - 1) * stride, item(j), g + j * stride, stride);
+        }
+
+        std::copy_n(item(e - 1), stride, h + (e - 1) * stride);
+        for (size_t j = e - 1; j-- > b;)
+        {
+            Op::apply(h + (j + 1) * stride, item(j), h + j * stride, stride);
+        }
+    }
+}
+
+// Horizontal pass, one padded row at a time. Same recurrence as
+// runningBlocks, written over elements so each block is one tight loop.
+template <typename T, bool Max>
+void rowPass(const Image& src, Image& out, size_t kw, T constant,
+             const FilterOptions& options)
+{
+    using Op = Extremum<T, Max>;
+    const detail::Layout layout{src.width(), src.height(), src.channels()};
+    const size_t C = layout.Channels, w = layout.Width;
+    const size_t count = w + kw - 1;
+    const auto left = -static_cast<std::ptrdiff_t>(kw / 2);
+    const T* in = src.dataAs<T>();
+    T* dst = out.dataAs<T>();
+
+    auto pick = [](T a, T b) { return Max ? std::max(a, b) : std::min(a, b); };
+
+    parallel_for_rows(
+        src,
+        [&](size_t first, size_t last)
+        {
+            std::vector<T> pad(count * C), g(count * C), h(count * C);
+            const T* p = pad.data();
+
+            for (size_t y = first; y < last; ++y)
+            {
+                detail::loadRow(in, static_cast<std::ptrdiff_t>(y), layout,
+                                left, count, options.Border, constant,
+                                pad.data());
+
+                for (size_t b = 0; b < count; b += kw)
+                {
+                    const size_t i0 = b * C;
+                    const size_t i1 = std::min(b + kw, count) * C;
+
+                    // Running values stay in registers, one chain per channel.
+                    for (size_t c = 0; c < C; ++c)
+                    {
+                        T run = p[i0 + c];
+                        for (size_t i = i0 + c; i < i1; i += C)
+                        {
+                            run = pick(run, p[i]);
+                            g[i] = run;
+                        }
+
+                        run = p[i1 - C + c];
+                        for (size_t i = i1 - C + c; i >= i0 + C; i -= C)
+                        {
+                            run = pick(run, p[i]);
+                            h[i] = run;
+                        }
+                        h[i0 + c] = pick(run, p[i0 + c]);
+                    }
+                }
+                Op::apply(h.data(), g.data() + (kw - 1) * C, dst + y * w * C,
+                          w * C);
+            }
+        },
+        options.Parallel);
+}
+
+// Vertical pass. Every step combines whole rows, so it runs SIMD across
+// columns; bands are cut into column strips that keep g and h in cache.
+// rowAt(y) returns row y, which may lie outside [0, height).
+template <typename Op, typename T, typename RowAt>
+void columnPass(size_t rowLength, size_t height, size_t kh, RowAt&& rowAt,
+                T* out, const ParallelOptions& options)
+{
+    const auto top = -static_cast<std::ptrdiff_t>(kh / 2);
+
+    parallel_for(
+        0, height,
+        [&](size_t first, size_t last)
+        {
+            const size_t rows = last - first;
+            const size_t count = rows + kh - 1;
+            const size_t strip = std::clamp<size_t>(
+                TileCacheBytes / (2 * count * sizeof(T)),
+                std::min<size_t>(64, rowLength), rowLength);
+            std::vector<T> g(count * strip), h(count * strip);
+
+            for (size_t x0 = 0; x0 < rowLength; x0 += strip)
+            {
+                const size_t n = std::min(strip, rowLength - x0);
+                auto item = [&](size_t j)
+                {
+                    return rowAt(static_cast<std::ptrdiff_t>(first + j) + top) +
+                           x0;
+                };
+                runningBlocks<Op>(count, kh, n, item, g.data(), h.data());
+
+                for (size_t r = 0; r < rows; ++r)
+                {
+                    Op::apply(h.data() + r * n, g.data() + (r + kh - 1) * n,
+                              out + (first + r) * rowLength + x0, n);
+                }
+            }
+        },
+        options);
+}
+
+template <typename T, bool Max>
+void columnPassImage(const Image& src, Image& out, size_t kh, T constant,
+                     const FilterOptions& options)
+{
+    const size_t n = src.width() * src.channels();
+    const size_t height = src.height();
+    const T* in = src.dataAs<T>();
+    const std::vector<T> constantRow(
+        options.Border == BorderMode::Constant ? n : 0, constant);
+
+    auto rowAt = [&](std::ptrdiff_t y)
+    {
+        const std::ptrdiff_t sy = borderIndex(y, height, options.Border);
+        return sy < 0 ? constantRow.data() : in + static_cast<size_t>(sy) * n;
+    };
+    columnPass<Extremum<T, Max>>(n, height, kh, rowAt, out.dataAs<T>(),
+                                 options.Parallel);
+}
+
+template <typename T, bool Max>
+void extremumFilter(const Image& src, Image& out, size_t kw, size_t kh,
+                    const FilterOptions& options)
+{
+    const T constant = detail::borderConstant<T>(options);
+
+    if (kw > 1 && kh > 1)
+    {
+        Image rows(src.width(), src.height(), src.channels(), src.type());
+        rowPass<T, Max>(src, rows, kw, constant, options);
+        columnPassImage<T, Max>(rows, out, kh, constant, options);
+    }
+    else if (kw > 1)
+    {
+        rowPass<T, Max>(src, out, kw, constant, options);
+    }
+    else if (kh > 1)
+    {
+        columnPassImage<T, Max>(src, out, kh, constant, options);
+    }
+    else
+    {
+        std::memcpy(out.data(), src.data(), src.dataSize());
+    }
+}
+
+bool isBinaryMask(const Image& src)
+{
+    const uint8_t* p = src.dataAsUint8();
+    const size_t n = src.size();
+    size_t i = 0;
+
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ones = _mm_set1_epi8(-1);
+    for (; i + 16 <= n; i += 16)
+    {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        const __m128i ok =
+            _mm_or_si128(_mm_cmpeq_epi8(v, zero), _mm_cmpeq_epi8(v, ones));
+        if (_mm_movemask_epi8(ok) != 0xFFFF) return false;
+    }
+#endif
+
+    for (; i < n; ++i)
+    {
+        if (p[i] != 0 && p[i] != 255) return false;
+    }
+    return true;
+}
+
+// One bit per byte of a 0/255 mask, least significant bit first.
+void packBits(const uint8_t* bytes, size_t words, uint64_t* bits)
+{
+    for (size_t i = 0; i < words; ++i, bytes += WordBits)
+    {
+        uint64_t word = 0;
+#if defined(__SSE2__)
+        for (size_t k = 0; k < 4; ++k)
+        {
+            const __m128i v =
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + 16 * k));
+            word |= uint64_t(uint32_t(_mm_movemask_epi8(v))) << (16 * k);
+        }
+#else
+        for (size_t b = 0; b < WordBits; ++b)
+        {
+            word |= uint64_t(bytes[b] >> 7) << b;
+        }
+#endif
+        bits[i] = word;
+    }
+}
+
+void unpackBits(const uint64_t* bits, size_t count, uint8_t* bytes)
+{
+    // Eight output bytes for every byte of mask bits.
+    static const auto spread = []
+    {
+        std::array<std::array<uint8_t, 8>, 256> table{};
+        for (size_t v = 0; v < 256; ++v)
+        {
+            for (size_t b = 0; b < 8; ++b) table[v][b] = (v >> b & 1) ? 255 : 0;
+        }
+        return table;
+    }();
+
+    for (size_t x = 0; x < count; x += 8)
+    {
+        const auto byte = static_cast<uint8_t>(bits[x / WordBits] >> (x % WordBits));
+        std::memcpy(bytes + x, spread[byte].data(), std::min<size_t>(8, count - x));
+    }
+}
+
+// Bit i of out is bit i + m of in; bits past the end read as `fill`.
+void shiftDown(const uint64_t* in, size_t words, size_t m, uint64_t fill,
+               uint64_t* out)
+{
+    const size_t q = m / WordBits, r = m % WordBits;
+    auto at = [&](size_t i) { return i < words ? in[i] : fill; };
+    for (size_t i = 0; i < words; ++i)
+    {
+        out[i] = r == 0 ? at(i + q)
+                        : (at(i + q) >> r) | (at(i + q + 1) << (WordBits - r));
+    }
+}
+
+// Binary masks: rows are packed 64 pixels to a word with the border
+// already applied, the horizontal window is built by doubling shifted
+// ANDs/ORs (log2(kw) word operations per 64 pixels) and the vertical pass
+// is the same running extrema on words.
+template <bool Dilate>
+void binaryFilter(const Image& src, Image& out, size_t kw, size_t kh,
+                  bool borderBit, const ParallelOptions& options)
+{
+    using Op = BitOp<Dilate>;
+    const size_t w = src.width(), height = src.height();
+    const size_t W = (w + WordBits - 1) / WordBits;
+    const size_t count = w + kw - 1;
+    const size_t words = (count + WordBits - 1) / WordBits;
+    const uint64_t fill = borderBit ? ~uint64_t(0) : 0;
+    const uint8_t* in = src.dataAsUint8();
+
+    std::vector<uint64_t> rows(height * W), result(height * W);
+
+    parallel_for_rows(
+        src,
+        [&](size_t first, size_t last)
+        {
+            std::vector<uint8_t> pad(words * WordBits, borderBit ? 255 : 0);
+            std::vector<uint64_t> s(words), shifted(words);
+
+            for (size_t y = first; y < last; ++y)
+            {
+                std::memcpy(pad.data() + kw / 2, in + y * w, w);
+                packBits(pad.data(), words, s.data());
+
+                size_t span = 1;
+                for (; 2 * span <= kw; span *= 2)
+                {
+                    shiftDown(s.data(), words, span, fill, shifted.data());
+                    Op::apply(s.data(), shifted.data(), s.data(), words);
+                }
+                if (span < kw)
+                {
+                    shiftDown(s.data(), words, kw - span, fill, shifted.data());
+                    Op::apply(s.data(), shifted.data(), s.data(), words);
+                }
+                std::copy_n(s.data(), W, rows.data() + y * W);
+            }
+        },
+        options);
+
+    if (kh > 1)
+    {
+        const std::vector<uint64_t> fillRow(W, fill);
+        auto rowAt = [&](std::ptrdiff_t y)
+        {
+            return y < 0 || y >= static_cast<std::ptrdiff_t>(height)
+                       ? fillRow.data()
+                       : rows.data() + static_cast<size_t>(y) * W;
+        };
+        columnPass<Op>(W, height, kh, rowAt, result.data(), options);
+    }
+    else
+    {
+        result.swap(rows);
+    }
+
+    uint8_t* dst = out.dataAsUint8();
+    parallel_for_rows(
+        src,
+        [&](size_t first, size_t last)
+        {
+            for (size_t y = first; y < last; ++y)
+            {
+                unpackBits(result.data() + y * W, w, dst + y * w);
+            }
+        },
+        options);
+}
+
+// Whether the packed path gives the same result as the general one, and
+// the value of the bits outside the image if so. Replicated and (for
+// centred, odd-sized elements) reflected borders only repeat pixels the
+// window already covers, so they act like the neutral value.
+bool binaryBorder(const Image& src, bool dilate, size_t kw, size_t kh,
+                  const FilterOptions& options, bool& borderBit)
+{
+    if (src.type() != Image::IMAGE_TYPE::IMAGE_U8C1) return false;
+
+    switch (options.Border)
+    {
+        case BorderMode::Constant:
+            if (options.BorderValue != 0.0f && options.BorderValue != 255.0f)
+                return false;
+            borderBit = options.BorderValue == 255.0f;
+            break;
+        case BorderMode::Reflect:
+        case BorderMode::Reflect101:
+            if (kw % 2 == 0 || kh % 2 == 0) return false;
+            borderBit = !dilate;
+            break;
+        case BorderMode::Replicate:
+            borderBit = !dilate;
+            break;
+        case BorderMode::Wrap:
+            return false;
+    }
+    return isBinaryMask(src);
+}
+
+// src and out are distinct images of the same shape and type.
+void basicFilter(const Image& src, Image& out, bool dilate, size_t kw,
+                 size_t kh, const FilterOptions& options)
+{
+    bool borderBit = false;
+    if (binaryBorder(src, dilate, kw, kh, options, borderBit))
+    {
+        if (dilate)
+            binaryFilter<true>(src, out, kw, kh, borderBit, options.Parallel);
+        else
+            binaryFilter<false>(src, out, kw, kh, borderBit, options.Parallel);
+    }
+    else if (Image::isFloat(src.type()))
+    {
+        if (dilate)
+            extremumFilter<float, true>(src, out, kw, kh, options);
+        else
+            extremumFilter<float, false>(src, out, kw, kh, options);
+    }
+    else
+    {
+        if (dilate)
+            extremumFilter<uint8_t, true>(src, out, kw, kh, options);
+        else
+            extremumFilter<uint8_t, false>(src, out, kw, kh, options);
+    }
+}
+
+Image sameShape(const Image& src)
+{
+    return Image(src.width(), src.height(), src.channels(), src.type());
+}
+}  // namespace
+
+void morphology(const Image& src, Image& dst, MorphOp op, size_t width,
+                size_t height, const FilterOptions& options)
+{
+    if (src.empty())
+    {
+        throw std::invalid_argument("morphology: empty image");
+    }
+    if (width == 0 || height == 0)
+    {
+        throw std::invalid_argument("morphology: empty structuring element");
+    }
+    IPS_PROFILE_SCOPE("morphology", "filter", src);
+
+    Image scratch;
+    Image& out = (&src == &dst) ? scratch : dst;
+    if (out.width() != src.width() || out.height() != src.height() ||
+        out.type() != src.type() || out.channels() != src.channels())
+    {
+        out = sameShape(src);
+    }
+
+    switch (op)
+    {
+        case MorphOp::Erode:
+        case MorphOp::Dilate:
+            basicFilter(src, out, op == MorphOp::Dilate, width, height, options);
+            break;
+        case MorphOp::Open:
+        case MorphOp::Close:
+        {
+            const bool dilateFirst = op == MorphOp::Close;
+            Image between = sameShape(src);
+            basicFilter(src, between, dilateFirst, width, height, options);
+            basicFilter(between, out, !dilateFirst, width, height, options);
+            break;
+        }
+    }
+
+    if (&out == &scratch) dst = std::move(scratch);
+}
+
+void erode(const Image& src, Image& dst, size_t width, size_t height,
+           const FilterOptions& options)
+{
+    morphology(src, dst, MorphOp::Erode, width, height, options);
+}
+
+void dilate(const Image& src, Image& dst, size_t width, size_t height,
+            const FilterOptions& options)
+{
+    morphology(src, dst, MorphOp::Dilate, width, height, options);
+}
+
+Node morphologyNode(MorphOp op, size_t width, size_t height,
+                    FilterOptions options, std::string name)
+{
+    if (width == 0 || height == 0)
+    {
+        throw std::invalid_argument("morphologyNode: empty structuring element");
+    }
+
+    auto run = [op, width, height, options](Image& image)
+    {
+        if (image.empty()) return EXECError::EXEC_FAIL;
+        morphology(image, image, op, width, height, options);
+        return EXECError::EXEC_SUCCESS;
+    };
+    return Node(nullptr, std::move(run), std::move(name));
+}
+
+}  // namespace ips::filter
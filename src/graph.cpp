@@ -0,0 +1,300 @@
+#include "graph.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+#include <string>
+
+#include "profiler.hpp"
+
+namespace ips
+{
+
+// Per-frame bookkeeping. Tasks hold a reference so that the final
+// notification never touches a state the caller already released.
+struct Graph::RunState
+{
+    explicit RunState(const Image& frame, size_t count)
+        : Frame(frame), Pending(std::make_unique<std::atomic<size_t>[]>(count)),
+          Remaining(count)
+    {
+    }
+
+    const Image& Frame;
+    std::unique_ptr<std::atomic<size_t>[]> Pending;
+    std::atomic<size_t> Remaining;
+    std::atomic<bool> Failed{false};
+};
+
+Graph::Graph(ThreadPool* pool) : Pool(pool ? pool : &ThreadPool::global()) {}
+
+Graph::NodeId Graph::addNode(Node node, const std::vector<NodeId>& inputs)
+{
+    const NodeId id = Nodes.size();
+    if (node.Name.empty()) node.Name = "node " + std::to_string(id);
+    Nodes.push_back(Entry{std::move(node), {}, {}});
+
+    for (NodeId input : inputs)
+    {
+        connect(input, id);
+    }
+    return id;
+}
+
+void Graph::connect(NodeId from, NodeId to)
+{
+    checkId(from);
+    checkId(to);
+
+    Nodes[to].Inputs.push_back(from);
+    Nodes[from].Outputs.push_back(to);
+    Initialized = false;
+}
+
+void Graph::markOutput(NodeId id)
+{
+    checkId(id);
+
+    Nodes[id].Keep = true;
+    Initialized = false;
+}
+
+EXECError Graph::executeInit(Image& frame)
+{
+    Initialized = false;
+
+    if (!sortNodes()) return EXECError::EXEC_FAIL;
+
+    planBuffers();
+
+    for (NodeId id : Order)
+    {
+        prepare(id, frame);
+
+        if (Nodes[id].Op.executeInit(Buffers[Nodes[id].Slot]) !=
+            EXECError::EXEC_SUCCESS)
+        {
+            return EXECError::EXEC_FAIL;
+        }
+    }
+
+    Initialized = true;
+    return EXECError::EXEC_SUCCESS;
+}
+
+EXECError Graph::executeRun(Image& frame)
+{
+    if (!Initialized) return EXECError::EXEC_FAIL;
+    if (Nodes.empty()) return EXECError::EXEC_SUCCESS;
+
+    IPS_PROFILE_SCOPE("Graph::executeRun", "graph", frame);
+
+    auto state = std::make_shared<RunState>(frame, Nodes.size());
+    for (NodeId id = 0; id < Nodes.size(); ++id)
+    {
+        state->Pending[id].store(Nodes[id].Inputs.size(),
+                                 std::memory_order_relaxed);
+    }
+
+    for (NodeId id = 0; id < Nodes.size(); ++id)
+    {
+        if (Nodes[id].Inputs.empty()) schedule(state, id);
+    }
+
+    // Help the pool while waiting so the calling thread also executes nodes.
+    size_t remaining;
+    while ((remaining = state->Remaining.load(std::memory_order_acquire)) > 0)
+    {
+        if (!Pool->runPendingTask())
+        {
+            state->Remaining.wait(remaining, std::memory_order_acquire);
+        }
+    }
+
+    return state->Failed.load(std::memory_order_relaxed)
+               ? EXECError::EXEC_FAIL
+               : EXECError::EXEC_SUCCESS;
+}
+
+const Image& Graph::output(NodeId id) const
+{
+    checkId(id);
+    if (Nodes[id].Slot >= Buffers.size())
+    {
+        throw std::runtime_error("Graph: buffers are not planned yet");
+    }
+    return Buffers[Nodes[id].Slot];
+}
+
+Image& Graph::output(NodeId id)
+{
+    checkId(id);
+    if (Nodes[id].Slot >= Buffers.size())
+    {
+        throw std::runtime_error("Graph: buffers are not planned yet");
+    }
+    return Buffers[Nodes[id].Slot];
+}
+
+void Graph::checkId(NodeId id) const
+{
+    if (id >= Nodes.size())
+    {
+        throw std::out_of_range("Graph: node id out of range");
+    }
+}
+
+bool Graph::sortNodes()
+{
+    std::vector<size_t> indegree(Nodes.size());
+    std::vector<NodeId> ready;
+
+    for (NodeId id = 0; id < Nodes.size(); ++id)
+    {
+        indegree[id] = Nodes[id].Inputs.size();
+        if (indegree[id] == 0) ready.push_back(id);
+    }
+
+    Order.clear();
+    Order.reserve(Nodes.size());
+
+    while (!ready.empty())
+    {
+        NodeId id = ready.back();
+        ready.pop_back();
+        Order.push_back(id);
+
+        for (NodeId next : Nodes[id].Outputs)
+        {
+            if (--indegree[next] == 0) ready.push_back(next);
+        }
+    }
+
+    return Order.size() == Nodes.size();
+}
+
+void Graph::planBuffers()
+{
+    const size_t count = Nodes.size();
+
+    // ancestors[v][u]: u has finished before v starts in every execution.
+    std::vector<std::vector<bool>> ancestors(count, std::vector<bool>(count));
+    for (NodeId v : Order)
+    {
+        for (NodeId u : Nodes[v].Inputs)
+        {
+            ancestors[v][u] = true;
+            for (NodeId k = 0; k < count; ++k)
+            {
+                if (ancestors[u][k]) ancestors[v][k] = true;
+            }
+        }
+    }
+
+    // The image of `w` is dead once `v` starts if every reader of `w`,
+    // except possibly `v` itself, has finished by then.
+    auto deadAt = [&](NodeId w, NodeId v, bool allowSelf)
+    {
+        if (Nodes[w].Keep || Nodes[w].Outputs.empty()) return false;
+
+        for (NodeId reader : Nodes[w].Outputs)
+        {
+            if (reader == v ? !allowSelf : !ancestors[v][reader]) return false;
+        }
+        return true;
+    };
+
+    std::vector<NodeId> occupant;
+
+    for (NodeId v : Order)
+    {
+        Entry& entry = Nodes[v];
+        entry.InPlace = false;
+
+        if (!entry.Inputs.empty())
+        {
+            const NodeId primary = entry.Inputs.front();
+            const size_t slot = Nodes[primary].Slot;
+            const bool onlyPrimary =
+                std::count(entry.Inputs.begin(), entry.Inputs.end(),
+                           primary) == 1;
+
+            if (onlyPrimary && occupant[slot] == primary &&
+                deadAt(primary, v, true))
+            {
+                entry.Slot = slot;
+                entry.InPlace = true;
+                occupant[slot] = v;
+                continue;
+            }
+        }
+
+        size_t slot = 0;
+        while (slot < occupant.size() && !deadAt(occupant[slot], v, false))
+        {
+            ++slot;
+        }
+
+        if (slot == occupant.size()) occupant.push_back(v);
+
+        entry.Slot = slot;
+        occupant[slot] = v;
+    }
+
+    // Existing images are kept so that their allocations can be reused.
+    Buffers.resize(occupant.size());
+}
+
+void Graph::prepare(NodeId id, const Image& frame)
+{
+    const Entry& entry = Nodes[id];
+    if (entry.InPlace) return;
+
+    Buffers[entry.Slot] =
+        entry.Inputs.empty() ? frame : Buffers[Nodes[entry.Inputs.front()].Slot];
+}
+
+void Graph::schedule(const std::shared_ptr<RunState>& state, NodeId id)
+{
+    Pool->submit([this, state, id] { runNode(state, id); });
+}
+
+void Graph::runNode(const std::shared_ptr<RunState>& shared, NodeId id)
+{
+    RunState& state = *shared;
+    Entry& entry = Nodes[id];
+
+    // Once a node failed the remaining ones are only counted down.
+    if (!state.Failed.load(std::memory_order_relaxed))
+    {
+        try
+        {
+            prepare(id, state.Frame);
+
+            if (entry.Op.executeRun(Buffers[entry.Slot]) !=
+                EXECError::EXEC_SUCCESS)
+            {
+                state.Failed.store(true, std::memory_order_relaxed);
+            }
+        }
+        catch (...)
+        {
+            state.Failed.store(true, std::memory_order_relaxed);
+        }
+    }
+
+    for (NodeId next : entry.Outputs)
+    {
+        if (state.Pending[next].fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            schedule(shared, next);
+        }
+    }
+
+    if (state.Remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        state.Remaining.notify_all();
+    }
+}
+
+}  // namespace ips
@@ -9,13 +9,13 @@ Image::Image()
 }
 
 Image::Image(size_t w, IMAGE_TYPE type)
-    : Width(w), Height(1), Channels(1), m_type(type)
+    : Width(w), Height(1), Channels(channelCount(type)), m_type(type)
 {
     allocateMemory();
 }
 
 Image::Image(size_t w, size_t h, IMAGE_TYPE type)
-    : Width(w), Height(h), Channels(1), m_type(type)
+    : Width(w), Height(h), Channels(channelCount(type)), m_type(type)
 {
     allocateMemory();
 }
@@ -36,6 +36,8 @@ Image::Image(const Image& other)
     switch (m_type)
     {
         case IMAGE_TYPE::IMAGE_U8C1:
+        case IMAGE_TYPE::IMAGE_U8C3:
+        case IMAGE_TYPE::IMAGE_U8C4:
             m_data = other.m_data;
             break;
         case IMAGE_TYPE::IMAGE_F32C1:
@@ -127,6 +129,8 @@ const void* Image::data() const
     switch (m_type)
     {
         case IMAGE_TYPE::IMAGE_U8C1:
+        case IMAGE_TYPE::IMAGE_U8C3:
+        case IMAGE_TYPE::IMAGE_U8C4:
             if (auto* buf = std::get_if<ips::detail::Buffer<uint8_t>>(&m_data))
             {
                 return buf->data();
@@ -148,6 +152,8 @@ void* Image::data()
     switch (m_type)
     {
         case IMAGE_TYPE::IMAGE_U8C1:
+        case IMAGE_TYPE::IMAGE_U8C3:
+        case IMAGE_TYPE::IMAGE_U8C4:
             if (auto* buf = std::get_if<ips::detail::Buffer<uint8_t>>(&m_data))
             {
                 return buf->data();
@@ -166,7 +172,9 @@ void* Image::data()
 
 const uint8_t* Image::dataAsUint8() const
 {
-    if (m_type != IMAGE_TYPE::IMAGE_U8C1) return nullptr;
+    if (m_type != IMAGE_TYPE::IMAGE_U8C1 && m_type != IMAGE_TYPE::IMAGE_U8C3 &&
+        m_type != IMAGE_TYPE::IMAGE_U8C4)
+        return nullptr;
     if (auto* buf = std::get_if<ips::detail::Buffer<uint8_t>>(&m_data))
     {
         return buf->data();
@@ -176,7 +184,9 @@ const uint8_t* Image::dataAsUint8() const
 
 uint8_t* Image::dataAsUint8()
 {
-    if (m_type != IMAGE_TYPE::IMAGE_U8C1) return nullptr;
+    if (m_type != IMAGE_TYPE::IMAGE_U8C1 && m_type != IMAGE_TYPE::IMAGE_U8C3 &&
+        m_type != IMAGE_TYPE::IMAGE_U8C4)
+        return nullptr;
     if (auto* buf = std::get_if<ips::detail::Buffer<uint8_t>>(&m_data))
     {
         return buf->data();
@@ -248,6 +258,8 @@ void Image::zero()
     switch (m_type)
     {
         case IMAGE_TYPE::IMAGE_U8C1:
+        case IMAGE_TYPE::IMAGE_U8C3:
+        case IMAGE_TYPE::IMAGE_U8C4:
             getBuffer<uint8_t>().zero();
             break;
         case IMAGE_TYPE::IMAGE_F32C1:
@@ -280,6 +292,10 @@ Image Image::convert(IMAGE_TYPE newType) const
     {
         newChannels = 1;
     }
+    else
+    {
+        newChannels = channelCount(newType);
+    }
 
     Image result(Width, Height, newChannels, newType);
 
@@ -288,7 +304,7 @@ Image Image::convert(IMAGE_TYPE newType) const
     return result;
 }
 
-static std::optional<Image> createFromFile(const std::string& filename)
+std::optional<Image> Image::createFromFile(const std::string& filename)
 {
     std::filesystem::path filePath(filename);
 
@@ -302,40 +318,56 @@ static std::optional<Image> createFromFile(const std::string& filename)
             return std::nullopt;
         }
 
-        size_t numChannels = 1;
+        IMAGE_TYPE imgType = IMAGE_TYPE::IMAGE_U8C1;
+        bool grayAlpha = false;
 
         switch (decoder.getColor())
         {
             case decode::PNG::Color::PNG_COLOR_GRAYSCALE:
-                numChannels = 1;
-                break;
-            case decode::PNG::Color::PNG_COLOR_GRAYALPHA:
-                numChannels = 2;
+                imgType = IMAGE_TYPE::IMAGE_U8C1;
                 break;
             case decode::PNG::Color::PNG_COLOR_RGB:
-                numChannels = 3;
+            case decode::PNG::Color::PNG_COLOR_INDEXED:
+                imgType = IMAGE_TYPE::IMAGE_U8C3;
                 break;
             case decode::PNG::Color::PNG_COLOR_RGBA:
-                numChannels = 4;
+                imgType = IMAGE_TYPE::IMAGE_U8C4;
                 break;
-            case decode::PNG::Color::PNG_COLOR_INDEXED:
-                numChannels = 3;
+            case decode::PNG::Color::PNG_COLOR_GRAYALPHA:
+                // No two-channel type; expanded to RGBA below.
+                imgType = IMAGE_TYPE::IMAGE_U8C4;
+                grayAlpha = true;
                 break;
             default:
                 return std::nullopt;
         }
 
-        Image img(decoder.width(), decoder.height(), numChannels);
+        Image img(decoder.width(), decoder.height(), imgType);
 
         auto imgBuf = img.dataAsUint8();
         const auto& pngData = decoder.data();
 
-        if (pngData.size() != img.size())
+        if (pngData.size() != (grayAlpha ? img.size() / 2 : img.size()))
         {
             return std::nullopt;
         }
 
-        memcpy(imgBuf, pngData.data(), pngData.size());
+        if (grayAlpha)
+        {
+            const size_t pixels = img.width() * img.height();
+            for (size_t i = 0; i < pixels; ++i)
+            {
+                const uint8_t gray = pngData[2 * i];
+                imgBuf[4 * i + 0] = gray;
+                imgBuf[4 * i + 1] = gray;
+                imgBuf[4 * i + 2] = gray;
+                imgBuf[4 * i + 3] = pngData[2 * i + 1];
+            }
+        }
+        else
+        {
+            memcpy(imgBuf, pngData.data(), pngData.size());
+        }
 
         return img;
     }
@@ -354,6 +386,8 @@ void Image::allocateMemory()
     switch (m_type)
     {
         case IMAGE_TYPE::IMAGE_U8C1:
+        case IMAGE_TYPE::IMAGE_U8C3:
+        case IMAGE_TYPE::IMAGE_U8C4:
             m_data = detail::Buffer<uint8_t>(size());
             break;
         case IMAGE_TYPE::IMAGE_F32C1:
@@ -390,6 +424,8 @@ size_t Image::getTypeSize() const
     switch (m_type)
     {
         case IMAGE_TYPE::IMAGE_U8C1:
+        case IMAGE_TYPE::IMAGE_U8C3:
+        case IMAGE_TYPE::IMAGE_U8C4:
             return sizeof(uint8_t);
         case IMAGE_TYPE::IMAGE_F32C1:
         case IMAGE_TYPE::IMAGE_F32C3:
@@ -431,6 +467,8 @@ void Image::checkType() const
     switch (m_type)
     {
         case IMAGE_TYPE::IMAGE_U8C1:
+        case IMAGE_TYPE::IMAGE_U8C3:
+        case IMAGE_TYPE::IMAGE_U8C4:
             valid = std::is_same_v<T, uint8_t>;
             break;
         case IMAGE_TYPE::IMAGE_F32C1:
@@ -457,6 +495,20 @@ void Image::checkChannel(size_t c, IMAGE_TYPE type) const
                     "Single channel types must have exactly 1 channel");
             }
             break;
+        case IMAGE_TYPE::IMAGE_U8C3:
+            if (c != 3)
+            {
+                throw std::invalid_argument(
+                    "U8C3 type must have exactly 3 channels");
+            }
+            break;
+        case IMAGE_TYPE::IMAGE_U8C4:
+            if (c != 4)
+            {
+                throw std::invalid_argument(
+                    "U8C4 type must have exactly 4 channels");
+            }
+            break;
         case IMAGE_TYPE::IMAGE_F32C3:
             if (c != 3)
             {
@@ -467,6 +519,27 @@ void Image::checkChannel(size_t c, IMAGE_TYPE type) const
     }
 }
 
+size_t Image::channelCount(IMAGE_TYPE type)
+{
+    switch (type)
+    {
+        case IMAGE_TYPE::IMAGE_U8C1:
+        case IMAGE_TYPE::IMAGE_F32C1:
+            return 1;
+        case IMAGE_TYPE::IMAGE_U8C3:
+        case IMAGE_TYPE::IMAGE_F32C3:
+            return 3;
+        case IMAGE_TYPE::IMAGE_U8C4:
+            return 4;
+    }
+    throw std::runtime_error("Unknown image type");
+}
+
+bool Image::isFloat(IMAGE_TYPE type)
+{
+    return type == IMAGE_TYPE::IMAGE_F32C1 || type == IMAGE_TYPE::IMAGE_F32C3;
+}
+
 void Image::convertHelper(const Image& src, Image& dst)
 {
     if (src.m_type == dst.m_type && src.Channels == dst.Channels)
@@ -478,4 +551,17 @@ void Image::convertHelper(const Image& src, Image& dst)
     throw std::runtime_error("Image type conversion not yet implemented");
 }
 
+template const uint8_t& Image::at<uint8_t>(size_t, size_t, size_t) const;
+template uint8_t& Image::at<uint8_t>(size_t, size_t, size_t);
+template const float& Image::at<float>(size_t, size_t, size_t) const;
+template float& Image::at<float>(size_t, size_t, size_t);
+
+template const uint8_t* Image::dataAs<uint8_t>() const;
+template uint8_t* Image::dataAs<uint8_t>();
+template const float* Image::dataAs<float>() const;
+template float* Image::dataAs<float>();
+
+template void Image::fill<uint8_t>(const uint8_t&);
+template void Image::fill<float>(const float&);
+
 }  // namespace ips
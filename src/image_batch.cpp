@@ -0,0 +1,90 @@
+#include "image_batch.hpp"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace ips
+{
+
+ImageBatch::ImageBatch(size_t count, size_t w, size_t h,
+                       Image::IMAGE_TYPE type)
+    : Count(count), Storage(w, h * count, type)
+{
+}
+
+ImageBatch ImageBatch::pack(std::span<const Image> images)
+{
+    if (images.empty()) return ImageBatch();
+
+    const Image& first = images.front();
+    ImageBatch batch(images.size(), first.width(), first.height(),
+                     first.type());
+
+    for (size_t i = 0; i < images.size(); ++i)
+    {
+        batch.copyFrom(i, images[i]);
+    }
+    return batch;
+}
+
+void ImageBatch::unpack(std::span<Image> images) const
+{
+    if (images.size() != Count)
+    {
+        throw std::invalid_argument("ImageBatch::unpack: count mismatch");
+    }
+
+    for (size_t i = 0; i < Count; ++i)
+    {
+        copyTo(i, images[i]);
+    }
+}
+
+void ImageBatch::copyFrom(size_t index, const Image& image)
+{
+    checkIndex(index);
+    checkShape(image);
+
+    std::memcpy(static_cast<uint8_t*>(Storage.data()) + index * entryBytes(),
+                image.data(), entryBytes());
+}
+
+void ImageBatch::copyTo(size_t index, Image& image) const
+{
+    checkIndex(index);
+
+    if (image.width() != width() || image.height() != height() ||
+        image.type() != type())
+    {
+        image = Image(width(), height(), channels(), type());
+    }
+
+    std::memcpy(image.data(),
+                static_cast<const uint8_t*>(Storage.data()) +
+                    index * entryBytes(),
+                entryBytes());
+}
+
+void ImageBatch::checkIndex(size_t index) const
+{
+    if (index >= Count)
+    {
+        throw std::out_of_range("ImageBatch: index out of bounds");
+    }
+}
+
+void ImageBatch::checkShape(const Image& image) const
+{
+    if (image.width() != width() || image.height() != height() ||
+        image.type() != type() || image.channels() != channels())
+    {
+        throw std::invalid_argument("ImageBatch: image shape mismatch");
+    }
+}
+
+size_t ImageBatch::entryBytes() const
+{
+    return Count ? Storage.dataSize() / Count : 0;
+}
+
+}  // namespace ips
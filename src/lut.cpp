@@ -0,0 +1,174 @@
+#include "lut.hpp"
+
+#include <cstring>
+#include <stdexcept>
+
+#include "profiler.hpp"
+
+namespace ips
+{
+
+namespace
+{
+// Eight lookups per 64-bit load and store. Without SSSE3 there is no byte
+// shuffle to look up in, and a 256-entry pshufb lookup takes 16 shuffles
+// and selects per vector anyway; the gather keeps both load ports busy.
+void lookup(const uint8_t* in, uint8_t* out, size_t n, const uint8_t* table)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        uint64_t v;
+        std::memcpy(&v, in + i, 8);
+        uint64_t r = 0;
+        for (int b = 0; b < 64; b += 8)
+        {
+            r |= uint64_t(table[(v >> b) & 0xFF]) << b;
+        }
+        std::memcpy(out + i, &r, 8);
+    }
+    for (; i < n; ++i) out[i] = table[in[i]];
+}
+
+// value / 255 raised to 1 / gamma, back on 0..255.
+double gammaCurve(double value, float gamma)
+{
+    return 255.0 * std::pow(value / 255.0, 1.0 / gamma);
+}
+}  // namespace
+
+LookupTable::LookupTable()
+{
+    for (int v = 0; v < 256; ++v) Table[v] = static_cast<uint8_t>(v);
+}
+
+LookupTable::LookupTable(const std::array<uint8_t, 256>& table) : Table(table)
+{
+}
+
+LookupTable LookupTable::then(const LookupTable& next) const
+{
+    std::array<uint8_t, 256> table;
+    for (int v = 0; v < 256; ++v) table[v] = next.Table[Table[v]];
+    return LookupTable(table);
+}
+
+bool LookupTable::isIdentity() const noexcept
+{
+    for (int v = 0; v < 256; ++v)
+    {
+        if (Table[v] != v) return false;
+    }
+    return true;
+}
+
+void LookupTable::apply(const Image& src, Image& dst,
+                        const ParallelOptions& options) const
+{
+    if (src.empty())
+    {
+        throw std::invalid_argument("LookupTable::apply: empty image");
+    }
+    if (src.type() == Image::IMAGE_TYPE::IMAGE_F32C1 ||
+        src.type() == Image::IMAGE_TYPE::IMAGE_F32C3)
+    {
+        throw std::invalid_argument("LookupTable::apply: expected a U8 image");
+    }
+    IPS_PROFILE_SCOPE("lut", "point", src);
+
+    if (&src != &dst &&
+        (dst.width() != src.width() || dst.height() != src.height() ||
+         dst.type() != src.type() || dst.channels() != src.channels()))
+    {
+        dst = Image(src.width(), src.height(), src.channels(), src.type());
+    }
+
+    const uint8_t* in = src.dataAsUint8();
+    uint8_t* out = dst.dataAsUint8();
+    const size_t n = src.width() * src.channels();
+
+    // The identity still has to copy, but needs no lookups.
+    if (isIdentity())
+    {
+        if (in != out) std::memcpy(out, in, src.dataSize());
+        return;
+    }
+
+    parallel_for_rows(
+        src,
+        [&](size_t first, size_t last)
+        {
+            // A local copy: the stores could alias the member table.
+            const std::array<uint8_t, 256> table = Table;
+            lookup(in + first * n, out + first * n, (last - first) * n,
+                   table.data());
+        },
+        options);
+}
+
+Node LookupTable::toNode(std::string name) const
+{
+    auto run = [lut = *this](Image& image)
+    {
+        if (image.empty() || image.type() == Image::IMAGE_TYPE::IMAGE_F32C1 ||
+            image.type() == Image::IMAGE_TYPE::IMAGE_F32C3)
+        {
+            return EXECError::EXEC_FAIL;
+        }
+        lut.apply(image, image);
+        return EXECError::EXEC_SUCCESS;
+    };
+    return Node(nullptr, std::move(run), std::move(name));
+}
+
+namespace lut
+{
+LookupTable gamma(float gamma)
+{
+    if (!(gamma > 0.0f))
+    {
+        throw std::invalid_argument("lut::gamma: gamma must be positive");
+    }
+    return LookupTable::fromFunction([gamma](uint8_t v)
+                                     { return gammaCurve(v, gamma); });
+}
+
+LookupTable contrast(float gain, float pivot)
+{
+    return LookupTable::fromFunction([gain, pivot](uint8_t v)
+                                     { return (v - pivot) * gain + pivot; });
+}
+
+LookupTable threshold(uint8_t level, uint8_t low, uint8_t high)
+{
+    return LookupTable::fromFunction([=](uint8_t v)
+                                     { return v > level ? high : low; });
+}
+
+LookupTable invert()
+{
+    return LookupTable::fromFunction([](uint8_t v) { return 255 - v; });
+}
+
+LookupTable levels(uint8_t inLow, uint8_t inHigh, uint8_t outLow,
+                   uint8_t outHigh, float gamma)
+{
+    if (inLow >= inHigh)
+    {
+        throw std::invalid_argument("lut::levels: empty input range");
+    }
+    if (!(gamma > 0.0f))
+    {
+        throw std::invalid_argument("lut::levels: gamma must be positive");
+    }
+    return LookupTable::fromFunction(
+        [=](uint8_t v)
+        {
+            const double t = std::clamp(
+                double(v - inLow) / double(inHigh - inLow), 0.0, 1.0);
+            return outLow + (outHigh - outLow) * gammaCurve(255.0 * t, gamma) / 255.0;
+        });
+}
+}  // namespace lut
+
+}  // namespace ips
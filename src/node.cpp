@@ -1,11 +1,30 @@
 #include "node.hpp"
 
+#include <vector>
+
+#include "profiler.hpp"
+
 namespace ips
 {
 
+namespace
+{
+EXECError runEach(const std::function<EXECError(Image&)>& run,
+                  std::span<Image> images)
+{
+    if (!run) return EXECError::EXEC_SUCCESS;
+
+    for (auto& image : images)
+    {
+        if (run(image) != EXECError::EXEC_SUCCESS) return EXECError::EXEC_FAIL;
+    }
+    return EXECError::EXEC_SUCCESS;
+}
+}  // namespace
+
 Node::Node(std::function<EXECError(Image&)> initFunc,
-           std::function<EXECError(Image&)> runFunc)
-    : Init(initFunc), Run(runFunc)
+           std::function<EXECError(Image&)> runFunc, std::string name)
+    : Init(initFunc), Run(runFunc), Name(std::move(name))
 {
 }
 
@@ -15,8 +34,16 @@ void Node::setFunctions(std::function<EXECError(Image&)> initFunc, std::function
     Run = runFunc;
 }
 
+void Node::setCache(std::shared_ptr<ResultCache> cache,
+                    std::function<uint64_t()> paramHash)
+{
+    Cache = std::move(cache);
+    ParamHash = std::move(paramHash);
+}
+
 EXECError Node::executeInit(Image& image)
 {
+    IPS_PROFILE_SCOPE(Name, "init", image);
     EXECError status = EXECError::EXEC_SUCCESS;
     if (Init)
         status = Init(image);
@@ -25,10 +52,52 @@ EXECError Node::executeInit(Image& image)
 
 EXECError Node::executeRun(Image& image)
 {
-    EXECError status = EXECError::EXEC_SUCCESS;
-    if (Run)
-        status = Run(image);
+    IPS_PROFILE_SCOPE(Name, "run", image);
+    if (!Run) return EXECError::EXEC_SUCCESS;
+    if (!Cache || !ParamHash) return Run(image);
+
+    const uint64_t key = hashCombine(hashImage(image),
+                                     hashCombine(hashParams(Name), ParamHash()));
+    if (Cache->lookup(key, image)) return EXECError::EXEC_SUCCESS;
+
+    EXECError status = Run(image);
+    if (status == EXECError::EXEC_SUCCESS) Cache->insert(key, image);
     return status;
 }
 
+EXECError Node::executeRun(std::span<Image> images)
+{
+    IPS_PROFILE_SCOPE(Name, "run_batch",
+                      images.empty() ? nullptr : &images.front());
+    if (RunBatch) return RunBatch(images);
+    return runEach(Run, images);
+}
+
+EXECError Node::executeRun(ImageBatch& batch)
+{
+    IPS_PROFILE_SCOPE(Name, "run_packed", batch.storage());
+    if (RunPacked) return RunPacked(batch);
+    if (!Run && !RunBatch) return EXECError::EXEC_SUCCESS;
+
+    // Falls back to the per-image entry points through scratch images,
+    // which must keep the batch shape to be packed back.
+    std::vector<Image> images(batch.count());
+    batch.unpack(images);
+
+    EXECError status = RunBatch ? RunBatch(images) : runEach(Run, images);
+    if (status != EXECError::EXEC_SUCCESS) return status;
+
+    for (size_t i = 0; i < images.size(); ++i)
+    {
+        if (images[i].width() != batch.width() ||
+            images[i].height() != batch.height() ||
+            images[i].type() != batch.type())
+        {
+            return EXECError::EXEC_FAIL;
+        }
+        batch.copyFrom(i, images[i]);
+    }
+    return EXECError::EXEC_SUCCESS;
+}
+
 }  // namespace ips
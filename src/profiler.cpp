@@ -0,0 +1,261 @@
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <utility>
+
+namespace ips
+{
+
+namespace
+{
+void writeEscaped(std::ostream& out, const std::string& text)
+{
+    for (char ch : text)
+    {
+        switch (ch)
+        {
+            case '"':
+                out << "\\\"";
+                break;
+            case '\\':
+                out << "\\\\";
+                break;
+            case '\n':
+                out << "\\n";
+                break;
+            case '\t':
+                out << "\\t";
+                break;
+            default:
+                if (static_cast<unsigned char>(ch) < 0x20)
+                {
+                    char buf[8];
+                    std::snprintf(buf, sizeof(buf), "\\u%04x", ch);
+                    out << buf;
+                }
+                else
+                {
+                    out << ch;
+                }
+        }
+    }
+}
+
+uint64_t percentile(const std::vector<uint64_t>& sorted, double p)
+{
+    if (sorted.empty()) return 0;
+    const auto rank = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(rank, sorted.size() - 1)];
+}
+
+void sampleImage(const Image* image, size_t& w, size_t& h, size_t& c,
+                 size_t& bytes)
+{
+    if (!image) return;
+    w = image->width();
+    h = image->height();
+    c = image->channels();
+    bytes = image->dataSize();
+}
+}  // namespace
+
+Profiler::Profiler() : Epoch(std::chrono::steady_clock::now()) {}
+
+Profiler& Profiler::instance()
+{
+    static Profiler profiler;
+    return profiler;
+}
+
+void Profiler::record(ProfileEvent event)
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    Events.push_back(std::move(event));
+}
+
+void Profiler::clear()
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    Events.clear();
+}
+
+std::vector<ProfileEvent> Profiler::events() const
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    return Events;
+}
+
+void Profiler::writeChromeTrace(std::ostream& out) const
+{
+    const auto snapshot = events();
+
+    // Microsecond timestamps with nanosecond resolution.
+    const auto flags = out.flags();
+    const auto precision = out.precision();
+    out << std::fixed << std::setprecision(3);
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    for (size_t i = 0; i < snapshot.size(); ++i)
+    {
+        const ProfileEvent& e = snapshot[i];
+
+        out << (i ? ",\n" : "\n") << "{\"name\":\"";
+        writeEscaped(out, e.Name);
+        out << "\",\"cat\":\"";
+        writeEscaped(out, e.Category);
+        out << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << e.Thread
+            << ",\"ts\":" << static_cast<double>(e.Start) / 1000.0
+            << ",\"dur\":" << static_cast<double>(e.Wall) / 1000.0
+            << ",\"args\":{\"cpu_us\":" << static_cast<double>(e.Cpu) / 1000.0
+            << ",\"in\":\"" << e.InWidth << "x" << e.InHeight << "x"
+            << e.InChannels << "\",\"in_bytes\":" << e.InBytes
+            << ",\"out\":\"" << e.OutWidth << "x" << e.OutHeight << "x"
+            << e.OutChannels << "\",\"out_bytes\":" << e.OutBytes << "}}";
+    }
+    out << "\n]}\n";
+
+    out.flags(flags);
+    out.precision(precision);
+}
+
+bool Profiler::writeChromeTrace(const std::string& path) const
+{
+    std::ofstream file(path, std::ios::out | std::ios::trunc);
+    if (!file.is_open()) return false;
+
+    writeChromeTrace(file);
+    return static_cast<bool>(file);
+}
+
+std::vector<ProfileSummary> Profiler::summary() const
+{
+    const auto snapshot = events();
+
+    std::map<std::pair<std::string, std::string>, std::vector<const ProfileEvent*>>
+        groups;
+    for (const auto& e : snapshot)
+    {
+        groups[{e.Name, e.Category}].push_back(&e);
+    }
+
+    std::vector<ProfileSummary> result;
+    for (auto& [key, list] : groups)
+    {
+        ProfileSummary s;
+        s.Name = key.first;
+        s.Category = key.second;
+        s.Count = list.size();
+
+        std::vector<uint64_t> walls;
+        walls.reserve(list.size());
+        for (const auto* e : list)
+        {
+            walls.push_back(e->Wall);
+            s.Total += e->Wall;
+            s.TotalCpu += e->Cpu;
+        }
+        std::sort(walls.begin(), walls.end());
+
+        s.Mean = s.Total / s.Count;
+        s.P50 = percentile(walls, 0.50);
+        s.P99 = percentile(walls, 0.99);
+        s.Max = walls.back();
+        result.push_back(std::move(s));
+    }
+
+    std::sort(result.begin(), result.end(),
+              [](const ProfileSummary& a, const ProfileSummary& b)
+              { return a.Total > b.Total; });
+    return result;
+}
+
+std::string Profiler::summaryTable() const
+{
+    std::ostringstream out;
+    char line[256];
+
+    std::snprintf(line, sizeof(line), "%-32s %-8s %8s %12s %12s %12s %12s %12s\n",
+                  "name", "category", "count", "total ms", "p50 us", "p99 us",
+                  "max us", "cpu ms");
+    out << line;
+
+    for (const auto& s : summary())
+    {
+        std::snprintf(line, sizeof(line),
+                      "%-32.32s %-8.8s %8zu %12.3f %12.1f %12.1f %12.1f %12.3f\n",
+                      s.Name.c_str(), s.Category.c_str(), s.Count,
+                      static_cast<double>(s.Total) / 1e6,
+                      static_cast<double>(s.P50) / 1e3,
+                      static_cast<double>(s.P99) / 1e3,
+                      static_cast<double>(s.Max) / 1e3,
+                      static_cast<double>(s.TotalCpu) / 1e6);
+        out << line;
+    }
+    return out.str();
+}
+
+uint64_t Profiler::now() const noexcept
+{
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - Epoch)
+            .count());
+}
+
+uint32_t Profiler::threadId()
+{
+    static std::atomic<uint32_t> next{1};
+    thread_local uint32_t id = next.fetch_add(1, std::memory_order_relaxed);
+    return id;
+}
+
+uint64_t Profiler::threadCpuTime() noexcept
+{
+#if defined(CLOCK_THREAD_CPUTIME_ID)
+    timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0)
+    {
+        return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull +
+               static_cast<uint64_t>(ts.tv_nsec);
+    }
+#endif
+    return 0;
+}
+
+ProfileScope::ProfileScope(const std::string& name, const char* category,
+                           const Image* image)
+    : Target(image), Active(Profiler::instance().enabled())
+{
+    if (!Active) return;
+
+    Event.Name = name;
+    Event.Category = category;
+    Event.Thread = Profiler::threadId();
+    sampleImage(image, Event.InWidth, Event.InHeight, Event.InChannels,
+                Event.InBytes);
+
+    CpuStart = Profiler::threadCpuTime();
+    Event.Start = Profiler::instance().now();
+}
+
+ProfileScope::~ProfileScope()
+{
+    if (!Active) return;
+
+    Profiler& profiler = Profiler::instance();
+    Event.Wall = profiler.now() - Event.Start;
+    Event.Cpu = Profiler::threadCpuTime() - CpuStart;
+    sampleImage(Target, Event.OutWidth, Event.OutHeight, Event.OutChannels,
+                Event.OutBytes);
+
+    profiler.record(std::move(Event));
+}
+
+}  // namespace ips
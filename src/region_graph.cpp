@@ -0,0 +1,283 @@
+#include "region_graph.hpp"
+
+#include <cstring>
+#include <stdexcept>
+#include <tuple>
+
+#include "parallel.hpp"
+#include "profiler.hpp"
+
+namespace ips
+{
+
+namespace
+{
+size_t pixelBytes(const Image& image)
+{
+    const size_t pixels = image.width() * image.height();
+    return pixels ? image.dataSize() / pixels : 0;
+}
+
+// Copies the w x h block at (sx, sy) of src to (dx, dy) of dst; both images
+// must have the same pixel format.
+void copyBlock(const Image& src, size_t sx, size_t sy, Image& dst, size_t dx,
+               size_t dy, size_t w, size_t h)
+{
+    const size_t bpp = pixelBytes(src);
+    const size_t srcStride = src.width() * bpp;
+    const size_t dstStride = dst.width() * bpp;
+    const auto* s = static_cast<const uint8_t*>(src.data()) + sy * srcStride +
+                    sx * bpp;
+    auto* d = static_cast<uint8_t*>(dst.data()) + dy * dstStride + dx * bpp;
+
+    for (size_t y = 0; y < h; ++y)
+    {
+        std::memcpy(d + y * dstStride, s + y * srcStride, w * bpp);
+    }
+}
+
+bool sameFormat(const Image& a, const Image& b)
+{
+    return a.type() == b.type() && a.channels() == b.channels();
+}
+}  // namespace
+
+RegionNode::RegionNode(RunFn run, std::string name)
+    : Run(std::move(run)), Name(std::move(name))
+{
+}
+
+RegionNode RegionNode::fromNode(Node node, size_t halo)
+{
+    RegionNode region;
+    region.Name = node.Name;
+    region.InputRegion = [halo](const Rect& out) { return out.expand(halo); };
+    region.Run = [node = std::move(node)](const Image& in, const Rect& inRect,
+                                          Image& out,
+                                          const Rect& outRect) mutable
+    {
+        Image scratch = in;
+        if (node.executeRun(scratch) != EXECError::EXEC_SUCCESS ||
+            scratch.width() != in.width() || scratch.height() != in.height())
+        {
+            return EXECError::EXEC_FAIL;
+        }
+
+        out = Image(outRect.Width, outRect.Height, scratch.channels(),
+                    scratch.type());
+        copyBlock(scratch, static_cast<size_t>(outRect.X - inRect.X),
+                  static_cast<size_t>(outRect.Y - inRect.Y), out, 0, 0,
+                  outRect.Width, outRect.Height);
+        return EXECError::EXEC_SUCCESS;
+    };
+    return region;
+}
+
+LazyGraph::LazyGraph(size_t tileSize, size_t cacheBytes, ThreadPool* pool)
+    : TileSize(std::max<size_t>(1, tileSize)), Tiles(cacheBytes), Pool(pool)
+{
+    Nodes.emplace_back();
+}
+
+size_t LazyGraph::setSource(size_t width, size_t height, Source source)
+{
+    Nodes[0].Read = std::move(source);
+    Nodes[0].Width = width;
+    Nodes[0].Height = height;
+    invalidate(0);
+
+    // Downstream sizes follow the source.
+    for (size_t id = 1; id < Nodes.size(); ++id)
+    {
+        Entry& entry = Nodes[id];
+        const Entry& input = Nodes[entry.Input];
+        std::tie(entry.Width, entry.Height) =
+            entry.Op.OutputSize ? entry.Op.OutputSize(input.Width, input.Height)
+                                : std::pair(input.Width, input.Height);
+    }
+    return 0;
+}
+
+size_t LazyGraph::addNode(RegionNode node, size_t input)
+{
+    if (input >= Nodes.size())
+    {
+        throw std::out_of_range("LazyGraph: node id out of range");
+    }
+
+    Entry entry;
+    entry.Input = input;
+    std::tie(entry.Width, entry.Height) =
+        node.OutputSize
+            ? node.OutputSize(Nodes[input].Width, Nodes[input].Height)
+            : std::pair(Nodes[input].Width, Nodes[input].Height);
+    if (!node.InputRegion)
+    {
+        node.InputRegion = [](const Rect& out) { return out; };
+    }
+    if (node.Name.empty()) node.Name = "node " + std::to_string(Nodes.size());
+    entry.Op = std::move(node);
+
+    Nodes.push_back(std::move(entry));
+    return Nodes.size() - 1;
+}
+
+size_t LazyGraph::width(size_t id) const
+{
+    if (id >= Nodes.size())
+    {
+        throw std::out_of_range("LazyGraph: node id out of range");
+    }
+    return Nodes[id].Width;
+}
+
+size_t LazyGraph::height(size_t id) const
+{
+    if (id >= Nodes.size())
+    {
+        throw std::out_of_range("LazyGraph: node id out of range");
+    }
+    return Nodes[id].Height;
+}
+
+void LazyGraph::invalidate(size_t id)
+{
+    if (id >= Nodes.size())
+    {
+        throw std::out_of_range("LazyGraph: node id out of range");
+    }
+
+    // Inputs always have smaller ids, so one forward pass reaches every
+    // downstream node. Bumping the generation changes the tile keys; the
+    // stale tiles age out of the LRU.
+    std::vector<bool> stale(Nodes.size(), false);
+    stale[id] = true;
+    ++Nodes[id].Generation;
+    for (size_t i = id + 1; i < Nodes.size(); ++i)
+    {
+        if (stale[Nodes[i].Input])
+        {
+            stale[i] = true;
+            ++Nodes[i].Generation;
+        }
+    }
+}
+
+EXECError LazyGraph::request(size_t id, const Rect& region, Image& out)
+{
+    if (id >= Nodes.size()) return EXECError::EXEC_FAIL;
+
+    const Entry& entry = Nodes[id];
+    const Rect area = region.clip(entry.Width, entry.Height);
+    if (area.empty()) return EXECError::EXEC_FAIL;
+
+    IPS_PROFILE_SCOPE("LazyGraph::request", "lazy", nullptr);
+
+    const size_t tx0 = static_cast<size_t>(area.X) / TileSize;
+    const size_t ty0 = static_cast<size_t>(area.Y) / TileSize;
+    const size_t tx1 = (static_cast<size_t>(area.right()) - 1) / TileSize;
+    const size_t ty1 = (static_cast<size_t>(area.bottom()) - 1) / TileSize;
+    const size_t columns = tx1 - tx0 + 1;
+    const size_t count = columns * (ty1 - ty0 + 1);
+
+    std::vector<Image> tiles(count);
+    std::atomic<bool> failed{false};
+
+    ParallelOptions options;
+    options.Pool = Pool;
+    options.Grain = 1;
+    parallel_for(
+        0, count,
+        [&](size_t first, size_t last)
+        {
+            for (size_t i = first; i < last; ++i)
+            {
+                if (tile(id, tx0 + i % columns, ty0 + i / columns, tiles[i]) !=
+                    EXECError::EXEC_SUCCESS)
+                {
+                    failed.store(true, std::memory_order_relaxed);
+                }
+            }
+        },
+        options);
+
+    if (failed.load(std::memory_order_relaxed)) return EXECError::EXEC_FAIL;
+
+    for (const auto& t : tiles)
+    {
+        if (!sameFormat(t, tiles.front())) return EXECError::EXEC_FAIL;
+    }
+
+    out = Image(area.Width, area.Height, tiles.front().channels(),
+                tiles.front().type());
+    for (size_t i = 0; i < count; ++i)
+    {
+        const Rect bounds{
+            static_cast<std::ptrdiff_t>((tx0 + i % columns) * TileSize),
+            static_cast<std::ptrdiff_t>((ty0 + i / columns) * TileSize),
+            tiles[i].width(), tiles[i].height()};
+
+        const std::ptrdiff_t x0 = std::max(bounds.X, area.X);
+        const std::ptrdiff_t y0 = std::max(bounds.Y, area.Y);
+        const std::ptrdiff_t x1 = std::min(bounds.right(), area.right());
+        const std::ptrdiff_t y1 = std::min(bounds.bottom(), area.bottom());
+
+        copyBlock(tiles[i], static_cast<size_t>(x0 - bounds.X),
+                  static_cast<size_t>(y0 - bounds.Y), out,
+                  static_cast<size_t>(x0 - area.X),
+                  static_cast<size_t>(y0 - area.Y),
+                  static_cast<size_t>(x1 - x0), static_cast<size_t>(y1 - y0));
+    }
+    return EXECError::EXEC_SUCCESS;
+}
+
+EXECError LazyGraph::tile(size_t id, size_t tx, size_t ty, Image& out)
+{
+    const Entry& entry = Nodes[id];
+    const uint64_t key = hashParams(id, entry.Generation, tx, ty);
+    if (Tiles.lookup(key, out)) return EXECError::EXEC_SUCCESS;
+
+    const Rect bounds = Rect{static_cast<std::ptrdiff_t>(tx * TileSize),
+                             static_cast<std::ptrdiff_t>(ty * TileSize),
+                             TileSize, TileSize}
+                            .clip(entry.Width, entry.Height);
+
+    if (id == 0)
+    {
+        if (!entry.Read) return EXECError::EXEC_FAIL;
+
+        auto pixels = entry.Read(bounds);
+        if (!pixels || pixels->width() != bounds.Width ||
+            pixels->height() != bounds.Height)
+        {
+            return EXECError::EXEC_FAIL;
+        }
+        out = std::move(*pixels);
+    }
+    else
+    {
+        const Entry& input = Nodes[entry.Input];
+        const Rect needed =
+            entry.Op.InputRegion(bounds).clip(input.Width, input.Height);
+
+        Image in;
+        if (request(entry.Input, needed, in) != EXECError::EXEC_SUCCESS)
+        {
+            return EXECError::EXEC_FAIL;
+        }
+
+        IPS_PROFILE_SCOPE(entry.Op.Name, "lazy_tile", in);
+        if (!entry.Op.Run ||
+            entry.Op.Run(in, needed, out, bounds) != EXECError::EXEC_SUCCESS ||
+            out.width() != bounds.Width || out.height() != bounds.Height)
+        {
+            return EXECError::EXEC_FAIL;
+        }
+    }
+
+    Computed.fetch_add(1, std::memory_order_relaxed);
+    Tiles.insert(key, out);
+    return EXECError::EXEC_SUCCESS;
+}
+
+}  // namespace ips
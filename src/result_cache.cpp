@@ -0,0 +1,234 @@
+#include "result_cache.hpp"
+
+#include <cstring>
+
+namespace ips
+{
+
+namespace
+{
+constexpr uint64_t Prime1 = 0x9e3779b185ebca87ull;
+constexpr uint64_t Prime2 = 0xc2b2ae3d27d4eb4full;
+constexpr uint64_t Prime3 = 0x165667b19e3779f9ull;
+constexpr uint64_t Prime4 = 0x85ebca77c2b2ae63ull;
+constexpr uint64_t Prime5 = 0x27d4eb2f165667c5ull;
+
+inline uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+inline uint64_t load64(const uint8_t* p)
+{
+    uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint32_t load32(const uint8_t* p)
+{
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint64_t round(uint64_t acc, uint64_t input)
+{
+    acc += input * Prime2;
+    acc = rotl(acc, 31);
+    return acc * Prime1;
+}
+
+inline uint64_t mergeRound(uint64_t acc, uint64_t value)
+{
+    acc ^= round(0, value);
+    return acc * Prime1 + Prime4;
+}
+}  // namespace
+
+uint64_t hashBytes(const void* data, size_t size, uint64_t seed) noexcept
+{
+    const auto* p = static_cast<const uint8_t*>(data);
+    const uint8_t* const end = p + size;
+    uint64_t h;
+
+    if (size >= 32)
+    {
+        // Four independent lanes keep several multiplies in flight.
+        uint64_t v1 = seed + Prime1 + Prime2;
+        uint64_t v2 = seed + Prime2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - Prime1;
+
+        const uint8_t* const limit = end - 32;
+        do
+        {
+            v1 = round(v1, load64(p));
+            v2 = round(v2, load64(p + 8));
+            v3 = round(v3, load64(p + 16));
+            v4 = round(v4, load64(p + 24));
+            p += 32;
+        } while (p <= limit);
+
+        h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        h = mergeRound(h, v1);
+        h = mergeRound(h, v2);
+        h = mergeRound(h, v3);
+        h = mergeRound(h, v4);
+    }
+    else
+    {
+        h = seed + Prime5;
+    }
+
+    h += static_cast<uint64_t>(size);
+
+    for (; p + 8 <= end; p += 8)
+    {
+        h ^= round(0, load64(p));
+        h = rotl(h, 27) * Prime1 + Prime4;
+    }
+    if (p + 4 <= end)
+    {
+        h ^= static_cast<uint64_t>(load32(p)) * Prime1;
+        h = rotl(h, 23) * Prime2 + Prime3;
+        p += 4;
+    }
+    for (; p < end; ++p)
+    {
+        h ^= static_cast<uint64_t>(*p) * Prime5;
+        h = rotl(h, 11) * Prime1;
+    }
+
+    h ^= h >> 33;
+    h *= Prime2;
+    h ^= h >> 29;
+    h *= Prime3;
+    h ^= h >> 32;
+    return h;
+}
+
+uint64_t hashImage(const Image& image) noexcept
+{
+    const uint64_t shape[4] = {image.width(), image.height(), image.channels(),
+                               static_cast<uint64_t>(image.type())};
+    const uint64_t seed = hashBytes(shape, sizeof(shape));
+
+    if (image.dataSize() == 0) return seed;
+    return hashBytes(image.data(), image.dataSize(), seed);
+}
+
+ResultCache::ResultCache(size_t byteBudget) : Budget(byteBudget) {}
+
+bool ResultCache::lookup(uint64_t key, Image& out)
+{
+    std::shared_ptr<const Image> result;
+    {
+        std::lock_guard<std::mutex> lock(Mutex);
+        auto it = Index.find(key);
+        if (it == Index.end())
+        {
+            ++Misses;
+            return false;
+        }
+
+        ++Hits;
+        Entries.splice(Entries.begin(), Entries, it->second);
+        result = it->second->Result;
+    }
+
+    // The copy happens outside the lock; the entry stays alive through the
+    // shared pointer even if it is evicted meanwhile.
+    out = *result;
+    return true;
+}
+
+void ResultCache::insert(uint64_t key, const Image& image)
+{
+    const size_t size = image.dataSize();
+    if (size > Budget) return;
+
+    auto result = std::make_shared<const Image>(image);
+
+    std::lock_guard<std::mutex> lock(Mutex);
+    auto it = Index.find(key);
+    if (it != Index.end())
+    {
+        Bytes -= it->second->Result->dataSize();
+        it->second->Result = std::move(result);
+        Entries.splice(Entries.begin(), Entries, it->second);
+    }
+    else
+    {
+        Entries.push_front(Entry{key, std::move(result)});
+        Index.emplace(key, Entries.begin());
+    }
+    Bytes += size;
+    evict();
+}
+
+void ResultCache::erase(uint64_t key)
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    auto it = Index.find(key);
+    if (it == Index.end()) return;
+
+    Bytes -= it->second->Result->dataSize();
+    Entries.erase(it->second);
+    Index.erase(it);
+}
+
+void ResultCache::clear()
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    Entries.clear();
+    Index.clear();
+    Bytes = 0;
+}
+
+void ResultCache::setBudget(size_t byteBudget)
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    Budget = byteBudget;
+    evict();
+}
+
+size_t ResultCache::budget() const
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    return Budget;
+}
+
+size_t ResultCache::bytes() const
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    return Bytes;
+}
+
+size_t ResultCache::size() const
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    return Entries.size();
+}
+
+size_t ResultCache::hits() const
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    return Hits;
+}
+
+size_t ResultCache::misses() const
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    return Misses;
+}
+
+void ResultCache::evict()
+{
+    while (Bytes > Budget && !Entries.empty())
+    {
+        const Entry& last = Entries.back();
+        Bytes -= last.Result->dataSize();
+        Index.erase(last.Key);
+        Entries.pop_back();
+    }
+}
+
+}  // namespace ips
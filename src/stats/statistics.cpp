@@ -0,0 +1,487 @@
+#include "stats/statistics.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+#include "profiler.hpp"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace ips::stats
+{
+
+namespace
+{
+// Fewest pixels worth handing to a thread.
+constexpr size_t MinGrainPixels = size_t(1) << 16;
+// Sub-histograms per channel; consecutive samples of one channel go to
+// different tables so runs of equal values do not serialize on one bin.
+constexpr size_t SubHistograms = 4;
+// Pixels counted into 32-bit tables before they are flushed.
+constexpr size_t FlushPixels = size_t(1) << 30;
+// Samples per lane block of the reduction; a multiple of 1, 3 and 4 so
+// every lane always sees the same channel.
+constexpr size_t LaneBlock = 48;
+
+void checkImage(const Image& src, const char* what)
+{
+    if (src.empty())
+    {
+        throw std::invalid_argument(std::string(what) + ": empty image");
+    }
+}
+
+// Splits the pixels of src into chunks, runs fn(partial, first, last) on
+// each with its own partial, and returns the partials in pixel order so
+// merging them is deterministic whatever thread ran which chunk.
+template <typename Partial, typename Fn>
+std::vector<Partial> reduceChunks(const Image& src, const Partial& init,
+                                  const ParallelOptions& options, Fn&& fn)
+{
+    const size_t pixels = src.width() * src.height();
+    ThreadPool& pool = detail::poolOf(options);
+
+    size_t grain = options.Grain > 0
+                       ? options.Grain * src.width()
+                       : std::max(MinGrainPixels,
+                                  detail::grainFor(pixels, 0, pool));
+    grain = std::min(grain, pixels);
+
+    std::vector<Partial> partials((pixels + grain - 1) / grain, init);
+
+    ParallelOptions chunked = options;
+    chunked.Grain = grain;
+    parallel_for(
+        0, pixels,
+        [&](size_t first, size_t last)
+        { fn(partials[first / grain], first, last); },
+        chunked);
+    return partials;
+}
+
+template <size_t C>
+void countU8(const uint8_t* p, size_t pixels, uint64_t* out)
+{
+    std::array<uint32_t, SubHistograms * C * 256> tables;
+
+    for (size_t done = 0; done < pixels;)
+    {
+        const size_t n = std::min(FlushPixels, pixels - done);
+        tables.fill(0);
+
+        size_t i = 0;
+        for (; i + SubHistograms <= n; i += SubHistograms)
+        {
+            for (size_t k = 0; k < SubHistograms; ++k)
+            {
+                for (size_t c = 0; c < C; ++c)
+                {
+                    ++tables[(k * C + c) * 256 + p[(i + k) * C + c]];
+                }
+            }
+        }
+        for (; i < n; ++i)
+        {
+            for (size_t c = 0; c < C; ++c) ++tables[c * 256 + p[i * C + c]];
+        }
+
+        for (size_t c = 0; c < C; ++c)
+        {
+            for (size_t v = 0; v < 256; ++v)
+            {
+                uint64_t sum = 0;
+                for (size_t k = 0; k < SubHistograms; ++k)
+                {
+                    sum += tables[(k * C + c) * 256 + v];
+                }
+                out[c * 256 + v] += sum;
+            }
+        }
+
+        p += n * C;
+        done += n;
+    }
+}
+
+struct Binning
+{
+    float Low, Scale;
+    size_t Bins;
+
+    size_t operator()(float v) const
+    {
+        const float t = (v - Low) * Scale;
+        if (!(t > 0.0f)) return 0;
+        if (!(t < float(Bins))) return Bins - 1;
+        return std::min(static_cast<size_t>(t), Bins - 1);
+    }
+};
+
+template <size_t C>
+void countF32(const float* p, size_t pixels, const Binning& bin,
+              uint64_t* out)
+{
+    const size_t bins = bin.Bins;
+    // Large bin counts would push the tables out of cache; use one then.
+    const size_t K = bins * C <= 4096 ? SubHistograms : 1;
+    std::vector<uint32_t> tables(K * C * bins);
+
+    for (size_t done = 0; done < pixels;)
+    {
+        const size_t n = std::min(FlushPixels, pixels - done);
+        std::fill(tables.begin(), tables.end(), 0);
+
+        size_t i = 0;
+        for (; i + K <= n; i += K)
+        {
+            for (size_t k = 0; k < K; ++k)
+            {
+                for (size_t c = 0; c < C; ++c)
+                {
+                    ++tables[(k * C + c) * bins + bin(p[(i + k) * C + c])];
+                }
+            }
+        }
+        for (; i < n; ++i)
+        {
+            for (size_t c = 0; c < C; ++c)
+            {
+                ++tables[c * bins + bin(p[i * C + c])];
+            }
+        }
+
+        for (size_t k = 0; k < K; ++k)
+        {
+            for (size_t j = 0; j < C * bins; ++j)
+            {
+                out[j] += tables[k * C * bins + j];
+            }
+        }
+
+        p += n * C;
+        done += n;
+    }
+}
+
+template <typename Count>
+void dispatchChannels(size_t C, Count&& count)
+{
+    switch (C)
+    {
+        case 1:
+            count.template operator()<1>();
+            break;
+        case 3:
+            count.template operator()<3>();
+            break;
+        case 4:
+            count.template operator()<4>();
+            break;
+        default:
+            throw std::invalid_argument("stats: unsupported channel count");
+    }
+}
+
+using Partial = std::vector<ChannelStats>;
+
+void foldLane(ChannelStats& s, double mn, double mx, double sum, double sq)
+{
+    s.Min = std::min(s.Min, mn);
+    s.Max = std::max(s.Max, mx);
+    s.Sum += sum;
+    s.SumSq += sq;
+}
+
+// n samples starting at a pixel boundary, so sample i has channel i % C.
+void reduceU8(const uint8_t* p, size_t n, size_t C, Partial& out)
+{
+    size_t i = 0;
+
+#if defined(__SSE2__)
+    // Lane-wise accumulators over runs of at most 256 blocks: 16-bit sums
+    // and 32-bit sums of squares cannot overflow in that many.
+    const size_t vectorized = LaneBlock % C == 0 ? n : 0;
+    const __m128i zero = _mm_setzero_si128();
+    while (vectorized - i >= LaneBlock)
+    {
+        const size_t blocks =
+            std::min<size_t>((vectorized - i) / LaneBlock, 256);
+
+        __m128i mn[3], mx[3], sum[3][2], sq[3][4];
+        for (size_t k = 0; k < 3; ++k)
+        {
+            mn[k] = _mm_set1_epi8(-1);
+            mx[k] = zero;
+            sum[k][0] = sum[k][1] = zero;
+            sq[k][0] = sq[k][1] = sq[k][2] = sq[k][3] = zero;
+        }
+
+        for (size_t b = 0; b < blocks; ++b, i += LaneBlock)
+        {
+            for (size_t k = 0; k < 3; ++k)
+            {
+                const __m128i v = _mm_loadu_si128(
+                    reinterpret_cast<const __m128i*>(p + i + k * 16));
+                mn[k] = _mm_min_epu8(mn[k], v);
+                mx[k] = _mm_max_epu8(mx[k], v);
+
+                const __m128i lo = _mm_unpacklo_epi8(v, zero);
+                const __m128i hi = _mm_unpackhi_epi8(v, zero);
+                sum[k][0] = _mm_add_epi16(sum[k][0], lo);
+                sum[k][1] = _mm_add_epi16(sum[k][1], hi);
+
+                const __m128i lo2 = _mm_mullo_epi16(lo, lo);
+                const __m128i hi2 = _mm_mullo_epi16(hi, hi);
+                sq[k][0] = _mm_add_epi32(sq[k][0], _mm_unpacklo_epi16(lo2, zero));
+                sq[k][1] = _mm_add_epi32(sq[k][1], _mm_unpackhi_epi16(lo2, zero));
+                sq[k][2] = _mm_add_epi32(sq[k][2], _mm_unpacklo_epi16(hi2, zero));
+                sq[k][3] = _mm_add_epi32(sq[k][3], _mm_unpackhi_epi16(hi2, zero));
+            }
+        }
+
+        alignas(16) uint8_t mnLane[LaneBlock], mxLane[LaneBlock];
+        alignas(16) uint16_t sumLane[LaneBlock];
+        alignas(16) uint32_t sqLane[LaneBlock];
+        for (size_t k = 0; k < 3; ++k)
+        {
+            _mm_store_si128(reinterpret_cast<__m128i*>(mnLane + k * 16), mn[k]);
+            _mm_store_si128(reinterpret_cast<__m128i*>(mxLane + k * 16), mx[k]);
+            for (size_t h = 0; h < 2; ++h)
+            {
+                _mm_store_si128(
+                    reinterpret_cast<__m128i*>(sumLane + k * 16 + h * 8),
+                    sum[k][h]);
+            }
+            for (size_t q = 0; q < 4; ++q)
+            {
+                _mm_store_si128(
+                    reinterpret_cast<__m128i*>(sqLane + k * 16 + q * 4),
+                    sq[k][q]);
+            }
+        }
+        for (size_t j = 0; j < LaneBlock; ++j)
+        {
+            foldLane(out[j % C], mnLane[j], mxLane[j], sumLane[j], sqLane[j]);
+        }
+    }
+#endif
+
+    for (; i < n; ++i)
+    {
+        const double v = p[i];
+        foldLane(out[i % C], v, v, v, v * v);
+    }
+}
+
+void reduceF32(const float* p, size_t n, size_t C, Partial& out)
+{
+    size_t i = 0;
+
+    // Fixed-width lane arrays the compiler keeps in vector registers; float
+    // lanes are flushed to double every run to bound rounding error.
+    const size_t vectorized = LaneBlock % C == 0 ? n : 0;
+    while (vectorized - i >= LaneBlock)
+    {
+        const size_t blocks =
+            std::min<size_t>((vectorized - i) / LaneBlock, 64);
+
+        float mn[LaneBlock], mx[LaneBlock], sum[LaneBlock], sq[LaneBlock];
+        for (size_t j = 0; j < LaneBlock; ++j)
+        {
+            mn[j] = mx[j] = p[i + j];
+            sum[j] = sq[j] = 0.0f;
+        }
+
+        for (size_t b = 0; b < blocks; ++b, i += LaneBlock)
+        {
+            const float* s = p + i;
+            for (size_t j = 0; j < LaneBlock; ++j)
+            {
+                const float v = s[j];
+                mn[j] = std::min(mn[j], v);
+                mx[j] = std::max(mx[j], v);
+                sum[j] += v;
+                sq[j] += v * v;
+            }
+        }
+
+        for (size_t j = 0; j < LaneBlock; ++j)
+        {
+            foldLane(out[j % C], mn[j], mx[j], sum[j], sq[j]);
+        }
+    }
+
+    for (; i < n; ++i)
+    {
+        const double v = p[i];
+        foldLane(out[i % C], v, v, v, v * v);
+    }
+}
+}  // namespace
+
+float Histogram::percentile(double p) const
+{
+    const double ps[] = {p};
+    return percentiles(ps).front();
+}
+
+std::vector<float> Histogram::percentiles(std::span<const double> ps) const
+{
+    std::vector<float> values;
+    values.reserve(ps.size());
+
+    size_t bin = 0;
+    uint64_t below = 0;  // samples in bins before `bin`
+    for (double p : ps)
+    {
+        if (Total == 0 || Bins.empty())
+        {
+            values.push_back(Low);
+            continue;
+        }
+
+        const double clamped = std::clamp(p, 0.0, 100.0);
+        const auto rank = std::max<uint64_t>(
+            1, static_cast<uint64_t>(std::ceil(clamped / 100.0 * double(Total))));
+        while (bin + 1 < Bins.size() && below + Bins[bin] < rank)
+        {
+            below += Bins[bin];
+            ++bin;
+        }
+        values.push_back(Low + float(bin) * BinWidth);
+    }
+    return values;
+}
+
+double ChannelStats::mean() const
+{
+    return Count ? Sum / double(Count) : 0.0;
+}
+
+double ChannelStats::variance() const
+{
+    if (Count == 0) return 0.0;
+    const double m = mean();
+    return std::max(0.0, SumSq / double(Count) - m * m);
+}
+
+double ChannelStats::stddev() const
+{
+    return std::sqrt(variance());
+}
+
+ChannelStats& ChannelStats::merge(const ChannelStats& other)
+{
+    Min = std::min(Min, other.Min);
+    Max = std::max(Max, other.Max);
+    Sum += other.Sum;
+    SumSq += other.SumSq;
+    Count += other.Count;
+    return *this;
+}
+
+std::vector<ChannelStats> statistics(const Image& src,
+                                     const ParallelOptions& options)
+{
+    checkImage(src, "statistics");
+    IPS_PROFILE_SCOPE("statistics", "stats", src);
+
+    const size_t C = src.channels();
+    const bool floating = Image::isFloat(src.type());
+
+    auto partials = reduceChunks(
+        src, Partial(C), options,
+        [&](Partial& partial, size_t first, size_t last)
+        {
+            const size_t n = (last - first) * C;
+            if (floating)
+                reduceF32(src.dataAsFloat() + first * C, n, C, partial);
+            else
+                reduceU8(src.dataAsUint8() + first * C, n, C, partial);
+            for (ChannelStats& s : partial) s.Count += last - first;
+        });
+
+    Partial result(C);
+    for (const Partial& partial : partials)
+    {
+        for (size_t c = 0; c < C; ++c) result[c].merge(partial[c]);
+    }
+    return result;
+}
+
+std::vector<Histogram> histogram(const Image& src,
+                                 const HistogramOptions& options)
+{
+    checkImage(src, "histogram");
+    IPS_PROFILE_SCOPE("histogram", "stats", src);
+
+    const size_t C = src.channels();
+    const bool floating = Image::isFloat(src.type());
+
+    Binning bin{0.0f, 1.0f, 256};
+    if (floating)
+    {
+        if (options.Bins == 0)
+        {
+            throw std::invalid_argument("histogram: bin count is zero");
+        }
+
+        float low = options.Low, high = options.High;
+        if (low == high)
+        {
+            low = std::numeric_limits<float>::infinity();
+            high = -low;
+            for (const ChannelStats& s : statistics(src, options.Parallel))
+            {
+                low = std::min(low, float(s.Min));
+                high = std::max(high, float(s.Max));
+            }
+            if (low == high) high = low + 1.0f;
+        }
+        if (!(low < high))
+        {
+            throw std::invalid_argument("histogram: empty range");
+        }
+        bin = Binning{low, float(options.Bins) / (high - low), options.Bins};
+    }
+
+    const size_t bins = bin.Bins;
+    auto partials = reduceChunks(
+        src, std::vector<uint64_t>(C * bins), options.Parallel,
+        [&](std::vector<uint64_t>& partial, size_t first, size_t last)
+        {
+            dispatchChannels(
+                C,
+                [&]<size_t N>()
+                {
+                    if (floating)
+                        countF32<N>(src.dataAsFloat() + first * N, last - first,
+                                    bin, partial.data());
+                    else
+                        countU8<N>(src.dataAsUint8() + first * N, last - first,
+                                   partial.data());
+                });
+        });
+
+    std::vector<Histogram> result(C);
+    for (size_t c = 0; c < C; ++c)
+    {
+        Histogram& h = result[c];
+        h.Low = bin.Low;
+        h.BinWidth = 1.0f / bin.Scale;
+        h.Bins.assign(bins, 0);
+        for (const auto& partial : partials)
+        {
+            for (size_t i = 0; i < bins; ++i) h.Bins[i] += partial[c * bins + i];
+        }
+        h.Total = src.width() * src.height();
+    }
+    return result;
+}
+
+}  // namespace ips::stats
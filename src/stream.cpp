@@ -0,0 +1,303 @@
+#include "stream.hpp"
+
+#include <chrono>
+#include <map>
+#include <thread>
+
+#include "bounded_queue.hpp"
+#include "profiler.hpp"
+
+namespace ips
+{
+
+namespace
+{
+struct Packet
+{
+    size_t Sequence = 0;
+    Image Frame;
+};
+
+// Spins briefly, then yields, then sleeps, so that idle stages do not burn
+// a core while a slow neighbour works on a frame.
+class Backoff
+{
+   public:
+    void wait()
+    {
+        if (Count < 64)
+        {
+            ++Count;
+        }
+        else if (Count < 128)
+        {
+            ++Count;
+            std::this_thread::yield();
+        }
+        else
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    }
+
+   private:
+    unsigned Count = 0;
+};
+}  // namespace
+
+struct StreamRunner::Channel
+{
+    Channel(size_t capacity, size_t producers)
+        : Queue(capacity), Producers(producers)
+    {
+    }
+
+    detail::BoundedQueue<Packet> Queue;
+    std::atomic<size_t> Producers;
+    std::atomic<bool> Closed{false};
+
+    std::atomic<size_t> Pushed{0};
+    std::atomic<size_t> DepthSum{0};
+    std::atomic<size_t> MaxDepth{0};
+    std::atomic<size_t> Stalls{0};
+
+    // Returns false if the packet was dropped because the run failed.
+    bool push(Packet& packet, const std::atomic<bool>& failed)
+    {
+        Backoff backoff;
+        bool stalled = false;
+        while (!Queue.tryPush(packet))
+        {
+            if (failed.load(std::memory_order_relaxed)) return false;
+            if (!stalled)
+            {
+                Stalls.fetch_add(1, std::memory_order_relaxed);
+                stalled = true;
+            }
+            backoff.wait();
+        }
+
+        const size_t depth = Queue.size();
+        Pushed.fetch_add(1, std::memory_order_relaxed);
+        DepthSum.fetch_add(depth, std::memory_order_relaxed);
+
+        size_t seen = MaxDepth.load(std::memory_order_relaxed);
+        while (depth > seen &&
+               !MaxDepth.compare_exchange_weak(seen, depth,
+                                               std::memory_order_relaxed))
+        {
+        }
+        return true;
+    }
+
+    // Returns false once all producers are done and the queue is drained.
+    bool pop(Packet& packet)
+    {
+        Backoff backoff;
+        while (!Queue.tryPop(packet))
+        {
+            if (Closed.load(std::memory_order_acquire))
+            {
+                return Queue.tryPop(packet);
+            }
+            backoff.wait();
+        }
+        return true;
+    }
+
+    void finishProducer()
+    {
+        if (Producers.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            Closed.store(true, std::memory_order_release);
+        }
+    }
+};
+
+StreamRunner::StreamRunner(size_t queueCapacity) : Capacity(queueCapacity) {}
+
+StreamRunner::~StreamRunner() = default;
+
+void StreamRunner::setSource(Source source) { Input = std::move(source); }
+
+void StreamRunner::addStage(Node node, size_t threads)
+{
+    Stages.push_back(Stage{std::move(node), std::max<size_t>(1, threads)});
+}
+
+void StreamRunner::setSink(Sink sink) { Output = std::move(sink); }
+
+EXECError StreamRunner::run()
+{
+    if (!Input) return EXECError::EXEC_FAIL;
+
+    Failed.store(false);
+
+    // Channel i feeds stage i; the last one feeds the sink. They are only
+    // replaced here, so the run itself reads them without the lock.
+    {
+        std::lock_guard lock(ChannelsMutex);
+        Channels.clear();
+        Processed.clear();
+        for (size_t i = 0; i <= Stages.size(); ++i)
+        {
+            const size_t producers = i == 0 ? 1 : Stages[i - 1].Threads;
+            Channels.push_back(std::make_unique<Channel>(Capacity, producers));
+            Processed.push_back(std::make_unique<std::atomic<size_t>>(0));
+        }
+    }
+
+    std::vector<std::thread> threads;
+    threads.emplace_back([this] { runSource(*Channels.front()); });
+
+    for (size_t i = 0; i < Stages.size(); ++i)
+    {
+        for (size_t t = 0; t < Stages[i].Threads; ++t)
+        {
+            threads.emplace_back(
+                [this, i]
+                {
+                    runStage(Stages[i], *Channels[i], *Channels[i + 1],
+                             *Processed[i]);
+                });
+        }
+    }
+
+    runSink(*Channels.back(), *Processed.back());
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    Stopping.store(false);
+    return Failed.load() ? EXECError::EXEC_FAIL : EXECError::EXEC_SUCCESS;
+}
+
+void StreamRunner::requestStop() noexcept
+{
+    Stopping.store(true, std::memory_order_relaxed);
+}
+
+std::vector<StreamRunner::StageMetrics> StreamRunner::metrics() const
+{
+    std::lock_guard lock(ChannelsMutex);
+    std::vector<StageMetrics> result;
+    for (size_t i = 0; i < Channels.size(); ++i)
+    {
+        const Channel& channel = *Channels[i];
+
+        StageMetrics m;
+        m.Threads = i < Stages.size() ? Stages[i].Threads : 1;
+        m.QueueCapacity = channel.Queue.capacity();
+        m.QueueDepth = channel.Queue.size();
+        m.MaxQueueDepth = channel.MaxDepth.load(std::memory_order_relaxed);
+        const size_t pushed = channel.Pushed.load(std::memory_order_relaxed);
+        m.MeanQueueDepth =
+            pushed ? static_cast<double>(channel.DepthSum.load(
+                         std::memory_order_relaxed)) /
+                         static_cast<double>(pushed)
+                   : 0.0;
+        m.Frames = Processed[i]->load(std::memory_order_relaxed);
+        m.Stalls = channel.Stalls.load(std::memory_order_relaxed);
+        result.push_back(m);
+    }
+    return result;
+}
+
+void StreamRunner::runSource(Channel& out)
+{
+    size_t sequence = 0;
+    while (!Stopping.load(std::memory_order_relaxed) &&
+           !Failed.load(std::memory_order_relaxed))
+    {
+        std::optional<Image> frame;
+        try
+        {
+            IPS_PROFILE_SCOPE("StreamRunner::source", "source", nullptr);
+            frame = Input();
+        }
+        catch (...)
+        {
+            Failed.store(true);
+            break;
+        }
+
+        if (!frame) break;
+
+        Packet packet{sequence++, std::move(*frame)};
+        if (!out.push(packet, Failed)) break;
+    }
+    out.finishProducer();
+}
+
+void StreamRunner::runStage(Stage& stage, Channel& in, Channel& out,
+                            std::atomic<size_t>& processed)
+{
+    Packet packet;
+    while (in.pop(packet))
+    {
+        // After a failure upstream queues are only drained.
+        if (Failed.load(std::memory_order_relaxed)) continue;
+
+        EXECError status = EXECError::EXEC_FAIL;
+        try
+        {
+            status = stage.Op.executeRun(packet.Frame);
+        }
+        catch (...)
+        {
+        }
+
+        if (status != EXECError::EXEC_SUCCESS)
+        {
+            Failed.store(true);
+            continue;
+        }
+
+        processed.fetch_add(1, std::memory_order_relaxed);
+        out.push(packet, Failed);
+    }
+    out.finishProducer();
+}
+
+void StreamRunner::runSink(Channel& in, std::atomic<size_t>& processed)
+{
+    // Frames from multi-threaded stages can arrive out of order; hold them
+    // back until their predecessors have been delivered.
+    std::map<size_t, Image> pending;
+    size_t next = 0;
+
+    Packet packet;
+    while (in.pop(packet))
+    {
+        if (Failed.load(std::memory_order_relaxed)) continue;
+
+        pending.emplace(packet.Sequence, std::move(packet.Frame));
+
+        for (auto it = pending.begin();
+             it != pending.end() && it->first == next;
+             it = pending.erase(it), ++next)
+        {
+            EXECError status = EXECError::EXEC_SUCCESS;
+            try
+            {
+                IPS_PROFILE_SCOPE("StreamRunner::sink", "sink", it->second);
+                if (Output) status = Output(it->second);
+            }
+            catch (...)
+            {
+                status = EXECError::EXEC_FAIL;
+            }
+
+            if (status != EXECError::EXEC_SUCCESS)
+            {
+                Failed.store(true);
+                break;
+            }
+            processed.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+}
+
+}  // namespace ips
@@ -0,0 +1,247 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+#include <string>
+
+namespace ips
+{
+
+namespace
+{
+thread_local ThreadPool* CurrentPool = nullptr;
+thread_local size_t CurrentWorker = 0;
+
+struct ParallelJob
+{
+    const std::function<void(size_t)>* Fn = nullptr;
+    size_t Count = 0;
+    std::stop_token Stop;
+
+    std::atomic<size_t> Next{0};
+    std::atomic<size_t> Done{0};
+    std::atomic<bool> Skipped{false};
+
+    std::mutex ErrorMutex;
+    std::exception_ptr Error;
+
+    // Claims indices until none are left; returns how many were processed.
+    void drain()
+    {
+        size_t processed = 0;
+        size_t i;
+        while ((i = Next.fetch_add(1, std::memory_order_relaxed)) < Count)
+        {
+            if (Stop.stop_requested())
+            {
+                Skipped.store(true, std::memory_order_relaxed);
+            }
+            else
+            {
+                try
+                {
+                    (*Fn)(i);
+                }
+                catch (...)
+                {
+                    std::lock_guard<std::mutex> lock(ErrorMutex);
+                    if (!Error) Error = std::current_exception();
+                }
+            }
+            ++processed;
+        }
+
+        if (processed > 0 &&
+            Done.fetch_add(processed, std::memory_order_acq_rel) + processed ==
+                Count)
+        {
+            Done.notify_all();
+        }
+    }
+};
+}  // namespace
+
+ThreadPool::ThreadPool(size_t threads)
+{
+    if (threads == 0)
+    {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    Queues.reserve(threads + 1);
+    for (size_t i = 0; i < threads + 1; ++i)
+    {
+        Queues.push_back(std::make_unique<TaskQueue>());
+    }
+
+    Workers.reserve(threads);
+    for (size_t i = 0; i < threads; ++i)
+    {
+        Workers.emplace_back([this, i] { workerLoop(i); });
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(SleepMutex);
+        Stopping = true;
+    }
+    Ready.notify_all();
+
+    for (auto& worker : Workers)
+    {
+        worker.join();
+    }
+}
+
+void ThreadPool::submit(std::function<void()> task)
+{
+    const size_t target =
+        CurrentPool == this ? CurrentWorker : Queues.size() - 1;
+    // Counted before it is visible so that a thief cannot drive the count
+    // below zero.
+    Pending.fetch_add(1, std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> lock(Queues[target]->Mutex);
+        Queues[target]->Tasks.push_back(std::move(task));
+    }
+
+    // Taking the lock orders this notification after a worker's predicate
+    // check, so a worker about to sleep cannot miss the new task.
+    {
+        std::lock_guard<std::mutex> lock(SleepMutex);
+    }
+    Ready.notify_one();
+}
+
+bool ThreadPool::runPendingTask()
+{
+    std::function<void()> task;
+    const size_t self =
+        CurrentPool == this ? CurrentWorker : Queues.size() - 1;
+    if (!popTask(self, task)) return false;
+
+    task();
+    return true;
+}
+
+bool ThreadPool::parallel(size_t count, const std::function<void(size_t)>& fn,
+                          std::stop_token stop)
+{
+    if (count == 0) return true;
+
+    auto job = std::make_shared<ParallelJob>();
+    job->Fn = &fn;
+    job->Count = count;
+    job->Stop = std::move(stop);
+
+    // Helpers hold a reference to the job, so a helper that is dequeued after
+    // this call returned finds no work left and exits without touching fn.
+    const size_t helpers = std::min(count - 1, Workers.size());
+    for (size_t i = 0; i < helpers; ++i)
+    {
+        submit([job] { job->drain(); });
+    }
+
+    job->drain();
+
+    size_t done;
+    while ((done = job->Done.load(std::memory_order_acquire)) < count)
+    {
+        job->Done.wait(done, std::memory_order_acquire);
+    }
+
+    if (job->Error) std::rethrow_exception(job->Error);
+
+    return !job->Skipped.load(std::memory_order_relaxed);
+}
+
+ThreadPool& ThreadPool::global()
+{
+    static ThreadPool pool(
+        []
+        {
+            if (const char* env = std::getenv("IPS_NUM_THREADS"))
+            {
+                try
+                {
+                    return static_cast<size_t>(std::stoul(env));
+                }
+                catch (...)
+                {
+                }
+            }
+            // The calling thread always takes part in parallel(), so one
+            // worker fewer than the hardware provides keeps every core busy.
+            unsigned hw = std::max(1u, std::thread::hardware_concurrency());
+            return static_cast<size_t>(hw > 1 ? hw - 1 : 1);
+        }());
+    return pool;
+}
+
+bool ThreadPool::popTask(size_t self, std::function<void()>& task)
+{
+    if (Pending.load(std::memory_order_acquire) == 0) return false;
+
+    // Own deque from the back: the most recently pushed task is the one
+    // whose data is most likely still in cache.
+    {
+        auto& own = *Queues[self];
+        std::lock_guard<std::mutex> lock(own.Mutex);
+        if (!own.Tasks.empty())
+        {
+            task = std::move(own.Tasks.back());
+            own.Tasks.pop_back();
+            Pending.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+
+    // Steal the oldest task of another deque, starting next to our own so
+    // that thieves spread over victims.
+    const size_t count = Queues.size();
+    for (size_t k = 1; k < count; ++k)
+    {
+        auto& victim = *Queues[(self + k) % count];
+        std::lock_guard<std::mutex> lock(victim.Mutex);
+        if (!victim.Tasks.empty())
+        {
+            task = std::move(victim.Tasks.front());
+            victim.Tasks.pop_front();
+            Pending.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void ThreadPool::workerLoop(size_t index)
+{
+    CurrentPool = this;
+    CurrentWorker = index;
+
+    while (true)
+    {
+        std::function<void()> task;
+        if (popTask(index, task))
+        {
+            task();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(SleepMutex);
+        Ready.wait(lock,
+                   [this]
+                   {
+                       return Stopping ||
+                              Pending.load(std::memory_order_acquire) > 0;
+                   });
+
+        if (Stopping && Pending.load(std::memory_order_acquire) == 0) return;
+    }
+}
+
+}  // namespace ips
@@ -0,0 +1,152 @@
+#include "tile_chain.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#include "parallel.hpp"
+#include "profiler.hpp"
+
+namespace ips
+{
+
+TileChain::TileChain(size_t tileBytes, ThreadPool* pool)
+    : TileBytes(std::max<size_t>(1, tileBytes)), Pool(pool)
+{
+}
+
+void TileChain::addStage(Node node, size_t haloRows)
+{
+    Stages.push_back(Stage{std::move(node), haloRows});
+}
+
+void TileChain::setTileBytes(size_t tileBytes)
+{
+    TileBytes = std::max<size_t>(1, tileBytes);
+}
+
+size_t TileChain::haloRows() const noexcept
+{
+    size_t halo = 0;
+    for (const auto& stage : Stages) halo += stage.Halo;
+    return halo;
+}
+
+size_t TileChain::bandRows(const Image& image) const
+{
+    const size_t rowBytes = image.height() ? image.dataSize() / image.height()
+                                           : 0;
+    size_t rows = rowBytes ? TileBytes / rowBytes : image.height();
+
+    // Keep the halo overhead per band at or below the band itself.
+    rows = std::max(rows, 2 * haloRows());
+    return std::clamp<size_t>(rows, 1, std::max<size_t>(1, image.height()));
+}
+
+EXECError TileChain::executeInit(Image& image)
+{
+    if (image.empty()) return EXECError::EXEC_FAIL;
+
+    Image tile;
+    loadBand(image, 0, std::min(image.height(), bandRows(image) + haloRows()),
+             tile);
+
+    for (auto& stage : Stages)
+    {
+        if (stage.Op.executeInit(tile) != EXECError::EXEC_SUCCESS)
+        {
+            return EXECError::EXEC_FAIL;
+        }
+    }
+    return EXECError::EXEC_SUCCESS;
+}
+
+EXECError TileChain::executeRun(Image& image)
+{
+    if (Stages.empty()) return EXECError::EXEC_SUCCESS;
+    if (image.empty()) return EXECError::EXEC_FAIL;
+
+    IPS_PROFILE_SCOPE("TileChain::executeRun", "chain", image);
+
+    const size_t height = image.height();
+    const size_t halo = haloRows();
+    const size_t rows = bandRows(image);
+    const size_t bands = (height + rows - 1) / rows;
+    const size_t rowBytes = image.dataSize() / height;
+
+    // Without halos every band only reads its own rows and can be written
+    // back in place. Otherwise neighbouring bands still need the input.
+    Image output = halo ? Image(image.width(), height, image.channels(),
+                                image.type())
+                        : Image();
+    Image& target = halo ? output : image;
+
+    std::atomic<bool> failed{false};
+
+    ParallelOptions options;
+    options.Pool = Pool;
+    // A single chunk runs inline.
+    if (Serial) options.Grain = bands;
+
+    parallel_for(
+        0, bands,
+        [&](size_t firstBand, size_t lastBand)
+        {
+            Image tile;
+            for (size_t band = firstBand; band < lastBand; ++band)
+            {
+                if (failed.load(std::memory_order_relaxed)) return;
+
+                const size_t y0 = band * rows;
+                const size_t y1 = std::min(height, y0 + rows);
+                const size_t top = y0 >= halo ? y0 - halo : 0;
+                const size_t bottom = std::min(height, y1 + halo);
+
+                loadBand(image, top, bottom, tile);
+
+                for (auto& stage : Stages)
+                {
+                    if (stage.Op.executeRun(tile) != EXECError::EXEC_SUCCESS ||
+                        tile.width() != image.width() ||
+                        tile.height() != bottom - top ||
+                        tile.type() != image.type())
+                    {
+                        failed.store(true, std::memory_order_relaxed);
+                        return;
+                    }
+                }
+
+                std::memcpy(static_cast<uint8_t*>(target.data()) +
+                                y0 * rowBytes,
+                            static_cast<const uint8_t*>(tile.data()) +
+                                (y0 - top) * rowBytes,
+                            (y1 - y0) * rowBytes);
+            }
+        },
+        options);
+
+    if (failed.load()) return EXECError::EXEC_FAIL;
+
+    if (halo) image = std::move(output);
+    return EXECError::EXEC_SUCCESS;
+}
+
+void TileChain::loadBand(const Image& image, size_t first, size_t last,
+                         Image& tile) const
+{
+    const size_t rows = last - first;
+
+    // Reuse the scratch allocation unless the band shape changed.
+    if (tile.width() != image.width() || tile.height() != rows ||
+        tile.type() != image.type())
+    {
+        tile = Image(image.width(), rows, image.channels(), image.type());
+    }
+
+    const size_t rowBytes = image.dataSize() / image.height();
+    std::memcpy(tile.data(),
+                static_cast<const uint8_t*>(image.data()) + first * rowBytes,
+                rows * rowBytes);
+}
+
+}  // namespace ips
@@ -0,0 +1,414 @@
+#include "transform/geometry.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#include "profiler.hpp"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace ips::transform
+{
+
+namespace
+{
+// Largest block transposed at a time.
+constexpr size_t Block = 16;
+// Pixels per side of the tiles threads take: long enough row runs for the
+// prefetcher, while a source and destination tile together fit in L2.
+constexpr size_t TileSide = 128;
+
+size_t pixelBytes(const Image& image)
+{
+    return image.channels() *
+           (Image::isFloat(image.type()) ? sizeof(float) : 1);
+}
+
+void checkImage(const Image& src, const char* what)
+{
+    if (src.empty())
+    {
+        throw std::invalid_argument(std::string(what) + ": empty image");
+    }
+}
+
+// Output buffer of the given size for src -> dst; a fresh image when they
+// are the same.
+Image& target(const Image& src, Image& dst, Image& scratch, size_t w,
+              size_t h)
+{
+    Image& out = (&src == &dst) ? scratch : dst;
+    if (out.width() != w || out.height() != h || out.type() != src.type() ||
+        out.channels() != src.channels())
+    {
+        out = Image(w, h, src.channels(), src.type());
+    }
+    return out;
+}
+
+// Three- and twelve-byte pixels are cheapest moved as one 4- or 16-byte
+// load and store. That touches the first bytes of the next pixel on both
+// sides, so callers use it only where that pixel exists and is written
+// after this one.
+template <size_t P>
+constexpr size_t Wide = P == 3 ? 4 : P == 12 ? 16 : P;
+
+template <size_t Bytes>
+void copyBytes(uint8_t* out, const uint8_t* in)
+{
+    uint8_t v[Bytes];
+    std::memcpy(v, in, Bytes);
+    std::memcpy(out, v, Bytes);
+}
+
+// out[i][j] = in[j][i] for an n x m block: n output rows of m pixels, read
+// from m input rows of n pixels.
+template <size_t P>
+void transposeScalar(const uint8_t* const* in, uint8_t* const* out, size_t n,
+                     size_t m)
+{
+    for (size_t i = 0; i < n; ++i)
+    {
+        size_t j = 0;
+        if (i + 1 < n)
+        {
+            for (; j + 1 < m; ++j)
+            {
+                copyBytes<Wide<P>>(out[i] + j * P, in[j] + i * P);
+            }
+        }
+        for (; j < m; ++j) copyBytes<P>(out[i] + j * P, in[j] + i * P);
+    }
+}
+
+#if defined(__SSE2__)
+// Four rounds of byte interleaving between register k and k + 8: each
+// round rotates the 8-bit (register, byte) address left by one, so four
+// of them swap row and column.
+void transpose16x16(const uint8_t* const* in, uint8_t* const* out)
+{
+    __m128i r[16], t[16];
+    for (size_t j = 0; j < 16; ++j)
+    {
+        r[j] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in[j]));
+    }
+    for (int round = 0; round < 4; ++round)
+    {
+        for (size_t k = 0; k < 8; ++k)
+        {
+            t[2 * k] = _mm_unpacklo_epi8(r[k], r[k + 8]);
+            t[2 * k + 1] = _mm_unpackhi_epi8(r[k], r[k + 8]);
+        }
+        std::memcpy(r, t, sizeof(r));
+    }
+    for (size_t i = 0; i < 16; ++i)
+    {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out[i]), r[i]);
+    }
+}
+
+void transpose4x4(const uint8_t* const* in, uint8_t* const* out)
+{
+    const __m128i r0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in[0]));
+    const __m128i r1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in[1]));
+    const __m128i r2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in[2]));
+    const __m128i r3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in[3]));
+
+    const __m128i a0 = _mm_unpacklo_epi32(r0, r1);
+    const __m128i a1 = _mm_unpackhi_epi32(r0, r1);
+    const __m128i a2 = _mm_unpacklo_epi32(r2, r3);
+    const __m128i a3 = _mm_unpackhi_epi32(r2, r3);
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out[0]), _mm_unpacklo_epi64(a0, a2));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out[1]), _mm_unpackhi_epi64(a0, a2));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out[2]), _mm_unpacklo_epi64(a1, a3));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out[3]), _mm_unpackhi_epi64(a1, a3));
+}
+#endif
+
+// Side of the square blocks transposed in registers, or 0 if none.
+template <size_t P>
+constexpr size_t registerBlock()
+{
+#if defined(__SSE2__)
+    if constexpr (P == 1) return 16;
+    if constexpr (P == 4) return 4;
+#endif
+    return 0;
+}
+
+// dst(x, y) = src(column(y), row(x)) over one tile of dst, where column
+// counts from the right when reverseColumns and row from the bottom when
+// reverseRows. Those reversals are free: they only change which row
+// pointers a block reads and writes.
+template <size_t P>
+void transposeTile(const uint8_t* src, size_t srcW, size_t srcH, uint8_t* dst,
+                   const Tile& tile, bool reverseColumns, bool reverseRows)
+{
+    constexpr size_t B = registerBlock<P>();
+    const size_t srcStride = srcW * P;
+    const size_t dstStride = srcH * P;
+
+    const uint8_t* in[Block];
+    uint8_t* out[Block];
+
+    const size_t step = B ? B : 8;
+    for (size_t y0 = tile.Y; y0 < tile.Y + tile.Height; y0 += step)
+    {
+        const size_t n = std::min(step, tile.Y + tile.Height - y0);
+        // Leftmost source column of the n read by these output rows.
+        const size_t column = reverseColumns ? srcW - y0 - n : y0;
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            const size_t y = reverseColumns ? y0 + n - 1 - i : y0 + i;
+            out[i] = dst + y * dstStride;
+        }
+
+        for (size_t x0 = tile.X; x0 < tile.X + tile.Width; x0 += step)
+        {
+            const size_t m = std::min(step, tile.X + tile.Width - x0);
+            for (size_t j = 0; j < m; ++j)
+            {
+                const size_t row = reverseRows ? srcH - 1 - (x0 + j) : x0 + j;
+                in[j] = src + row * srcStride + column * P;
+            }
+
+            uint8_t* at[Block];
+            for (size_t i = 0; i < n; ++i) at[i] = out[i] + x0 * P;
+
+#if defined(__SSE2__)
+            if constexpr (B == 16)
+            {
+                if (n == B && m == B)
+                {
+                    transpose16x16(in, at);
+                    continue;
+                }
+            }
+            else if constexpr (B == 4)
+            {
+                if (n == B && m == B)
+                {
+                    transpose4x4(in, at);
+                    continue;
+                }
+            }
+#endif
+            transposeScalar<P>(in, at, n, m);
+        }
+    }
+}
+
+template <size_t P>
+void transposeImage(const Image& src, Image& out, bool reverseColumns,
+                    bool reverseRows, const ParallelOptions& options)
+{
+    const uint8_t* in = static_cast<const uint8_t*>(src.data());
+    uint8_t* o = static_cast<uint8_t*>(out.data());
+    const size_t w = src.width(), h = src.height();
+
+    parallel_for_tiles(
+        out, TileSide, TileSide,
+        [&](const Tile& tile)
+        { transposeTile<P>(in, w, h, o, tile, reverseColumns, reverseRows); },
+        options);
+}
+
+#if defined(__SSE2__)
+__m128i reverseBytes(__m128i v)
+{
+    v = _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3));
+    v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+    v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+    return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+}
+#endif
+
+// out[x] = in[w - 1 - x] for rows of w pixels.
+template <size_t P>
+void reverseRow(const uint8_t* in, uint8_t* out, size_t w)
+{
+    size_t x = 0;
+#if defined(__SSE2__)
+    if constexpr (P == 1 || P == 4)
+    {
+        constexpr size_t Lane = 16 / P;
+        for (; x + Lane <= w; x += Lane)
+        {
+            __m128i v = _mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(in + (w - x - Lane) * P));
+            if constexpr (P == 1)
+                v = reverseBytes(v);
+            else
+                v = _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x * P), v);
+        }
+    }
+#endif
+    if (x < w) copyBytes<P>(out + x * P, in + (w - 1 - x) * P);
+    // Pixel w - 1 - x is never the last of the row here.
+    for (++x; x + 1 < w; ++x)
+    {
+        copyBytes<Wide<P>>(out + x * P, in + (w - 1 - x) * P);
+    }
+    if (x < w) copyBytes<P>(out + x * P, in + (w - 1 - x) * P);
+}
+
+// dst row y = src row (h - 1 - y) when reverseRows, each row mirrored when
+// reversePixels.
+template <size_t P>
+void mirrorImage(const Image& src, Image& out, bool reversePixels,
+                 bool reverseRows, const ParallelOptions& options)
+{
+    const uint8_t* in = static_cast<const uint8_t*>(src.data());
+    uint8_t* o = static_cast<uint8_t*>(out.data());
+    const size_t w = src.width(), h = src.height();
+    const size_t stride = w * P;
+
+    parallel_for_rows(
+        out,
+        [&](size_t first, size_t last)
+        {
+            for (size_t y = first; y < last; ++y)
+            {
+                const uint8_t* s = in + (reverseRows ? h - 1 - y : y) * stride;
+                if (reversePixels)
+                    reverseRow<P>(s, o + y * stride, w);
+                else
+                    std::memcpy(o + y * stride, s, stride);
+            }
+        },
+        options);
+}
+
+// Calls fn.template operator()<P>() for src's pixel size in bytes.
+template <typename Fn>
+void withPixelBytes(const Image& src, Fn&& fn)
+{
+    switch (pixelBytes(src))
+    {
+        case 1:
+            fn.template operator()<1>();
+            break;
+        case 3:
+            fn.template operator()<3>();
+            break;
+        case 4:
+            fn.template operator()<4>();
+            break;
+        case 12:
+            fn.template operator()<12>();
+            break;
+        default:
+            throw std::invalid_argument("geometry: unsupported pixel size");
+    }
+}
+
+void transposed(const Image& src, Image& dst, bool reverseColumns,
+                bool reverseRows, const ParallelOptions& options)
+{
+    Image scratch;
+    Image& out = target(src, dst, scratch, src.height(), src.width());
+    withPixelBytes(src,
+                   [&]<size_t P>()
+                   {
+                       transposeImage<P>(src, out, reverseColumns, reverseRows,
+                                         options);
+                   });
+    if (&out == &scratch) dst = std::move(scratch);
+}
+
+void mirrored(const Image& src, Image& dst, bool reversePixels,
+              bool reverseRows, const ParallelOptions& options)
+{
+    Image scratch;
+    Image& out = target(src, dst, scratch, src.width(), src.height());
+    withPixelBytes(src,
+                   [&]<size_t P>()
+                   {
+                       mirrorImage<P>(src, out, reversePixels, reverseRows,
+                                      options);
+                   });
+    if (&out == &scratch) dst = std::move(scratch);
+}
+}  // namespace
+
+void transpose(const Image& src, Image& dst, const ParallelOptions& options)
+{
+    checkImage(src, "transpose");
+    IPS_PROFILE_SCOPE("transpose", "transform", src);
+
+    transposed(src, dst, false, false, options);
+}
+
+void rotate(const Image& src, Image& dst, Rotation rotation,
+            const ParallelOptions& options)
+{
+    checkImage(src, "rotate");
+    IPS_PROFILE_SCOPE("rotate", "transform", src);
+
+    switch (rotation)
+    {
+        case Rotation::Rotate90:
+            // dst(x, y) = src(y, h - 1 - x)
+            transposed(src, dst, false, true, options);
+            break;
+        case Rotation::Rotate180:
+            mirrored(src, dst, true, true, options);
+            break;
+        case Rotation::Rotate270:
+            // dst(x, y) = src(w - 1 - y, x)
+            transposed(src, dst, true, false, options);
+            break;
+    }
+}
+
+void flip(const Image& src, Image& dst, FlipAxis axis,
+          const ParallelOptions& options)
+{
+    checkImage(src, "flip");
+    IPS_PROFILE_SCOPE("flip", "transform", src);
+
+    const bool horizontal = axis == FlipAxis::Horizontal;
+    mirrored(src, dst, horizontal, !horizontal, options);
+}
+
+Node transposeNode(std::string name)
+{
+    auto run = [](Image& image)
+    {
+        if (image.empty()) return EXECError::EXEC_FAIL;
+        transpose(image, image);
+        return EXECError::EXEC_SUCCESS;
+    };
+    return Node(nullptr, std::move(run), std::move(name));
+}
+
+Node rotateNode(Rotation rotation, std::string name)
+{
+    auto run = [rotation](Image& image)
+    {
+        if (image.empty()) return EXECError::EXEC_FAIL;
+        rotate(image, image, rotation);
+        return EXECError::EXEC_SUCCESS;
+    };
+    return Node(nullptr, std::move(run), std::move(name));
+}
+
+Node flipNode(FlipAxis axis, std::string name)
+{
+    auto run = [axis](Image& image)
+    {
+        if (image.empty()) return EXECError::EXEC_FAIL;
+        flip(image, image, axis);
+        return EXECError::EXEC_SUCCESS;
+    };
+    return Node(nullptr, std::move(run), std::move(name));
+}
+
+}  // namespace ips::transform
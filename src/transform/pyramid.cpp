@@ -0,0 +1,455 @@
+#include "transform/pyramid.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <type_traits>
+
+#include "profiler.hpp"
+
+namespace ips::transform
+{
+
+namespace
+{
+using filter::BorderMode;
+using filter::borderIndex;
+
+// Offsets of levels in the arena are rounded up to whole cache lines.
+constexpr size_t LevelAlign = 64;
+// Horizontally reduced rows a level keeps; the Gaussian needs 5, and a
+// power of two keeps the slot computation a mask.
+constexpr size_t Ring = 8;
+// Bands shorter than this are not worth a thread.
+constexpr size_t MinBandRows = 64;
+// A band's overlap may cost at most 1 / OverlapRatio of its own rows.
+constexpr size_t OverlapRatio = 16;
+
+// Horizontal sums: 16 * 255 fits in 16 bits, and so does the vertical
+// sum of five of them weighted 1 4 6 4 1.
+template <typename T>
+using AccOf = std::conditional_t<std::is_same_v<T, uint8_t>, uint16_t, float>;
+
+// Rows 2i + Lo .. 2i + Hi of a level make row i of the next.
+template <bool Gaussian>
+struct Taps
+{
+    static constexpr std::ptrdiff_t Lo = Gaussian ? -2 : 0;
+    static constexpr std::ptrdiff_t Hi = Gaussian ? 2 : 1;
+    static constexpr size_t Count = Hi - Lo + 1;
+};
+
+template <bool Gaussian, typename Acc>
+Acc weigh(const Acc* v)
+{
+    if constexpr (Gaussian)
+        return static_cast<Acc>(v[0] + 4 * (v[1] + v[3]) + 6 * v[2] + v[4]);
+    else
+        return static_cast<Acc>(v[0] + v[1]);
+}
+
+// Halves a row horizontally without normalizing: out[x] is the weighted
+// sum around in[2x].
+template <typename T, size_t C, bool Gaussian>
+void reduceRow(const T* in, size_t w, AccOf<T>* out, size_t outW,
+               BorderMode mode, T constant)
+{
+    using Acc = AccOf<T>;
+    using K = Taps<Gaussian>;
+
+    // Columns whose taps all lie inside the row.
+    const size_t first = Gaussian ? 1 : 0;
+    const size_t last = std::max(
+        first, Gaussian ? (w >= 3 ? (w - 3) / 2 + 1 : 0) : w / 2);
+
+    auto edge = [&](size_t x)
+    {
+        for (size_t c = 0; c < C; ++c)
+        {
+            Acc v[K::Count];
+            for (size_t k = 0; k < K::Count; ++k)
+            {
+                const std::ptrdiff_t m = borderIndex(
+                    std::ptrdiff_t(2 * x) + K::Lo + std::ptrdiff_t(k), w, mode);
+                v[k] = m < 0 ? Acc(constant) : Acc(in[m * C + c]);
+            }
+            out[x * C + c] = weigh<Gaussian>(v);
+        }
+    };
+
+    for (size_t x = 0; x < std::min(first, outW); ++x) edge(x);
+    for (size_t x = first; x < std::min(last, outW); ++x)
+    {
+        const T* p = in + (2 * x + K::Lo) * C;
+        for (size_t c = 0; c < C; ++c)
+        {
+            if constexpr (Gaussian)
+                out[x * C + c] = static_cast<Acc>(
+                    Acc(p[c]) + 4 * (Acc(p[C + c]) + Acc(p[3 * C + c])) +
+                    6 * Acc(p[2 * C + c]) + Acc(p[4 * C + c]));
+            else
+                out[x * C + c] = static_cast<Acc>(Acc(p[c]) + Acc(p[C + c]));
+        }
+    }
+    for (size_t x = std::max(first, last); x < outW; ++x) edge(x);
+}
+
+// Vertical weighted sum of reduced rows, normalized back to T.
+template <typename T, bool Gaussian>
+void combineRows(const AccOf<T>* const* rows, size_t n, T* out)
+{
+    using Acc = AccOf<T>;
+    if constexpr (Gaussian)
+    {
+        const Acc *r0 = rows[0], *r1 = rows[1], *r2 = rows[2], *r3 = rows[3],
+                  *r4 = rows[4];
+        for (size_t i = 0; i < n; ++i)
+        {
+            const Acc v = static_cast<Acc>(r0[i] + 4 * (r1[i] + r3[i]) +
+                                           6 * r2[i] + r4[i]);
+            if constexpr (std::is_same_v<T, uint8_t>)
+                out[i] = static_cast<uint8_t>(static_cast<Acc>(v + 128) >> 8);
+            else
+                out[i] = v * (1.0f / 256.0f);
+        }
+    }
+    else
+    {
+        const Acc *r0 = rows[0], *r1 = rows[1];
+        for (size_t i = 0; i < n; ++i)
+        {
+            if constexpr (std::is_same_v<T, uint8_t>)
+                out[i] = static_cast<uint8_t>(
+                    static_cast<Acc>(r0[i] + r1[i] + 2) >> 2);
+            else
+                out[i] = (r0[i] + r1[i]) * 0.25f;
+        }
+    }
+}
+
+struct Extent
+{
+    size_t Width, Height;
+};
+
+// Turns rows of one level into rows of the next as they arrive. Rows in
+// [OwnFirst, OwnLast) are written to the arena; the others are overlap
+// needed by deeper levels of this band and only passed on.
+template <typename T, size_t C, bool Gaussian>
+class LevelStage
+{
+   public:
+    using Acc = AccOf<T>;
+    using K = Taps<Gaussian>;
+
+    LevelStage(Extent from, Extent to, T* out, size_t ownFirst,
+               size_t ownLast, BorderMode mode, T constant)
+        : From(from), To(to), Out(out), OwnFirst(ownFirst), OwnLast(ownLast),
+          Mode(mode), Constant(constant), Rows(Ring * to.Width * C),
+          Scratch(to.Width * C)
+    {
+        if (Mode == BorderMode::Constant)
+        {
+            std::vector<T> row(From.Width * C, Constant);
+            ConstantRow.resize(To.Width * C);
+            reduceRow<T, C, Gaussian>(row.data(), From.Width,
+                                      ConstantRow.data(), To.Width, Mode,
+                                      Constant);
+        }
+    }
+
+    void setNext(LevelStage* next) { Next = next; }
+
+    // Row r of the level above; rows arrive in order.
+    void push(size_t r, const T* row)
+    {
+        if (!Started)
+        {
+            // The first output row all of whose taps are at or after r.
+            Started = true;
+            NextRow = r == 0 ? 0 : (r + size_t(-K::Lo) + 1) / 2;
+        }
+        reduceRow<T, C, Gaussian>(row, From.Width, slot(r), To.Width, Mode,
+                                  Constant);
+        Received = r + 1;
+
+        const size_t n = To.Width * C;
+        while (NextRow < To.Height)
+        {
+            const Acc* taps[K::Count];
+            for (size_t k = 0; k < K::Count; ++k)
+            {
+                const std::ptrdiff_t m = borderIndex(
+                    std::ptrdiff_t(2 * NextRow) + K::Lo + std::ptrdiff_t(k),
+                    From.Height, Mode);
+                if (m >= std::ptrdiff_t(Received)) return;
+                taps[k] = m < 0 ? ConstantRow.data() : slot(size_t(m));
+            }
+            const bool own = NextRow >= OwnFirst && NextRow < OwnLast;
+            T* dst = own ? Out + NextRow * n : Scratch.data();
+            combineRows<T, Gaussian>(taps, n, dst);
+            if (Next) Next->push(NextRow, dst);
+            ++NextRow;
+        }
+    }
+
+   private:
+    Acc* slot(size_t r) { return Rows.data() + (r % Ring) * To.Width * C; }
+
+    Extent From, To;
+    T* Out;
+    size_t OwnFirst, OwnLast;
+    BorderMode Mode;
+    T Constant;
+    std::vector<Acc> Rows;
+    std::vector<Acc> ConstantRow;
+    std::vector<T> Scratch;
+    LevelStage* Next = nullptr;
+    bool Started = false;
+    size_t NextRow = 0, Received = 0;
+};
+
+struct Range
+{
+    size_t First = 0, Last = 0;
+};
+
+// Builds levels first + 1 .. last from level `first`, whose rows are at
+// `src`, in `bands` bands of `bandRows` rows of level `first` (a multiple
+// of 2^(last - first), so that bands split every level on row boundaries).
+template <typename T, size_t C, bool Gaussian>
+void buildLevels(const T* src, const std::vector<Extent>& extents,
+                 const std::vector<T*>& levels, size_t first, size_t last,
+                 size_t bandRows, T* baseCopy, BorderMode mode, T constant,
+                 const ParallelOptions& options)
+{
+    using K = Taps<Gaussian>;
+    const size_t depth = last - first;
+    const size_t height = extents[first].Height;
+    const size_t bands = (height + bandRows - 1) / bandRows;
+
+    parallel_for(
+        0, bands,
+        [&](size_t b0, size_t b1)
+        {
+            for (size_t b = b0; b < b1; ++b)
+            {
+                // Rows of each level this band writes.
+                std::vector<Range> own(depth + 1);
+                for (size_t j = 0; j <= depth; ++j)
+                {
+                    own[j].First = (b * bandRows) >> j;
+                    own[j].Last = b + 1 == bands
+                                      ? extents[first + j].Height
+                                      : ((b + 1) * bandRows) >> j;
+                }
+
+                // Rows each level needs: its own, plus those under the
+                // kernels of the rows needed from the level below it.
+                std::vector<Range> need = own;
+                for (size_t j = depth; j > 0; --j)
+                {
+                    if (need[j].First >= need[j].Last) continue;
+                    const auto h = std::ptrdiff_t(extents[first + j - 1].Height);
+                    const std::ptrdiff_t lo = std::clamp<std::ptrdiff_t>(
+                        2 * std::ptrdiff_t(need[j].First) + K::Lo, 0, h);
+                    const std::ptrdiff_t hi = std::clamp<std::ptrdiff_t>(
+                        2 * std::ptrdiff_t(need[j].Last) - 1 + K::Hi, 0, h);
+                    if (need[j - 1].First >= need[j - 1].Last)
+                        need[j - 1] = {size_t(lo), size_t(hi)};
+                    need[j - 1].First = std::min(need[j - 1].First, size_t(lo));
+                    need[j - 1].Last = std::max(need[j - 1].Last, size_t(hi));
+                }
+
+                std::vector<LevelStage<T, C, Gaussian>> stages;
+                stages.reserve(depth);
+                for (size_t j = 1; j <= depth; ++j)
+                {
+                    stages.emplace_back(extents[first + j - 1],
+                                        extents[first + j], levels[first + j],
+                                        own[j].First, own[j].Last, mode,
+                                        constant);
+                }
+                for (size_t j = 0; j + 1 < depth; ++j)
+                {
+                    stages[j].setNext(&stages[j + 1]);
+                }
+
+                const size_t n = extents[first].Width * C;
+                for (size_t r = need[0].First; r < need[0].Last; ++r)
+                {
+                    const T* row = src + r * n;
+                    if (baseCopy && r >= own[0].First && r < own[0].Last)
+                    {
+                        std::memcpy(baseCopy + r * n, row, n * sizeof(T));
+                    }
+                    stages[0].push(r, row);
+                }
+            }
+        },
+        ParallelOptions{1, options.Stop, options.Pool});
+}
+
+template <typename T, size_t C, bool Gaussian>
+void build(const Image& src, const std::vector<Extent>& extents,
+           const std::vector<T*>& levels, const PyramidOptions& options)
+{
+    const BorderMode mode = Gaussian ? options.Border : BorderMode::Replicate;
+    const T constant = filter::detail::borderConstant<T>(options);
+
+    const T* source = reinterpret_cast<const T*>(src.data());
+    if (extents.size() == 1)
+    {
+        std::memcpy(levels[0], source, src.dataSize());
+        return;
+    }
+
+    const size_t threads =
+        ips::detail::poolOf(options.Parallel).size() + 1;
+    size_t first = 0;
+    while (first + 1 < extents.size())
+    {
+        const size_t height = extents[first].Height;
+        const size_t bands =
+            std::clamp<size_t>(height / MinBandRows, 1, threads);
+
+        // A band's deeper levels need k levels of overlap: 2 (2^k - 1) rows
+        // of this level above and below for the Gaussian, none for the box.
+        // When that gets too large for the band, stop there; the remaining
+        // levels are a small fraction of the work and take another pass.
+        size_t depth = extents.size() - 1 - first;
+        if (Gaussian && bands > 1)
+        {
+            size_t k = 1;
+            while (k < depth &&
+                   2 * ((size_t(1) << (k + 1)) - 1) * OverlapRatio <=
+                       height / bands)
+            {
+                ++k;
+            }
+            depth = k;
+        }
+
+        const size_t step = size_t(1) << depth;
+        const size_t bandRows =
+            ((height + bands - 1) / bands + step - 1) / step * step;
+        buildLevels<T, C, Gaussian>(
+            first == 0 ? source : levels[first], extents, levels, first,
+            first + depth, bandRows, first == 0 ? levels[0] : nullptr, mode,
+            constant, options.Parallel);
+        first += depth;
+    }
+}
+
+template <typename T, size_t C>
+void buildTyped(const Image& src, const std::vector<Extent>& extents,
+                const std::vector<uint8_t*>& bases,
+                const PyramidOptions& options)
+{
+    std::vector<T*> levels(bases.size());
+    for (size_t i = 0; i < bases.size(); ++i)
+    {
+        levels[i] = reinterpret_cast<T*>(bases[i]);
+    }
+    if (options.Kernel == PyramidKernel::Gaussian)
+        build<T, C, true>(src, extents, levels, options);
+    else
+        build<T, C, false>(src, extents, levels, options);
+}
+}  // namespace
+
+Image Pyramid::image(size_t level) const
+{
+    const LevelInfo& info = at(level);
+    Image out(info.Width, info.Height, Channels, Type);
+    std::memcpy(out.data(), Arena.data() + info.Offset, out.dataSize());
+    return out;
+}
+
+void buildPyramid(const Image& src, Pyramid& pyramid,
+                  const PyramidOptions& options)
+{
+    if (src.empty())
+    {
+        throw std::invalid_argument("buildPyramid: empty image");
+    }
+    if (options.Kernel == PyramidKernel::Gaussian &&
+        options.Border == BorderMode::Wrap)
+    {
+        throw std::invalid_argument(
+            "buildPyramid: wrap borders are not supported");
+    }
+    IPS_PROFILE_SCOPE("pyramid", "transform", src);
+
+    std::vector<Extent> extents{{src.width(), src.height()}};
+    while ((options.Levels == 0 || extents.size() < options.Levels) &&
+           (extents.back().Width > 1 || extents.back().Height > 1))
+    {
+        extents.push_back({(extents.back().Width + 1) / 2,
+                           (extents.back().Height + 1) / 2});
+    }
+
+    const size_t pixelBytes = src.dataSize() / (src.width() * src.height());
+    bool reuse = pyramid.Type == src.type() &&
+                 pyramid.Channels == src.channels() &&
+                 pyramid.Levels.size() == extents.size();
+    for (size_t i = 0; reuse && i < extents.size(); ++i)
+    {
+        reuse = pyramid.Levels[i].Width == extents[i].Width &&
+                pyramid.Levels[i].Height == extents[i].Height;
+    }
+    if (!reuse)
+    {
+        pyramid.Levels.clear();
+        size_t offset = 0;
+        for (const Extent& e : extents)
+        {
+            pyramid.Levels.push_back({e.Width, e.Height, offset});
+            offset += e.Width * e.Height * pixelBytes;
+            offset = (offset + LevelAlign - 1) / LevelAlign * LevelAlign;
+        }
+        pyramid.Type = src.type();
+        pyramid.Channels = src.channels();
+        pyramid.Arena.assign(offset, 0);
+    }
+
+    std::vector<uint8_t*> bases;
+    for (const Pyramid::LevelInfo& info : pyramid.Levels)
+    {
+        bases.push_back(pyramid.Arena.data() + info.Offset);
+    }
+
+    switch (src.type())
+    {
+        case Image::IMAGE_TYPE::IMAGE_U8C1:
+            buildTyped<uint8_t, 1>(src, extents, bases, options);
+            break;
+        case Image::IMAGE_TYPE::IMAGE_U8C3:
+            buildTyped<uint8_t, 3>(src, extents, bases, options);
+            break;
+        case Image::IMAGE_TYPE::IMAGE_U8C4:
+            buildTyped<uint8_t, 4>(src, extents, bases, options);
+            break;
+        case Image::IMAGE_TYPE::IMAGE_F32C1:
+            buildTyped<float, 1>(src, extents, bases, options);
+            break;
+        case Image::IMAGE_TYPE::IMAGE_F32C3:
+            buildTyped<float, 3>(src, extents, bases, options);
+            break;
+    }
+}
+
+Node pyramidLevelNode(size_t level, PyramidOptions options, std::string name)
+{
+    options.Levels = level + 1;
+    auto run = [level, options](Image& image)
+    {
+        if (image.empty()) return EXECError::EXEC_FAIL;
+        Pyramid pyramid;
+        buildPyramid(image, pyramid, options);
+        image = pyramid.image(std::min(level, pyramid.levels() - 1));
+        return EXECError::EXEC_SUCCESS;
+    };
+    return Node(nullptr, std::move(run), std::move(name));
+}
+}  // namespace ips::transform
@@ -0,0 +1,675 @@
+#include "transform/resize.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+
+#include "plan_cache.hpp"
+#include "profiler.hpp"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace ips::transform
+{
+
+namespace
+{
+constexpr int FixedBits = 14;
+// Fraction bits of the 16-bit intermediate rows of the U8 path.
+constexpr int InterBits = 6;
+
+double sinc(double x)
+{
+    if (x == 0.0) return 1.0;
+    x *= 3.14159265358979323846;
+    return std::sin(x) / x;
+}
+
+double support(Interpolation method)
+{
+    switch (method)
+    {
+        case Interpolation::Bilinear:
+            return 1.0;
+        case Interpolation::Bicubic:
+            return 2.0;
+        case Interpolation::Lanczos:
+            return 3.0;
+        case Interpolation::Area:
+            return 0.5;
+        case Interpolation::Nearest:
+            break;
+    }
+    return 0.5;
+}
+
+double kernel(Interpolation method, double x)
+{
+    x = std::abs(x);
+    switch (method)
+    {
+        case Interpolation::Bilinear:
+            return x < 1.0 ? 1.0 - x : 0.0;
+        case Interpolation::Bicubic:
+        {
+            // Keys cubic with a = -0.5 (Catmull-Rom).
+            constexpr double a = -0.5;
+            if (x < 1.0) return ((a + 2.0) * x - (a + 3.0)) * x * x + 1.0;
+            if (x < 2.0) return ((a * x - 5.0 * a) * x + 8.0 * a) * x - 4.0 * a;
+            return 0.0;
+        }
+        case Interpolation::Lanczos:
+            return x < 3.0 ? sinc(x) * sinc(x / 3.0) : 0.0;
+        case Interpolation::Area:
+        case Interpolation::Nearest:
+            break;
+    }
+    return x < 0.5 ? 1.0 : 0.0;
+}
+
+AxisPlan nearestAxis(size_t src, size_t dst)
+{
+    AxisPlan axis;
+    axis.Taps = 1;
+    axis.Start.resize(dst);
+    axis.Weights.assign(dst, 1.0f);
+    axis.Fixed.assign(dst, int16_t(1 << FixedBits));
+
+    const double scale = double(src) / double(dst);
+    for (size_t i = 0; i < dst; ++i)
+    {
+        const auto j = static_cast<size_t>((double(i) + 0.5) * scale);
+        axis.Start[i] = static_cast<int32_t>(std::min(j, src - 1));
+    }
+    return axis;
+}
+
+AxisPlan filterAxis(size_t src, size_t dst, Interpolation method)
+{
+    if (method == Interpolation::Nearest) return nearestAxis(src, dst);
+
+    const double scale = double(src) / double(dst);
+    const double stretch = std::max(scale, 1.0);
+    const double radius = support(method) * stretch;
+
+    AxisPlan axis;
+    axis.Taps = std::min<size_t>(
+        src, static_cast<size_t>(std::ceil(radius)) * 2 + 1);
+    axis.Start.resize(dst);
+    axis.Weights.assign(dst * axis.Taps, 0.0f);
+    axis.Fixed.assign(dst * axis.Taps, 0);
+
+    const auto last = static_cast<std::ptrdiff_t>(src) - 1;
+    std::vector<double> weights(axis.Taps);
+
+    for (size_t i = 0; i < dst; ++i)
+    {
+        // Sample centres sit at j + 0.5 in source coordinates.
+        const double center = (double(i) + 0.5) * scale;
+        const auto lo = static_cast<std::ptrdiff_t>(std::floor(center - radius));
+        const auto hi = static_cast<std::ptrdiff_t>(std::ceil(center + radius));
+        const std::ptrdiff_t start = std::clamp<std::ptrdiff_t>(
+            lo, 0, static_cast<std::ptrdiff_t>(src - axis.Taps));
+
+        std::fill(weights.begin(), weights.end(), 0.0);
+        double total = 0.0;
+        for (std::ptrdiff_t j = lo; j < hi; ++j)
+        {
+            double w;
+            if (method == Interpolation::Area)
+            {
+                // Overlap of the source pixel with the output footprint.
+                const double a = std::max(double(j), center - 0.5 * stretch);
+                const double b = std::min(double(j + 1), center + 0.5 * stretch);
+                w = std::max(0.0, b - a);
+            }
+            else
+            {
+                w = kernel(method, (double(j) + 0.5 - center) / stretch);
+            }
+            if (w == 0.0) continue;
+
+            const std::ptrdiff_t k = std::clamp<std::ptrdiff_t>(j, 0, last) - start;
+            if (k < 0 || k >= static_cast<std::ptrdiff_t>(axis.Taps)) continue;
+            weights[static_cast<size_t>(k)] += w;
+            total += w;
+        }
+        if (total == 0.0)
+        {
+            weights[0] = 1.0;
+            total = 1.0;
+        }
+
+        axis.Start[i] = static_cast<int32_t>(start);
+        float* out = axis.Weights.data() + i * axis.Taps;
+        int16_t* fixed = axis.Fixed.data() + i * axis.Taps;
+
+        int sum = 0;
+        size_t largest = 0;
+        for (size_t k = 0; k < axis.Taps; ++k)
+        {
+            const double w = weights[k] / total;
+            out[k] = static_cast<float>(w);
+            fixed[k] = static_cast<int16_t>(std::lround(w * (1 << FixedBits)));
+            sum += fixed[k];
+            if (std::abs(w) > std::abs(weights[largest] / total)) largest = k;
+        }
+        // Exact unit gain: flat areas stay flat.
+        fixed[largest] =
+            static_cast<int16_t>(fixed[largest] + (1 << FixedBits) - sum);
+    }
+    return axis;
+}
+
+Image makeOutput(const Image& src, const ResizePlan& plan)
+{
+    return Image(plan.DstWidth, plan.DstHeight, src.channels(), src.type());
+}
+
+template <typename T>
+void resizeNearest(const Image& src, Image& dst, const ResizePlan& plan,
+                   const ParallelOptions& options)
+{
+    const size_t C = src.channels();
+    const T* in = src.dataAs<T>();
+    T* out = dst.dataAs<T>();
+    const size_t srcRow = plan.SrcWidth * C;
+    const size_t dstRow = plan.DstWidth * C;
+
+    parallel_for(
+        0, plan.DstHeight,
+        [&](size_t first, size_t last)
+        {
+            const int32_t* xs = plan.X.Start.data();
+            for (size_t y = first; y < last; ++y)
+            {
+                const T* s = in + size_t(plan.Y.Start[y]) * srcRow;
+                T* d = out + y * dstRow;
+                for (size_t x = 0; x < plan.DstWidth; ++x)
+                {
+                    const T* p = s + size_t(xs[x]) * C;
+                    for (size_t c = 0; c < C; ++c) d[x * C + c] = p[c];
+                }
+            }
+        },
+        options);
+}
+
+template <typename T, typename Acc>
+void resizeBox(const Image& src, Image& dst, const ResizePlan& plan,
+               const ParallelOptions& options)
+{
+    const size_t C = src.channels();
+    const size_t fx = plan.BoxX, fy = plan.BoxY;
+    const T* in = src.dataAs<T>();
+    T* out = dst.dataAs<T>();
+    const size_t srcRow = plan.SrcWidth * C;
+    const size_t dstRow = plan.DstWidth * C;
+    const float inverse = 1.0f / float(fx * fy);
+
+    parallel_for(
+        0, plan.DstHeight,
+        [&](size_t first, size_t last)
+        {
+            std::vector<Acc> sums(srcRow);
+            for (size_t y = first; y < last; ++y)
+            {
+                // Column sums over the fy source rows, then fx-wide blocks.
+                const T* s = in + y * fy * srcRow;
+                Acc* acc = sums.data();
+                const size_t n = srcRow;
+                for (size_t i = 0; i < n; ++i) acc[i] = Acc(s[i]);
+                for (size_t r = 1; r < fy; ++r)
+                {
+                    const T* line = s + r * srcRow;
+                    for (size_t i = 0; i < n; ++i) acc[i] += Acc(line[i]);
+                }
+
+                T* d = out + y * dstRow;
+                for (size_t x = 0; x < plan.DstWidth; ++x)
+                {
+                    const Acc* block = acc + x * fx * C;
+                    for (size_t c = 0; c < C; ++c)
+                    {
+                        Acc total = 0;
+                        for (size_t k = 0; k < fx; ++k) total += block[k * C + c];
+                        if constexpr (std::is_same_v<T, uint8_t>)
+                            d[x * C + c] =
+                                static_cast<uint8_t>(float(total) * inverse + 0.5f);
+                        else
+                            d[x * C + c] = static_cast<T>(float(total) * inverse);
+                    }
+                }
+            }
+        },
+        options);
+}
+
+// U8: horizontal pass u8 x 2.14 into 16-bit rows with InterBits fraction
+// bits, vertical pass 16-bit x 2.14 in 32 bits. The channel count is a
+// template parameter so the per-pixel channel loops unroll into registers.
+//
+// Every output pixel has its own window, so unlike the convolution rows the
+// SIMD paths gather: multi-channel pixels take two taps per multiply-add
+// with one lane per channel, single-channel rows take four outputs at a
+// time with one tap pair per lane. Sums are exact, so both match the
+// scalar loop bit for bit.
+template <size_t C>
+void horizontalU8(const uint8_t* s, int16_t* d, const AxisPlan& axis,
+                  [[maybe_unused]] size_t srcWidth, size_t dstWidth)
+{
+    const size_t taps = axis.Taps;
+    const int32_t* starts = axis.Start.data();
+    const int16_t* weights = axis.Fixed.data();
+    constexpr int shift = FixedBits - InterBits;
+
+    size_t x = 0;
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i half = _mm_set1_epi32(1 << (shift - 1));
+    const size_t pairs = taps & ~size_t(1);
+    if constexpr (C == 1)
+    {
+        for (; x + 4 <= dstWidth; x += 4)
+        {
+            const uint8_t* p[4];
+            const int16_t* w[4];
+            for (size_t i = 0; i < 4; ++i)
+            {
+                p[i] = s + size_t(starts[x + i]);
+                w[i] = weights + (x + i) * taps;
+            }
+
+            __m128i acc = half;
+            auto add = [&](auto pixel, auto weight)
+            {
+                const __m128i v = _mm_set_epi32(pixel(3), pixel(2), pixel(1),
+                                                pixel(0));
+                const __m128i wk = _mm_set_epi32(weight(3), weight(2),
+                                                 weight(1), weight(0));
+                acc = _mm_add_epi32(acc, _mm_madd_epi16(v, wk));
+            };
+            for (size_t k = 0; k < pairs; k += 2)
+            {
+                add([&](size_t i)
+                    { return int(p[i][k]) | int(p[i][k + 1]) << 16; },
+                    [&](size_t i)
+                    {
+                        int32_t pair;
+                        std::memcpy(&pair, w[i] + k, sizeof(pair));
+                        return pair;
+                    });
+            }
+            if (pairs < taps)
+            {
+                add([&](size_t i) { return int(p[i][pairs]); },
+                    [&](size_t i) { return int(uint16_t(w[i][pairs])); });
+            }
+
+            acc = _mm_srai_epi32(acc, shift);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(d + x),
+                             _mm_packs_epi32(acc, acc));
+        }
+    }
+    else
+    {
+        for (; x < dstWidth; ++x)
+        {
+            const uint8_t* p = s + size_t(starts[x]) * C;
+            const int16_t* w = weights + x * taps;
+
+            // Two neighbouring pixels interleaved per channel against their
+            // weight pair; the lane past the last channel of RGB is unused.
+            // RGB reads two bytes past the pair; near the row end those
+            // bytes are loaded one at a time.
+            const bool wide =
+                C == 4 || size_t(starts[x]) + pairs < srcWidth;
+            __m128i acc = half;
+            for (size_t k = 0; k < pairs; k += 2)
+            {
+                uint64_t bytes = 0;
+                if (wide)
+                    std::memcpy(&bytes, p + k * C, sizeof(bytes));
+                else
+                    std::memcpy(&bytes, p + k * C, 2 * C);
+                const __m128i v = _mm_unpacklo_epi8(
+                    _mm_cvtsi64_si128(static_cast<long long>(bytes)), zero);
+                int32_t pair;
+                std::memcpy(&pair, w + k, sizeof(pair));
+                acc = _mm_add_epi32(
+                    acc, _mm_madd_epi16(
+                             _mm_unpacklo_epi16(v, _mm_srli_si128(v, 2 * C)),
+                             _mm_set1_epi32(pair)));
+            }
+            if (pairs < taps)
+            {
+                uint32_t bytes = 0;
+                std::memcpy(&bytes, p + pairs * C, C);
+                const __m128i v = _mm_unpacklo_epi8(
+                    _mm_cvtsi32_si128(static_cast<int>(bytes)), zero);
+                acc = _mm_add_epi32(
+                    acc, _mm_madd_epi16(_mm_unpacklo_epi16(v, zero),
+                                        _mm_set1_epi32(uint16_t(w[pairs]))));
+            }
+
+            // The fourth RGB lane lands on the next pixel, which is written
+            // afterwards; only the last pixel of the row is stored exactly.
+            acc = _mm_srai_epi32(acc, shift);
+            const __m128i packed = _mm_packs_epi32(acc, acc);
+            if (C == 4 || x + 1 < dstWidth)
+            {
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(d + x * C), packed);
+            }
+            else
+            {
+                alignas(16) int16_t out[8];
+                _mm_store_si128(reinterpret_cast<__m128i*>(out), packed);
+                std::memcpy(d + x * C, out, C * sizeof(int16_t));
+            }
+        }
+    }
+#endif
+    for (; x < dstWidth; ++x)
+    {
+        const uint8_t* p = s + size_t(starts[x]) * C;
+        const int16_t* w = weights + x * taps;
+
+        int32_t acc[C];
+        for (size_t c = 0; c < C; ++c) acc[c] = 1 << (shift - 1);
+        for (size_t k = 0; k < taps; ++k, p += C)
+        {
+            const int32_t wk = w[k];
+            for (size_t c = 0; c < C; ++c) acc[c] += wk * p[c];
+        }
+        for (size_t c = 0; c < C; ++c)
+        {
+            d[x * C + c] = static_cast<int16_t>(acc[c] >> shift);
+        }
+    }
+}
+
+void verticalU8(const int16_t* const* rows, const int16_t* w, size_t taps,
+                uint8_t* out, size_t n)
+{
+    constexpr int shift = FixedBits + InterBits;
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i half = _mm_set1_epi32(1 << (shift - 1));
+    for (; i + 8 <= n; i += 8)
+    {
+        // Two rows per multiply-add, interleaved with their weights.
+        __m128i lo = half, hi = half;
+        for (size_t k = 0; k < taps; k += 2)
+        {
+            const __m128i a =
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[k] + i));
+            const __m128i b =
+                k + 1 < taps
+                    ? _mm_loadu_si128(
+                          reinterpret_cast<const __m128i*>(rows[k + 1] + i))
+                    : zero;
+            const int next = k + 1 < taps ? w[k + 1] : 0;
+            const __m128i wk = _mm_set1_epi32(
+                static_cast<int>(uint32_t(uint16_t(next)) << 16 | uint16_t(w[k])));
+            lo = _mm_add_epi32(lo, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), wk));
+            hi = _mm_add_epi32(hi, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), wk));
+        }
+        lo = _mm_srai_epi32(lo, shift);
+        hi = _mm_srai_epi32(hi, shift);
+        const __m128i packed = _mm_packs_epi32(lo, hi);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(out + i),
+                         _mm_packus_epi16(packed, packed));
+    }
+#endif
+    for (; i < n; ++i)
+    {
+        int32_t acc = 1 << (shift - 1);
+        for (size_t k = 0; k < taps; ++k) acc += w[k] * rows[k][i];
+        out[i] = static_cast<uint8_t>(std::clamp(acc >> shift, 0, 255));
+    }
+}
+
+// F32 stays scalar: hand-written SSE2 (one pixel per tap, or four taps per
+// dot product) measured no faster than what the compiler makes of this loop.
+template <size_t C>
+void horizontalF32(const float* s, float* d, const AxisPlan& axis,
+                   size_t dstWidth)
+{
+    const size_t taps = axis.Taps;
+    const int32_t* starts = axis.Start.data();
+    const float* weights = axis.Weights.data();
+
+    for (size_t x = 0; x < dstWidth; ++x)
+    {
+        const float* p = s + size_t(starts[x]) * C;
+        const float* w = weights + x * taps;
+
+        float acc[C] = {};
+        for (size_t k = 0; k < taps; ++k, p += C)
+        {
+            const float wk = w[k];
+            for (size_t c = 0; c < C; ++c) acc[c] += wk * p[c];
+        }
+        for (size_t c = 0; c < C; ++c) d[x * C + c] = acc[c];
+    }
+}
+
+template <typename T, typename Inter>
+void horizontal(const T* s, Inter* d, const AxisPlan& axis, size_t srcWidth,
+                size_t dstWidth, size_t C)
+{
+    auto run = [&]<size_t N>()
+    {
+        if constexpr (std::is_same_v<T, uint8_t>)
+            horizontalU8<N>(s, d, axis, srcWidth, dstWidth);
+        else
+            horizontalF32<N>(s, d, axis, dstWidth);
+    };
+
+    switch (C)
+    {
+        case 1:
+            run.template operator()<1>();
+            break;
+        case 3:
+            run.template operator()<3>();
+            break;
+        default:
+            run.template operator()<4>();
+            break;
+    }
+}
+
+void verticalF32(const float* const* rows, const float* w, size_t taps,
+                 float* out, size_t n)
+{
+    const float w0 = w[0];
+    const float* r0 = rows[0];
+    for (size_t i = 0; i < n; ++i) out[i] = w0 * r0[i];
+
+    for (size_t k = 1; k < taps; ++k)
+    {
+        const float wk = w[k];
+        const float* r = rows[k];
+        for (size_t i = 0; i < n; ++i) out[i] += wk * r[i];
+    }
+}
+
+// Horizontal pass over every source row the vertical taps touch, then the
+// vertical pass per output row; both parallel over rows.
+template <typename T, typename Inter>
+void resizeSeparable(const Image& src, Image& dst, const ResizePlan& plan,
+                     const ParallelOptions& options)
+{
+    const size_t C = src.channels();
+    const size_t srcRow = plan.SrcWidth * C;
+    const size_t dstRow = plan.DstWidth * C;
+    const T* in = src.dataAs<T>();
+    T* out = dst.dataAs<T>();
+
+    const size_t y0 = size_t(plan.Y.Start.front());
+    const size_t y1 = size_t(plan.Y.Start.back()) + plan.Y.Taps;
+    std::vector<Inter> inter((y1 - y0) * dstRow);
+
+    parallel_for(
+        y0, y1,
+        [&](size_t first, size_t last)
+        {
+            for (size_t y = first; y < last; ++y)
+            {
+                horizontal(in + y * srcRow, inter.data() + (y - y0) * dstRow,
+                           plan.X, plan.SrcWidth, plan.DstWidth, C);
+            }
+        },
+        options);
+
+    parallel_for(
+        0, plan.DstHeight,
+        [&](size_t first, size_t last)
+        {
+            const size_t taps = plan.Y.Taps;
+            std::vector<const Inter*> rows(taps);
+            for (size_t y = first; y < last; ++y)
+            {
+                const size_t base = size_t(plan.Y.Start[y]) - y0;
+                for (size_t k = 0; k < taps; ++k)
+                {
+                    rows[k] = inter.data() + (base + k) * dstRow;
+                }
+
+                if constexpr (std::is_same_v<T, uint8_t>)
+                    verticalU8(rows.data(), plan.Y.Fixed.data() + y * taps,
+                               taps, out + y * dstRow, dstRow);
+                else
+                    verticalF32(rows.data(), plan.Y.Weights.data() + y * taps,
+                                taps, out + y * dstRow, dstRow);
+            }
+        },
+        options);
+}
+
+struct PlanKey
+{
+    size_t SrcWidth, SrcHeight, DstWidth, DstHeight;
+    Interpolation Method;
+
+    bool operator==(const PlanKey&) const = default;
+};
+
+// Recent plans of the free resize().
+std::shared_ptr<const ResizePlan> cachedPlan(const PlanKey& key)
+{
+    static PlanCache<ResizePlan, PlanKey> plans(
+        [](const PlanKey& k)
+        {
+            return ResizePlan::create(k.SrcWidth, k.SrcHeight, k.DstWidth,
+                                      k.DstHeight, k.Method);
+        },
+        16);
+    return plans.get(key);
+}
+}  // namespace
+
+ResizePlan ResizePlan::create(size_t srcWidth, size_t srcHeight,
+                              size_t dstWidth, size_t dstHeight,
+                              Interpolation method)
+{
+    if (!srcWidth || !srcHeight || !dstWidth || !dstHeight)
+    {
+        throw std::invalid_argument("ResizePlan: sizes must be non-zero");
+    }
+
+    ResizePlan plan;
+    plan.SrcWidth = srcWidth;
+    plan.SrcHeight = srcHeight;
+    plan.DstWidth = dstWidth;
+    plan.DstHeight = dstHeight;
+    plan.Method = method;
+
+    if (method == Interpolation::Area && srcWidth % dstWidth == 0 &&
+        srcHeight % dstHeight == 0)
+    {
+        plan.BoxX = srcWidth / dstWidth;
+        plan.BoxY = srcHeight / dstHeight;
+        return plan;
+    }
+
+    plan.X = filterAxis(srcWidth, dstWidth, method);
+    plan.Y = filterAxis(srcHeight, dstHeight, method);
+    return plan;
+}
+
+void resize(const Image& src, Image& dst, const ResizePlan& plan,
+            const ParallelOptions& options)
+{
+    if (src.width() != plan.SrcWidth || src.height() != plan.SrcHeight)
+    {
+        throw std::invalid_argument("resize: image does not match the plan");
+    }
+
+    IPS_PROFILE_SCOPE("resize", "transform", src);
+
+    Image out = makeOutput(src, plan);
+    const bool f32 = Image::isFloat(src.type());
+
+    if (plan.BoxX)
+    {
+        if (f32)
+            resizeBox<float, float>(src, out, plan, options);
+        else
+            resizeBox<uint8_t, uint32_t>(src, out, plan, options);
+    }
+    else if (plan.Method == Interpolation::Nearest)
+    {
+        if (f32)
+            resizeNearest<float>(src, out, plan, options);
+        else
+            resizeNearest<uint8_t>(src, out, plan, options);
+    }
+    else if (f32)
+    {
+        resizeSeparable<float, float>(src, out, plan, options);
+    }
+    else
+    {
+        resizeSeparable<uint8_t, int16_t>(src, out, plan, options);
+    }
+
+    dst = std::move(out);
+}
+
+void resize(const Image& src, Image& dst, size_t width, size_t height,
+            Interpolation method, const ParallelOptions& options)
+{
+    const auto plan =
+        cachedPlan({src.width(), src.height(), width, height, method});
+    resize(src, dst, *plan, options);
+}
+
+Node resizeNode(size_t width, size_t height, Interpolation method,
+                std::string name)
+{
+    return make_planned_node<ResizePlan>(
+        [width, height, method](const ShapeKey& key)
+        {
+            return ResizePlan::create(key.Width, key.Height, width, height,
+                                      method);
+        },
+        [](Image& image, const ResizePlan& plan)
+        {
+            if (image.empty()) return EXECError::EXEC_FAIL;
+
+            Image out;
+            resize(image, out, plan);
+            image = std::move(out);
+            return EXECError::EXEC_SUCCESS;
+        },
+        std::move(name));
+}
+
+}  // namespace ips::transform